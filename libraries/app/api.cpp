@@ -28,6 +28,7 @@
 #include <graphene/app/api_access.hpp>
 #include <graphene/app/application.hpp>
 #include <graphene/app/impacted.hpp>
+#include <graphene/app/transaction_precheck.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/get_config.hpp>
 #include <graphene/utilities/key_conversion.hpp>
@@ -133,11 +134,21 @@ namespace graphene { namespace app {
 
     void network_broadcast_api::broadcast_transaction(const signed_transaction& trx)
     {
-       trx.validate();
-       _app.chain_database()->push_transaction(trx);
+       push_prechecked_transaction(trx);
        _app.p2p_node()->broadcast_transaction(trx);
     }
 
+    void network_broadcast_api::push_prechecked_transaction(const signed_transaction& trx)
+    {
+       auto prechecked = _app.precheck()->precheck(trx);
+       try {
+          _app.chain_database()->push_transaction(trx, prechecked);
+       } catch( const fc::exception& ) {
+          _app.precheck()->forget(prechecked.id);
+          throw;
+       }
+    }
+
     fc::variant network_broadcast_api::broadcast_transaction_synchronous(const signed_transaction& trx)
     {
        fc::promise<fc::variant>::ptr pr( new fc::promise<fc::variant>() );
@@ -155,12 +166,42 @@ namespace graphene { namespace app {
 
     void network_broadcast_api::broadcast_transaction_with_callback(confirmation_callback cb, const signed_transaction& trx)
     {
-       trx.validate();
        _callbacks[trx.id()] = cb;
-       _app.chain_database()->push_transaction(trx);
+       push_prechecked_transaction(trx);
        _app.p2p_node()->broadcast_transaction(trx);
     }
 
+    vector<network_broadcast_api::transaction_broadcast_result>
+    network_broadcast_api::broadcast_transactions( const vector<signed_transaction>& trxs )
+    {
+       vector<transaction_broadcast_result> results( trxs.size() );
+       vector<signed_transaction> accepted;
+       accepted.reserve( trxs.size() );
+
+       auto prechecked = _app.precheck()->precheck_batch( trxs );
+       for( size_t i = 0; i < trxs.size(); ++i )
+       {
+          results[i].id = trxs[i].id();
+          if( prechecked[i].error.valid() )
+          {
+             results[i].error = prechecked[i].error->to_string();
+             continue;
+          }
+          try {
+             _app.chain_database()->push_transaction( trxs[i], prechecked[i] );
+             results[i].accepted = true;
+             accepted.push_back( trxs[i] );
+          } catch( const fc::exception& e ) {
+             _app.precheck()->forget( results[i].id );
+             results[i].error = e.to_string();
+          }
+       }
+
+       if( !accepted.empty() )
+          _app.p2p_node()->broadcast_transactions( accepted );
+       return results;
+    }
+
     network_node_api::network_node_api( application& a ) : _app( a )
     {
     }
@@ -187,6 +228,28 @@ namespace graphene { namespace app {
        return _app.p2p_node()->get_potential_peers();
     }
 
+    fc::variant_object network_node_api::get_plugin_statistics(const std::string& plugin_name) const
+    {
+       auto plugin = _app.get_plugin( plugin_name );
+       FC_ASSERT( plugin, "Plugin ${name} is not loaded", ("name", plugin_name) );
+       return plugin->plugin_statistics();
+    }
+
+    fc::variant_object network_node_api::get_metrics() const
+    {
+       fc::mutable_variant_object metrics( _app.p2p_node()->network_get_metrics() );
+       metrics["fork_switches"] = fc::variant( _app.chain_database()->get_fork_switch_statistics() );
+       return metrics;
+    }
+
+    std::string network_node_api::get_metrics_text() const
+    {
+       std::string text = _app.p2p_node()->network_get_metrics_text();
+       for( const auto& entry : fc::variant( _app.chain_database()->get_fork_switch_statistics() ).get_object() )
+          text += "graphene_chain_fork_switch_" + entry.key() + " " + entry.value().as_string() + "\n";
+       return text;
+    }
+
     fc::variant_object network_node_api::get_advanced_node_parameters() const
     {
        return _app.p2p_node()->get_advanced_node_parameters();
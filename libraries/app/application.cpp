@@ -26,6 +26,7 @@
 #include <graphene/app/api_access.hpp>
 #include <graphene/app/application.hpp>
 #include <graphene/app/plugin.hpp>
+#include <graphene/app/transaction_precheck.hpp>
 
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/protocol/types.hpp>
@@ -45,6 +46,7 @@
 #include <fc/io/fstream.hpp>
 #include <fc/rpc/api_connection.hpp>
 #include <fc/rpc/websocket_api.hpp>
+#include <fc/network/http/server.hpp>
 #include <fc/network/resolve.hpp>
 
 #include <boost/filesystem/path.hpp>
@@ -167,6 +169,11 @@ namespace detail {
          _p2p_network->listen_to_p2p_network();
          ilog("Configured p2p node to listen on ${ip}", ("ip", _p2p_network->get_actual_listening_endpoint()));
 
+         std::map<uint32_t, net::item_hash_t> checkpoints;
+         for( const auto& checkpoint : _chain_db->get_checkpoints() )
+            checkpoints[checkpoint.first] = checkpoint.second;
+         _p2p_network->add_checkpoints(checkpoints);
+
          _p2p_network->connect_to_p2p_network();
          _p2p_network->sync_from(net::item_id(net::core_message_type_enum::block_message_type,
                                               _chain_db->head_block_id()),
@@ -258,6 +265,24 @@ namespace detail {
          _websocket_tls_server->start_accept();
       } FC_CAPTURE_AND_RETHROW() }
 
+      void reset_metrics_server()
+      { try {
+         if( !_options->count("metrics-endpoint") )
+            return;
+
+         _metrics_server = std::make_shared<fc::http::server>();
+         ilog("Configured p2p metrics to be served on ${ip}", ("ip",_options->at("metrics-endpoint").as<string>()));
+         _metrics_server->listen( fc::ip::endpoint::from_string(_options->at("metrics-endpoint").as<string>()) );
+         // on_request() must come after listen()
+         _metrics_server->on_request([&]( const fc::http::request& req, const fc::http::server::response& resp ){
+            std::string metrics = _p2p_network->network_get_metrics_text();
+            resp.add_header( "Content-Type", "text/plain; version=0.0.4" );
+            resp.set_status( fc::http::reply::OK );
+            resp.set_length( metrics.size() );
+            resp.write( metrics.data(), metrics.size() );
+         });
+      } FC_CAPTURE_AND_RETHROW() }
+
       application_impl(application* self)
          : _self(self),
            _chain_db(std::make_shared<chain::database>())
@@ -347,6 +372,11 @@ namespace detail {
          }
          _chain_db->add_checkpoints( loaded_checkpoints );
 
+         if( _options->count("maintenance-threads") )
+            _chain_db->set_maintenance_threads( _options->at("maintenance-threads").as<uint32_t>() );
+         _chain_db->set_vote_tally_audit( _options->count("vote-tally-audit") && _options->at("vote-tally-audit").as<bool>() );
+         _chain_db->set_real_supply_audit( _options->count("real-supply-audit") && _options->at("real-supply-audit").as<bool>() );
+
          if( _options->count("replay-blockchain") )
          {
             ilog("Replaying blockchain on user request.");
@@ -427,6 +457,14 @@ namespace detail {
             _force_validate = true;
          }
 
+         uint32_t precheck_threads = _options->count("precheck-threads") ? _options->at("precheck-threads").as<uint32_t>() : 0;
+         _precheck = std::make_shared<transaction_precheck>( precheck_threads );
+         _precheck->update_parameters( *_chain_db );
+         _chain_db->applied_block.connect( [this]( const signed_block& ){ _precheck->update_parameters( *_chain_db ); } );
+         // a transaction the chain dropped may be broadcast again
+         _chain_db->on_dropped_transaction.connect( [this]( const transaction_id_type& id ){ _precheck->forget( id ); } );
+         ilog( "Transaction precheck running on ${n} thread(s)", ("n", precheck_threads) );
+
          graphene::time::now();
 
          if( _options->count("api-access") )
@@ -450,6 +488,7 @@ namespace detail {
          reset_p2p_node(_data_dir);
          reset_websocket_server();
          reset_websocket_tls_server();
+         reset_metrics_server();
       } FC_LOG_AND_RETHROW() }
 
       optional< api_access_info > get_api_access_info(const string& username)const
@@ -565,7 +604,14 @@ namespace detail {
             trx_count = 0;
          }
 
-         _chain_db->push_transaction( transaction_message.trx );
+         // stateless checks run on the precheck threads, only admitted transactions reach the chain thread
+         auto prechecked = _precheck->precheck( transaction_message.trx );
+         try {
+            _chain_db->push_transaction( transaction_message.trx, prechecked );
+         } catch( const fc::exception& ) {
+            _precheck->forget( transaction_message.trx.id() );
+            throw;
+         }
       } FC_CAPTURE_AND_RETHROW( (transaction_message) ) }
 
       virtual void handle_message(const message& message_to_process) override
@@ -656,6 +702,23 @@ namespace detail {
          return trx_message( _chain_db->get_recent_transaction( id.item_hash ) );
       } FC_CAPTURE_AND_RETHROW( (id) ) }
 
+      /**
+       * Returns the headers of the given blocks, stopping at the first block we don't have
+       */
+      virtual std::vector<signed_block_header> get_block_headers(const std::vector<item_hash_t>& block_ids) override
+      { try {
+         std::vector<signed_block_header> result;
+         result.reserve(block_ids.size());
+         for( const item_hash_t& block_id : block_ids )
+         {
+            auto block = _chain_db->fetch_shared_block_by_id(block_id);
+            if( !block )
+               break;
+            result.push_back(*block);
+         }
+         return result;
+      } FC_CAPTURE_AND_RETHROW( (block_ids) ) }
+
       virtual chain_id_type get_chain_id()const override
       {
          return _chain_db->get_chain_id();
@@ -870,8 +933,8 @@ namespace detail {
        */
       virtual fc::time_point_sec get_block_time(const item_hash_t& block_id) override
       { try {
-         auto opt_block = _chain_db->fetch_block_by_id( block_id );
-         if( opt_block.valid() ) return opt_block->timestamp;
+         auto block = _chain_db->fetch_shared_block_by_id( block_id );
+         if( block ) return block->timestamp;
          return fc::time_point_sec::min();
       } FC_CAPTURE_AND_RETHROW( (block_id) ) }
 
@@ -909,8 +972,10 @@ namespace detail {
 
       std::shared_ptr<graphene::chain::database>            _chain_db;
       std::shared_ptr<graphene::net::node>                  _p2p_network;
+      std::shared_ptr<transaction_precheck>                 _precheck;
       std::shared_ptr<fc::http::websocket_server>      _websocket_server;
       std::shared_ptr<fc::http::websocket_tls_server>  _websocket_tls_server;
+      std::shared_ptr<fc::http::server>                _metrics_server;
 
       std::map<string, std::shared_ptr<abstract_plugin>> _plugins;
 
@@ -953,10 +1018,15 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("cert-key-file", bpo::value<string>(), "cert-key-file to use rpc-tls-endpoint")
          ("cert-key-password", bpo::value<string>()->implicit_value(""), "Password for this certificate")
          ("cert-chain-file", bpo::value<string>(), "cert-chain-file to use rpc-tls-endpoint")
+         ("metrics-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8091"), "Endpoint to serve p2p metrics on over HTTP, in the Prometheus text format")
          ("genesis-json", bpo::value<boost::filesystem::path>(), "File to read Genesis State from")
          ("dbg-init-key", bpo::value<string>(), "Block signing key to use for init miners, overrides genesis file")
          ("api-access", bpo::value<boost::filesystem::path>(), "JSON file specifying API permissions")
          ("ipfs-api", bpo::value<string>(), "IPFS control API")
+         ("precheck-threads", bpo::value<uint32_t>()->default_value(2), "Number of threads running stateless checks on incoming transactions, 0 to run them on the chain thread")
+         ("maintenance-threads", bpo::value<uint32_t>()->default_value(0), "Number of threads the vote recount of the chain maintenance is split over, 0 to run it on the chain thread")
+         ("vote-tally-audit", bpo::bool_switch()->default_value(false), "Recount the votes of all accounts at every maintenance and compare them with the incremental tally")
+         ("real-supply-audit", bpo::bool_switch()->default_value(false), "Sum all balances at every maintenance and compare them with the tracked real supply")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
@@ -1032,6 +1102,11 @@ std::shared_ptr<chain::database> application::chain_database() const
    return my->_chain_db;
 }
 
+std::shared_ptr<transaction_precheck> application::precheck() const
+{
+   return my->_precheck;
+}
+
 void application::set_block_production(bool producing_blocks)
 {
    my->_is_block_producer = producing_blocks;
@@ -27,6 +27,7 @@
  
 #include <graphene/app/database_api.hpp>
 #include <graphene/chain/get_config.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
 #include <graphene/utilities/key_conversion.hpp>
 
 #include <fc/bloom_filter.hpp>
@@ -79,6 +80,54 @@ namespace graphene { namespace app {
 
    class database_api_impl;
    
+   /**
+    * Variants of the objects changed by the last notification of the database, shared by all
+    * API connections so that an object subscribed to by many clients is converted only once.
+    * Entries are built on first use and dropped when the database reports the next change.
+    */
+   class changed_object_cache
+   {
+   public:
+      explicit changed_object_cache( graphene::chain::database& db )
+      {
+         _change_connection = db.changed_objects.connect( boost::signals2::at_front,
+            [this]( const vector<object_id_type>& ) { _variants.clear(); } );
+      }
+
+      const variant& get_variant( const object& obj )
+      {
+         auto itr = _variants.find( obj.id );
+         if( itr == _variants.end() )
+            itr = _variants.emplace( obj.id, obj.to_variant() ).first;
+         return itr->second;
+      }
+
+      /** returns the cache of @p db, creating it while no API connection holds one */
+      static std::shared_ptr<changed_object_cache> get( graphene::chain::database& db )
+      {
+         static std::map<const graphene::chain::database*, std::weak_ptr<changed_object_cache>> caches;
+         // drop the entries of databases no connection uses anymore
+         for( auto itr = caches.begin(); itr != caches.end(); )
+         {
+            if( itr->second.expired() )
+               itr = caches.erase( itr );
+            else
+               ++itr;
+         }
+         auto& cache = caches[&db];
+         auto result = cache.lock();
+         if( !result )
+         {
+            result = std::make_shared<changed_object_cache>( db );
+            cache = result;
+         }
+         return result;
+      }
+
+   private:
+      std::map<object_id_type, variant>    _variants;
+      boost::signals2::scoped_connection   _change_connection;
+   };
    
    class database_api_impl : public std::enable_shared_from_this<database_api_impl>
    {
@@ -177,7 +226,7 @@ namespace graphene { namespace app {
          if( !_subscribe_callback )
             return;
          
-         if( !is_subscribed_to_item(i) )
+         if( !_subscribe_filter.contains( vec.data(), vec.size() ) )
          {
             idump((i));
             _subscribe_filter.insert( vec.data(), vec.size() );//(vecconst char*)&i, sizeof(i) );
@@ -189,9 +238,28 @@ namespace graphene { namespace app {
       {
          if( !_subscribe_callback )
             return false;
-         return true;
-         return _subscribe_filter.contains( i );
+         auto vec = fc::raw::pack(i);
+         return _subscribe_filter.contains( vec.data(), vec.size() );
+      }
+
+      /** a typed id packs only its instance, so ids are always filtered as object_id_type */
+      template<uint8_t SpaceID, uint8_t TypeID, typename T>
+      void subscribe_to_item( const object_id<SpaceID, TypeID, T>& i )const
+      {
+         subscribe_to_item( object_id_type( i ) );
       }
+
+      template<uint8_t SpaceID, uint8_t TypeID, typename T>
+      bool is_subscribed_to_item( const object_id<SpaceID, TypeID, T>& i )const
+      {
+         return is_subscribed_to_item( object_id_type( i ) );
+      }
+
+      /** an object is reported when it was subscribed to itself or belongs to a subscribed account */
+      bool is_subscribed_to_object( object_id_type id, const object* obj )const;
+
+      /** an empty filter, the default constructed one holds every item */
+      static fc::bloom_filter make_subscribe_filter();
       
       void broadcast_updates( const vector<variant>& updates );
       
@@ -202,6 +270,7 @@ namespace graphene { namespace app {
       
       mutable fc::bloom_filter                               _subscribe_filter;
       std::function<void(const fc::variant&)> _subscribe_callback;
+      std::shared_ptr<changed_object_cache>   _changed_object_cache;
       std::function<void(const fc::variant&)> _pending_trx_callback;
       std::function<void(const fc::variant&)> _block_applied_callback;
       
@@ -223,9 +292,11 @@ namespace graphene { namespace app {
    
    database_api::~database_api() {}
    
-   database_api_impl::database_api_impl( graphene::chain::database& db ):_db(db)
+   database_api_impl::database_api_impl( graphene::chain::database& db ):_subscribe_filter(make_subscribe_filter()),_db(db)
    {
       wlog("creating database api ${x}", ("x",int64_t(this)) );
+      // must be connected before on_objects_changed below so that the cache is reset first
+      _changed_object_cache = changed_object_cache::get( db );
       _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids) {
          on_objects_changed(ids);
       });
@@ -300,14 +371,17 @@ namespace graphene { namespace app {
       edump((clear_filter));
       _subscribe_callback = cb;
       if( clear_filter || !cb )
-      {
-         static fc::bloom_parameters param;
-         param.projected_element_count    = 10000;
-         param.false_positive_probability = 1.0/10000;
-         param.maximum_size = 1024*8*8*2;
-         param.compute_optimal_parameters();
-         _subscribe_filter = fc::bloom_filter(param);
-      }
+         _subscribe_filter = make_subscribe_filter();
+   }
+
+   fc::bloom_filter database_api_impl::make_subscribe_filter()
+   {
+      fc::bloom_parameters param;
+      param.projected_element_count    = 10000;
+      param.false_positive_probability = 1.0/10000;
+      param.maximum_size = 1024*8*8*2;
+      param.compute_optimal_parameters();
+      return fc::bloom_filter(param);
    }
 
    void database_api::set_pending_transaction_callback( std::function<void(const variant&)> cb )
@@ -368,9 +442,9 @@ namespace graphene { namespace app {
    
    optional<block_header> database_api_impl::get_block_header(uint32_t block_num) const
    {
-      auto result = _db.fetch_block_by_number(block_num);
+      auto result = _db.fetch_shared_block_by_number(block_num);
       if(result)
-         return *result;
+         return block_header(*result);
       return {};
    }
    
@@ -443,10 +517,10 @@ namespace graphene { namespace app {
 
    processed_transaction database_api_impl::get_transaction(uint32_t block_num, uint32_t trx_num)const
    {
-      auto opt_block = _db.fetch_block_by_number(block_num);
-      FC_ASSERT( opt_block );
-      FC_ASSERT( opt_block->transactions.size() > trx_num );
-      return opt_block->transactions[trx_num];
+      auto block = _db.fetch_shared_block_by_number(block_num);
+      FC_ASSERT( block );
+      FC_ASSERT( block->transactions.size() > trx_num );
+      return block->transactions[trx_num];
    }
 
    fc::time_point_sec database_api_impl::head_block_time() const
@@ -596,8 +670,9 @@ namespace graphene { namespace app {
          final_result.emplace_back( std::move(result) );
       }
       
-      for( auto i : final_result )
-         subscribe_to_item(i);
+      for( const auto& account_ids : final_result )
+         for( account_id_type account_id : account_ids )
+            subscribe_to_item( account_id );
       
       return final_result;
    }
@@ -1668,33 +1743,49 @@ namespace graphene { namespace app {
          updates.reserve(objs.size());
          
          for( auto obj : objs )
-            updates.emplace_back( obj->id );
+            if( is_subscribed_to_object( obj->id, obj ) )
+               updates.emplace_back( obj->id );
          broadcast_updates( updates );
       }
 
    }
    
+   bool database_api_impl::is_subscribed_to_object( object_id_type id, const object* obj )const
+   {
+      if( is_subscribed_to_item( id ) )
+         return true;
+      if( obj == nullptr )
+         return false;
+
+      if( id.is<account_balance_id_type>() )
+         return is_subscribed_to_item( static_cast<const account_balance_object*>( obj )->owner );
+      if( id.is<account_statistics_id_type>() )
+         return is_subscribed_to_item( static_cast<const account_statistics_object*>( obj )->owner );
+      if( id.is<vesting_balance_id_type>() )
+         return is_subscribed_to_item( static_cast<const vesting_balance_object*>( obj )->owner );
+      return false;
+   }
+
    void database_api_impl::on_objects_changed(const vector<object_id_type>& ids)
    {
+      if( !_subscribe_callback )
+         return;
+
       vector<variant>    updates;
       
       for(auto id : ids)
       {
-         const object* obj = nullptr;
-         if( _subscribe_callback )
-         {
-            obj = _db.find_object( id );
-            if( obj )
-            {
-               updates.emplace_back( obj->to_variant() );
-            }
-            else
-            {
-               updates.emplace_back(id); // send just the id to indicate removal
-            }
-         }
+         const object* obj = _db.find_object( id );
+         // removed objects are reported by on_objects_removed(), which still has them to find their owner
+         if( obj == nullptr || !is_subscribed_to_object( id, obj ) )
+            continue;
+         // shared between all connections, copying the variant does not copy the object fields
+         updates.emplace_back( _changed_object_cache->get_variant( *obj ) );
       }
       
+      if( updates.empty() )
+         return;
+
       auto capture_this = shared_from_this();
       
       /// pushing the future back / popping the prior future if it is complete.
@@ -137,6 +137,13 @@ namespace graphene { namespace app {
             processed_transaction trx;
          };
 
+         struct transaction_broadcast_result
+         {
+            transaction_id_type id;
+            bool                accepted = false;
+            optional<string>    error;
+         };
+
          typedef std::function<void(variant/*transaction_confirmation*/)> confirmation_callback;
 
          /**
@@ -167,6 +174,18 @@ namespace graphene { namespace app {
           */
          void broadcast_transaction_with_callback( confirmation_callback cb, const signed_transaction& trx);
 
+         /**
+          * @brief Broadcast a batch of transactions to the network in one call
+          * @param trxs The transactions to broadcast
+          * @return One result per transaction, in the order of @ref trxs, telling whether it was accepted and why not
+          *
+          * The stateless checks of the whole batch run in parallel, then the transactions are applied to the local
+          * database in order. A rejected transaction does not affect the others. The accepted transactions are
+          * advertised to the peers in one inventory message.
+          * @ingroup Network_broadcastAPI
+          */
+         vector<transaction_broadcast_result> broadcast_transactions( const vector<signed_transaction>& trxs );
+
          void broadcast_block( const signed_block& block );
 
          /**
@@ -181,6 +200,9 @@ namespace graphene { namespace app {
           */
          void on_applied_block( const signed_block& b );
       private:
+         /// passes @ref trx through the transaction precheck, then applies it to the local database
+         void push_prechecked_transaction( const signed_transaction& trx );
+
          boost::signals2::scoped_connection             _applied_block_connection;
          map<transaction_id_type,confirmation_callback> _callbacks;
          application&                                   _app;
@@ -234,6 +256,27 @@ namespace graphene { namespace app {
           */
          std::vector<net::potential_peer_record> get_potential_peers() const;
 
+         /**
+          * @brief Return runtime statistics of a plugin, e.g. the block production latencies of the miner plugin
+          * @param plugin_name name of the plugin
+          * @ingroup Network_NodeAPI
+          */
+         fc::variant_object get_plugin_statistics(const std::string& plugin_name) const;
+
+         /**
+          * @brief Return p2p metrics: messages and bytes by message type and by peer, queue depths,
+          *        sync backlog, duplicate items, message handling times and node delegate call timings,
+          *        and the fork switch counters of the chain
+          * @ingroup Network_NodeAPI
+          */
+         fc::variant_object get_metrics() const;
+
+         /**
+          * @brief Return the same metrics as get_metrics() in the Prometheus text format
+          * @ingroup Network_NodeAPI
+          */
+         std::string get_metrics_text() const;
+
         
       private:
          application& _app;
@@ -352,6 +395,8 @@ namespace graphene { namespace app {
 
 FC_REFLECT( graphene::app::network_broadcast_api::transaction_confirmation,
         (id)(block_num)(trx_num)(trx) )
+FC_REFLECT( graphene::app::network_broadcast_api::transaction_broadcast_result,
+        (id)(accepted)(error) )
 FC_REFLECT( graphene::app::verify_range_result,
         (success)(min_val)(max_val) )
 FC_REFLECT( graphene::app::verify_range_proof_rewind_result,
@@ -366,6 +411,7 @@ FC_API(graphene::app::history_api,
 FC_API(graphene::app::network_broadcast_api,
        (broadcast_transaction)
        (broadcast_transaction_with_callback)
+       (broadcast_transactions)
        (broadcast_block)
      )
 FC_API(graphene::app::network_node_api,
@@ -373,6 +419,9 @@ FC_API(graphene::app::network_node_api,
        (add_node)
        (get_connected_peers)
        (get_potential_peers)
+       (get_plugin_statistics)
+       (get_metrics)
+       (get_metrics_text)
        (get_advanced_node_parameters)
        (set_advanced_node_parameters)
      )
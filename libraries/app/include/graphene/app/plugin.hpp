@@ -87,6 +87,13 @@ class abstract_plugin
          boost::program_options::options_description& command_line_options,
          boost::program_options::options_description& config_file_options
          ) = 0;
+
+      /**
+       * @brief Runtime statistics of the plugin, exposed through the network node API.
+       *
+       * Plugins without statistics return an empty object.
+       */
+      virtual fc::variant_object plugin_statistics()const = 0;
 };
 
 /**
@@ -108,6 +115,7 @@ class plugin : public abstract_plugin
          boost::program_options::options_description& command_line_options,
          boost::program_options::options_description& config_file_options
          ) override;
+      virtual fc::variant_object plugin_statistics()const override;
 
       chain::database& database() { return *app().chain_database(); }
       application& app()const { assert(_app); return *_app; }
@@ -0,0 +1,129 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/optional.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/thread/future.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace graphene { namespace app {
+   using graphene::chain::signed_transaction;
+   using graphene::chain::transaction_id_type;
+   using graphene::chain::chain_id_type;
+   typedef graphene::chain::database::precomputed_transaction prechecked_transaction;
+
+   /**
+    * @brief Snapshot of the chain state the stateless transaction checks depend on.
+    *
+    * It is taken on the chain thread after every applied block so that the precheck
+    * threads never touch the object database.
+    */
+   struct precheck_parameters
+   {
+      chain_id_type      chain_id;
+      uint32_t           head_block_num                = 0;
+      fc::time_point_sec head_block_time;
+      uint32_t           maximum_transaction_size      = GRAPHENE_DEFAULT_MAX_TRANSACTION_SIZE;
+      uint32_t           maximum_time_until_expiration = GRAPHENE_DEFAULT_MAX_TIME_UNTIL_EXPIRATION;
+   };
+
+   /**
+    * @class transaction_precheck
+    * @brief Admission stage running the checks that need no chain state on a pool of threads.
+    *
+    * Every transaction coming from the network or the API is first passed through
+    * validate(), the size limit, the expiration window, signature recovery and a
+    * duplicate filter here. Only transactions which pass are handed to the chain
+    * thread for the stateful apply, so a flood of invalid or repeated transactions
+    * is rejected without stalling block processing. The id and the recovered keys are
+    * returned so that database::push_transaction() does not compute them again.
+    */
+   class transaction_precheck
+   {
+      public:
+         /// @param thread_count number of worker threads, 0 runs the checks on the calling thread
+         explicit transaction_precheck( uint32_t thread_count );
+         ~transaction_precheck();
+
+         /**
+          * @brief Refresh the chain state snapshot and drop expired entries from the duplicate filter.
+          * Must be called from the chain thread.
+          */
+         void update_parameters( const graphene::chain::database& db );
+
+         /**
+          * @brief Run the stateless checks on one of the worker threads.
+          *
+          * The calling fc task yields until the result is known, so the calling thread keeps
+          * processing other tasks in the meantime.
+          * @return the transaction id and signing keys, to be passed to database::push_transaction()
+          * @throws fc::exception if the transaction is invalid or was already admitted
+          */
+         prechecked_transaction precheck( const signed_transaction& trx );
+
+         /**
+          * @brief Run the stateless checks on a batch of transactions spread over all worker threads.
+          * @return one entry per transaction, holding the error if it was rejected
+          */
+         std::vector<prechecked_transaction> precheck_batch( const std::vector<signed_transaction>& trxs );
+
+         /**
+          * @brief Remove a transaction from the duplicate filter, called when the stateful apply rejected it
+          * or the chain dropped it from the pending transactions, so that the same transaction can be
+          * resubmitted once it becomes valid.
+          */
+         void forget( const transaction_id_type& id );
+
+         uint32_t thread_count()const { return _threads.size(); }
+
+         /// counters of admitted and rejected transactions
+         fc::variant_object get_statistics()const;
+
+      private:
+         prechecked_transaction check( const signed_transaction& trx );
+         precheck_parameters get_parameters()const;
+
+         struct seen_transaction
+         {
+            transaction_id_type id;
+            fc::time_point_sec  expiration;
+         };
+
+         struct by_trx_id;
+         struct by_expiration;
+         typedef boost::multi_index_container<
+            seen_transaction,
+            boost::multi_index::indexed_by<
+               boost::multi_index::hashed_unique< boost::multi_index::tag<by_trx_id>,
+                  boost::multi_index::member< seen_transaction, transaction_id_type, &seen_transaction::id >,
+                  std::hash<transaction_id_type> >,
+               boost::multi_index::ordered_non_unique< boost::multi_index::tag<by_expiration>,
+                  boost::multi_index::member< seen_transaction, fc::time_point_sec, &seen_transaction::expiration > >
+            >
+         > seen_transaction_index;
+
+         std::vector<std::unique_ptr<fc::thread>> _threads;
+         std::atomic<uint32_t>                    _next_thread;
+
+         mutable std::mutex                       _mutex;
+         precheck_parameters                      _parameters;
+         seen_transaction_index                   _seen;
+
+         std::atomic<uint64_t>                    _admitted;
+         std::atomic<uint64_t>                    _rejected_invalid;
+         std::atomic<uint64_t>                    _rejected_duplicate;
+   };
+
+} } // graphene::app
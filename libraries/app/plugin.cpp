@@ -72,4 +72,9 @@ void plugin::plugin_set_program_options(
    return;
 }
 
+fc::variant_object plugin::plugin_statistics()const
+{
+   return fc::variant_object();
+}
+
 } } // graphene::app
@@ -0,0 +1,149 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+
+#include <graphene/app/transaction_precheck.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/smart_ref_impl.hpp>
+
+namespace graphene { namespace app {
+
+transaction_precheck::transaction_precheck( uint32_t thread_count )
+   : _next_thread(0), _admitted(0), _rejected_invalid(0), _rejected_duplicate(0)
+{
+   _threads.reserve( thread_count );
+   for( uint32_t i = 0; i < thread_count; ++i )
+      _threads.emplace_back( new fc::thread( "precheck_" + fc::to_string( uint64_t(i) ) ) );
+}
+
+transaction_precheck::~transaction_precheck()
+{
+}
+
+void transaction_precheck::update_parameters( const graphene::chain::database& db )
+{
+   precheck_parameters params;
+   params.chain_id                      = db.get_chain_id();
+   params.head_block_num                = db.head_block_num();
+   params.head_block_time               = db.head_block_time();
+   params.maximum_transaction_size      = db.get_global_properties().parameters.maximum_transaction_size;
+   params.maximum_time_until_expiration = db.get_global_properties().parameters.maximum_time_until_expiration;
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   _parameters = params;
+
+   // expired transactions can not be admitted any more, so there is no need to remember them
+   auto& by_exp = _seen.get<by_expiration>();
+   by_exp.erase( by_exp.begin(), by_exp.upper_bound( params.head_block_time ) );
+}
+
+precheck_parameters transaction_precheck::get_parameters()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _parameters;
+}
+
+prechecked_transaction transaction_precheck::precheck( const signed_transaction& trx )
+{
+   if( _threads.empty() )
+      return check( trx );
+
+   uint32_t idx = _next_thread++ % _threads.size();
+   return _threads[idx]->async( [this, trx](){ return check( trx ); }, "precheck transaction" ).wait();
+}
+
+std::vector<prechecked_transaction> transaction_precheck::precheck_batch( const std::vector<signed_transaction>& trxs )
+{
+   std::vector<prechecked_transaction> results( trxs.size() );
+   auto check_one = [&]( size_t i ) {
+      try {
+         results[i] = check( trxs[i] );
+      } catch( const fc::exception& e ) {
+         results[i].error = e;
+      }
+   };
+
+   if( _threads.empty() )
+   {
+      for( size_t i = 0; i < trxs.size(); ++i )
+         check_one( i );
+      return results;
+   }
+
+   // stripe the batch over the threads, every thread writes only its own slots of results
+   const size_t stride = _threads.size();
+   std::vector<fc::future<void>> futures;
+   futures.reserve( stride );
+   for( size_t t = 0; t < stride && t < trxs.size(); ++t )
+      futures.push_back( _threads[t]->async( [&check_one, &trxs, t, stride](){
+         for( size_t i = t; i < trxs.size(); i += stride )
+            check_one( i );
+      }, "precheck transaction batch" ) );
+   for( auto& f : futures )
+      f.wait();
+   return results;
+}
+
+prechecked_transaction transaction_precheck::check( const signed_transaction& trx )
+{
+   const precheck_parameters params = get_parameters();
+   prechecked_transaction result;
+
+   try {
+      FC_ASSERT( fc::raw::pack_size( trx ) <= params.maximum_transaction_size,
+                 "Transaction exceeds the maximum transaction size",
+                 ("size", fc::raw::pack_size( trx ))("max", params.maximum_transaction_size) );
+
+      trx.validate();
+
+      // same window as database::_apply_transaction, which skips it while there is no block yet
+      if( params.head_block_num > 0 )
+      {
+         FC_ASSERT( trx.expiration <= params.head_block_time + params.maximum_time_until_expiration, "",
+                    ("trx.expiration", trx.expiration)("now", params.head_block_time)
+                    ("max_til_exp", params.maximum_time_until_expiration) );
+         FC_ASSERT( params.head_block_time <= trx.expiration, "",
+                    ("now", params.head_block_time)("trx.exp", trx.expiration) );
+      }
+
+      // recovers every signing key, throws tx_duplicate_sig for repeated signatures
+      result.signature_keys = trx.get_signature_keys( params.chain_id );
+
+      result.id = trx.id();
+   } catch( const fc::exception& ) {
+      ++_rejected_invalid;
+      throw;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      if( !_seen.insert( seen_transaction{ result.id, trx.expiration } ).second )
+      {
+         ++_rejected_duplicate;
+         FC_THROW( "Duplicate transaction ${id}", ("id", result.id) );
+      }
+   }
+   ++_admitted;
+   return result;
+}
+
+void transaction_precheck::forget( const transaction_id_type& id )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _seen.get<by_trx_id>().erase( id );
+}
+
+fc::variant_object transaction_precheck::get_statistics()const
+{
+   fc::mutable_variant_object result;
+   result["threads"]            = thread_count();
+   result["admitted"]           = _admitted.load();
+   result["rejected_invalid"]   = _rejected_invalid.load();
+   result["rejected_duplicate"] = _rejected_duplicate.load();
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      result["tracked"] = uint64_t( _seen.size() );
+   }
+   return result;
+}
+
+} } // graphene::app
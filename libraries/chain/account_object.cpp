@@ -148,5 +148,29 @@ void account_member_index::object_modified(const object& after)
     }
 }
 
+void balance_supply_index::object_inserted(const object& obj)
+{
+   assert( dynamic_cast<const account_balance_object*>(&obj) ); // for debug only
+   total_balances += static_cast<const account_balance_object&>(obj).balance;
+}
+
+void balance_supply_index::object_removed(const object& obj)
+{
+   assert( dynamic_cast<const account_balance_object*>(&obj) ); // for debug only
+   total_balances -= static_cast<const account_balance_object&>(obj).balance;
+}
+
+void balance_supply_index::about_to_modify(const object& before)
+{
+   assert( dynamic_cast<const account_balance_object*>(&before) ); // for debug only
+   total_balances -= static_cast<const account_balance_object&>(before).balance;
+}
+
+void balance_supply_index::object_modified(const object& after)
+{
+   assert( dynamic_cast<const account_balance_object*>(&after) ); // for debug only
+   total_balances += static_cast<const account_balance_object&>(after).balance;
+}
+
 
 } } // graphene::chain
@@ -39,6 +39,8 @@
 
 #include <fc/smart_ref_impl.hpp>
 
+#include <deque>
+
 namespace graphene
 {
     namespace chain
@@ -72,19 +74,41 @@ namespace graphene
             auto b = _fork_db.fetch_block(id);
             if(!b)
                 return _block_id_to_block.fetch_optional(id);
-            return b->data;
+            return *b->data;
         }
 
         optional<signed_block> database::fetch_block_by_number(uint32_t num) const
         {
             auto results = _fork_db.fetch_block_by_number(num);
             if(results.size( ) == 1)
-                return results[0]->data;
+                return *results[0]->data;
             else
                 return _block_id_to_block.fetch_by_number(num);
             return optional<signed_block>( );
         }
 
+        std::shared_ptr<const signed_block> database::fetch_shared_block_by_id(const block_id_type &id) const
+        {
+            auto b = _fork_db.fetch_block(id);
+            if(b)
+                return b->data;
+            auto from_log = _block_id_to_block.fetch_optional(id);
+            if(!from_log)
+                return nullptr;
+            return std::make_shared<const signed_block>(std::move(*from_log));
+        }
+
+        std::shared_ptr<const signed_block> database::fetch_shared_block_by_number(uint32_t num) const
+        {
+            auto results = _fork_db.fetch_block_by_number(num);
+            if(results.size( ) == 1)
+                return results[0]->data;
+            auto from_log = _block_id_to_block.fetch_by_number(num);
+            if(!from_log)
+                return nullptr;
+            return std::make_shared<const signed_block>(std::move(*from_log));
+        }
+
         const signed_transaction &database::get_recent_transaction(const transaction_id_type &trx_id) const
         {
             auto &index = get_index_type<transaction_index>( ).indices( ).get<by_trx_id>( );
@@ -122,11 +146,44 @@ namespace graphene
                 detail::without_pending_transactions(*this, std::move(_pending_tx),
                                                      [&]( ) {
                                                          result = _push_block(new_block, sync_mode);
+                                                         result = _push_unlinked_children(new_block.id( ), sync_mode) || result;
                                                      });
             });
             return result;
         }
 
+        /**
+ * Blocks which arrived before their parent wait in the fork database, push the ones
+ * that link to @ref id now that it is known, and their descendants after them.
+ *
+ * @return true if we switched forks as a result of these pushes.
+ */
+        bool database::_push_unlinked_children(const block_id_type &id, bool sync_mode)
+        {
+            bool                 switched = false;
+            std::deque<item_ptr> ready;
+            for(const item_ptr &child : _fork_db.pop_unlinked_children(id))
+                ready.push_back(child);
+
+            while(!ready.empty( ))
+            {
+                item_ptr child = ready.front( );
+                ready.pop_front( );
+                try
+                {
+                    switched = _push_block(*child->data, sync_mode) || switched;
+                }
+                catch(const fc::exception &e)
+                {
+                    wlog("Dropping cached block ${n} ${id}: ${e}", ("n", child->num)("id", child->id)("e", e.to_string( )));
+                    continue;
+                }
+                for(const item_ptr &grandchild : _fork_db.pop_unlinked_children(child->id))
+                    ready.push_back(grandchild);
+            }
+            return switched;
+        }
+
         bool database::_push_block(const signed_block &new_block, bool sync_mode)
         {
             try
@@ -139,30 +196,35 @@ namespace graphene
 
                     shared_ptr<fork_item> new_head = _fork_db.push_block(new_block);
                     //If the head block from the longest chain does not build off of the current head, we need to switch forks.
-                    if(new_head->data.previous != head_block_id( ))
+                    if(new_head->data->previous != head_block_id( ))
                     {
                         //If the newly pushed block is the same height as head, we get head back in new_head
                         //Only switch forks if new_head is actually higher than head
-                        if(new_head->data.block_num( ) > head_block_num( ))
+                        if(new_head->data->block_num( ) > head_block_num( ))
                         {
-                            wlog("Switching to fork: ${id}", ("id", new_head->data.id( )));
-                            auto branches = _fork_db.fetch_branch_from(new_head->data.id( ), head_block_id( ));
+                            wlog("Switching to fork: ${id}", ("id", new_head->data->id( )));
+                            const fc::time_point reorg_start = fc::time_point::now( );
+                            auto                 branches    = _fork_db.fetch_branch_from(new_head->data->id( ), head_block_id( ));
 
                             // pop blocks until we hit the forked block
-                            while(head_block_id( ) != branches.second.back( )->data.previous)
+                            uint32_t popped = 0;
+                            while(head_block_id( ) != branches.second.back( )->data->previous)
+                            {
                                 pop_block( );
+                                ++popped;
+                            }
+                            ++_fork_switch_statistics.switches;
+                            _fork_switch_statistics.blocks_popped += popped;
+                            _fork_switch_statistics.max_blocks_popped = std::max(_fork_switch_statistics.max_blocks_popped, popped);
 
                             // push all blocks on the new fork
                             for(auto ritr = branches.first.rbegin( ); ritr != branches.first.rend( ); ++ritr)
                             {
-                                ilog("pushing blocks from fork ${n} ${id}", ("n", (*ritr)->data.block_num( ))("id", (*ritr)->data.id( )));
+                                ilog("pushing blocks from fork ${n} ${id}", ("n", (*ritr)->data->block_num( ))("id", (*ritr)->data->id( )));
                                 optional<fc::exception> except;
                                 try
                                 {
-                                    undo_database::session session = _undo_db.start_undo_session( );
-                                    apply_block((*ritr)->data, skip);
-                                    _block_id_to_block.store((*ritr)->id, (*ritr)->data);
-                                    session.commit( );
+                                    apply_fork_item(**ritr, skip);
                                 }
                                 catch(const fc::exception &e)
                                 {
@@ -174,39 +236,57 @@ namespace graphene
                                     // remove the rest of branches.first from the fork_db, those blocks are invalid
                                     while(ritr != branches.first.rend( ))
                                     {
-                                        _fork_db.remove((*ritr)->data.id( ));
+                                        _fork_db.remove((*ritr)->data->id( ));
                                         ++ritr;
                                     }
                                     _fork_db.set_head(branches.second.front( ));
 
                                     // pop all blocks from the bad fork
-                                    while(head_block_id( ) != branches.second.back( )->data.previous)
+                                    while(head_block_id( ) != branches.second.back( )->data->previous)
                                         pop_block( );
 
                                     // restore all blocks from the good fork
                                     for(auto ritr = branches.second.rbegin( ); ritr != branches.second.rend( ); ++ritr)
-                                    {
-                                        auto session = _undo_db.start_undo_session( );
-                                        apply_block((*ritr)->data, skip);
-                                        _block_id_to_block.store(new_block.id( ), (*ritr)->data);
-                                        session.commit( );
-                                    }
+                                        apply_fork_item(**ritr, skip);
+                                    ++_fork_switch_statistics.failed_switches;
+                                    record_fork_switch_time(fc::time_point::now( ) - reorg_start);
+                                    wlog("Failed fork switch to ${id} reverted after ${t} ms, ${p} blocks popped",
+                                         ("id", new_head->id)("t", (fc::time_point::now( ) - reorg_start).count( ) / 1000)("p", popped));
                                     throw *except;
                                 }
                             }
+                            record_fork_switch_time(fc::time_point::now( ) - reorg_start);
+                            ilog("Switched to fork ${id} in ${t} ms, ${p} blocks popped and ${a} applied",
+                                 ("id", new_head->id)("t", (fc::time_point::now( ) - reorg_start).count( ) / 1000)("p", popped)("a", branches.first.size( )));
                             return true;
                         }
                         else
+                        {
+                            // the block waits on a shorter fork, do its stateless checks now rather than during a switch to it
+                            auto item = _fork_db.fetch_block(new_block.id( ));
+                            if(item)
+                                precheck_fork_item(*item, skip);
                             return false;
+                        }
                     }
                 }
 
                 try
                 {
-                    auto session = _undo_db.start_undo_session( );
+                    // a miner_update_operation in the block may change the key, so it is read before the block is applied
+                    const public_key_type signing_key = new_block.miner(*this).signing_key;
+                    auto                  session     = _undo_db.start_undo_session( );
                     apply_block(new_block, skip);
                     _block_id_to_block.store(new_block.id( ), new_block);
                     session.commit( );
+                    if(!(skip & skip_fork_db))
+                    {
+                        auto item = _fork_db.fetch_block(new_block.id( ));
+                        if(item && !(skip & skip_merkle_check))
+                            item->merkle_validated = true;
+                        if(item && !(skip & skip_miner_signature))
+                            item->signee = signing_key;
+                    }
                     //we will notify after session commit, since we want to be sure that seeding plugin works and generated tx will refer to commited block_objects
                 }
                 catch(const fc::exception &e)
@@ -269,7 +349,20 @@ namespace graphene
             FC_CAPTURE_AND_RETHROW((trx))
         }
 
-        processed_transaction database::_push_transaction(const signed_transaction &trx)
+        processed_transaction database::push_transaction(const signed_transaction &trx, const precomputed_transaction &precomputed, uint32_t skip)
+        {
+            try
+            {
+                processed_transaction result;
+                detail::with_skip_flags(*this, skip, [&]( ) {
+                    result = _push_transaction(trx, &precomputed);
+                });
+                return result;
+            }
+            FC_CAPTURE_AND_RETHROW((trx))
+        }
+
+        processed_transaction database::_push_transaction(const signed_transaction &trx, const precomputed_transaction *precomputed)
         {
             // If this is the first transaction pushed after applying a block, start a new undo session.
             // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
@@ -282,7 +375,7 @@ namespace graphene
             // apply the changes.
 
             auto temp_session  = _undo_db.start_undo_session( );
-            auto processed_trx = _apply_transaction(trx);
+            auto processed_trx = _apply_transaction(trx, precomputed);
             _pending_tx.push_back(processed_trx);
 
             notify_changed_objects( );
@@ -465,14 +558,18 @@ namespace graphene
             try
             {
                 _pending_tx_session.reset( );
-                auto                   head_id    = head_block_id( );
-                optional<signed_block> head_block = fetch_block_by_id(head_id);
-                GRAPHENE_ASSERT(head_block.valid( ), pop_empty_chain, "there are no blocks to pop");
+                auto head_id    = head_block_id( );
+                auto head_block = fetch_shared_block_by_id(head_id);
+                GRAPHENE_ASSERT(head_block, pop_empty_chain, "there are no blocks to pop");
 
                 _fork_db.pop_block( );
                 _block_id_to_block.remove(head_id);
                 pop_undo( );
 
+                // undo does not roll back the vote tally, so popping a maintenance block forces a recount
+                if( _vote_tally.valid_until.valid( ) && *_vote_tally.valid_until != get_dynamic_global_properties( ).next_maintenance_time )
+                    _vote_tally.valid_until.reset( );
+
                 _popped_tx.insert(_popped_tx.begin( ), head_block->transactions.begin( ), head_block->transactions.end( ));
             }
             FC_CAPTURE_AND_RETHROW( )
@@ -529,8 +626,10 @@ namespace graphene
                 if(itr != _checkpoints.end( ))
                     FC_ASSERT(next_block.id( ) == itr->second, "Block did not match checkpoint", ("checkpoint", *itr)("block_id", next_block.id( )));
 
+                // WE CAN SKIP ALMOST EVERYTHING, but unless the caller trusts the block (reindex) the
+                // transactions must be the ones the checkpointed header commits to
                 if(_checkpoints.rbegin( )->first >= block_num)
-                    skip = ~0; // WE CAN SKIP ALMOST EVERYTHING
+                    skip = ~uint32_t(skip_merkle_check) | (skip & skip_merkle_check);
             }
 
             detail::with_skip_flags(*this, skip, [&]( ) {
@@ -588,7 +687,14 @@ namespace graphene
                 // update_global_dynamic_data() as perhaps these methods only need
                 // to be called for header validation?
                 update_maintenance_flag(maint_needed);
-                update_miner_schedule( );
+                if(maint_needed)
+                {
+                    const fc::time_point schedule_start = fc::time_point::now( );
+                    update_miner_schedule( );
+                    _last_maintenance_timings.update_miner_schedule = (fc::time_point::now( ) - schedule_start).count( );
+                }
+                else
+                    update_miner_schedule( );
                 if(!_node_property_object.debug_updates.empty( ))
                     apply_debug_updates( );
 
@@ -623,6 +729,8 @@ namespace graphene
                         removed.emplace_back(item.second.get( ));
                     }
                     changed_objects(changed_ids);
+                    if(!removed.empty( ))
+                        removed_objects(removed);
                 }
             }
             FC_CAPTURE_AND_RETHROW( )
@@ -637,18 +745,78 @@ namespace graphene
             return result;
         }
 
-        processed_transaction database::_apply_transaction(const signed_transaction &trx)
+        /**
+ * Apply a block of the fork database during a fork switch. The stateless checks recorded
+ * in the item are not repeated, only the recovered signing key is compared with the
+ * current key of the miner.
+ */
+        void database::apply_fork_item(fork_item &item, uint32_t skip)
+        {
+            const signed_block &  block       = *item.data;
+            const public_key_type signing_key = block.miner(*this).signing_key;
+            if(item.merkle_validated)
+                skip |= skip_merkle_check;
+            if(item.signee && !(skip & skip_miner_signature))
+            {
+                FC_ASSERT(*item.signee == signing_key, "Block was not signed by the miner's signing key",
+                          ("block", item.id)("signee", *item.signee)("signing_key", signing_key));
+                skip |= skip_miner_signature;
+            }
+
+            undo_database::session session = _undo_db.start_undo_session( );
+            apply_block(block, skip);
+            _block_id_to_block.store(item.id, block);
+            session.commit( );
+
+            ++_fork_switch_statistics.blocks_applied;
+            if(item.merkle_validated && item.signee)
+                ++_fork_switch_statistics.blocks_prechecked;
+            if(!(skip & skip_merkle_check))
+                item.merkle_validated = true;
+            if(!(skip & skip_miner_signature))
+                item.signee = signing_key;
+        }
+
+        void database::record_fork_switch_time(fc::microseconds duration)
+        {
+            _fork_switch_statistics.total_time += duration.count( );
+            _fork_switch_statistics.max_time = std::max(_fork_switch_statistics.max_time, duration.count( ));
+        }
+
+        void database::precheck_fork_item(fork_item &item, uint32_t skip) const
+        {
+            try
+            {
+                if(!item.merkle_validated && !(skip & skip_merkle_check))
+                    item.merkle_validated = item.data->transaction_merkle_root == item.data->calculate_merkle_root( );
+                if(!item.signee && !(skip & skip_miner_signature))
+                    item.signee = public_key_type(item.data->signee( ));
+            }
+            catch(const fc::exception &e)
+            {
+                // left unset, the block fails the full checks if it is ever applied
+                wlog("Stateless checks of fork block ${id} failed: ${e}", ("id", item.id)("e", e.to_string( )));
+            }
+        }
+
+        processed_transaction database::_apply_transaction(const signed_transaction &trx, const precomputed_transaction *precomputed)
         {
             try
             {
                 uint32_t skip = get_node_properties( ).skip_flags;
 
-                if(true || !(skip & skip_validate)) /* issue #505 explains why this skip_flag is disabled */
+                if(precomputed != nullptr)
+                {
+                    // validate() already ran in the transaction precheck
+                    if(precomputed->error)
+                        precomputed->error->dynamic_rethrow_exception( );
+                }
+                else if(true || !(skip & skip_validate)) /* issue #505 explains why this skip_flag is disabled */
                     trx.validate( );
 
                 auto &               trx_idx  = get_mutable_index_type<transaction_index>( );
                 const chain_id_type &chain_id = get_chain_id( );
-                auto                 trx_id   = trx.id( );
+                auto                 trx_id   = precomputed != nullptr ? precomputed->id : trx.id( );
                 FC_ASSERT((skip & skip_transaction_dupe_check) ||
                           trx_idx.indices( ).get<by_trx_id>( ).find(trx_id) == trx_idx.indices( ).get<by_trx_id>( ).end( ));
                 transaction_evaluation_state eval_state(this);
@@ -659,7 +827,11 @@ namespace graphene
                 {
                     auto get_active = [&](account_id_type id) { return &id(*this).owner; };
                     auto get_owner  = [&](account_id_type id) { return &id(*this).owner; };
-                    trx.verify_authority(chain_id, get_active, get_owner, get_global_properties( ).parameters.max_authority_depth);
+                    if(precomputed != nullptr && precomputed->signature_keys.valid( ))
+                        graphene::chain::verify_authority(trx.operations, *precomputed->signature_keys, get_active, get_owner,
+                                                          get_global_properties( ).parameters.max_authority_depth);
+                    else
+                        trx.verify_authority(chain_id, get_active, get_owner, get_global_properties( ).parameters.max_authority_depth);
                 }
 
                 //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
@@ -697,7 +869,7 @@ namespace graphene
                 _current_op_in_trx = 0;
                 for(const auto &op : ptrx.operations)
                 {
-                    eval_state.operation_results.emplace_back(apply_operation(eval_state, op, trx.id( )));
+                    eval_state.operation_results.emplace_back(apply_operation(eval_state, op, trx_id));
                     ++_current_op_in_trx;
                 }
                 ptrx.operation_results = std::move(eval_state.operation_results);
@@ -111,6 +111,18 @@ share_type database::get_miner_budget(uint32_t blocks_to_maint)
 }
 
 real_supply database::get_real_supply()const
+{
+   real_supply total;
+   const auto& abidx = dynamic_cast<const primary_index<account_balance_index>&>( get_index_type<account_balance_index>() );
+   total.account_balances = abidx.get_secondary_index<balance_supply_index>().total_balances;
+
+   const auto& vbidx = dynamic_cast<const primary_index<vesting_balance_index>&>( get_index_type<vesting_balance_index>() );
+   total.vesting_balances = vbidx.get_secondary_index<vesting_supply_index>().total_balances;
+
+   return total;
+}
+
+real_supply database::scan_real_supply()const
 {
    //walk through account_balances, vesting_balances and escrows in content and buying objects
    real_supply total;
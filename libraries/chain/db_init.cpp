@@ -180,28 +180,35 @@ void database::initialize_indexes()
 {
    reset_indexes();
    _undo_db.set_max_size( GRAPHENE_MIN_UNDO_HISTORY );
+   _vote_tally = vote_tally_state();
+   auto vote_tally_observer_ptr = std::make_shared<vote_tally_observer>( _vote_tally );
 
    //Protocol object indexes
    add_index< primary_index<asset_index> >();
 
    auto acnt_index = add_index< primary_index<account_index> >();
    acnt_index->add_secondary_index<account_member_index>();
+   acnt_index->add_observer( vote_tally_observer_ptr );
 
    add_index< primary_index<miner_index> >();
 
    auto prop_index = add_index< primary_index<proposal_index > >();
    prop_index->add_secondary_index<required_approval_index>();
 
-   add_index< primary_index<vesting_balance_index> >();
+   auto vesting_index = add_index< primary_index<vesting_balance_index> >();
+   vesting_index->add_secondary_index<vesting_supply_index>();
+   vesting_index->add_observer( vote_tally_observer_ptr );
    add_index< primary_index<blinded_balance_index> >();
    add_index< primary_index<confidential_tx_index> >();
 
    //Implementation object indexes
    add_index< primary_index<transaction_index                             > >();
-   add_index< primary_index<account_balance_index                         > >();
+   auto balance_index = add_index< primary_index<account_balance_index   > >();
+   balance_index->add_secondary_index<balance_supply_index>();
+   balance_index->add_observer( vote_tally_observer_ptr );
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
-   add_index< primary_index<simple_index<account_statistics_object       >> >();
+   add_index< primary_index<simple_index<account_statistics_object       >> >()->add_observer( vote_tally_observer_ptr );
    add_index< primary_index<simple_index<asset_dynamic_data_object       >> >();
    add_index< primary_index<flat_index<  block_summary_object            >> >();
    add_index< primary_index<simple_index<chain_property_object          > > >();
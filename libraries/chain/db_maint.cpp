@@ -28,6 +28,8 @@
 #include <fc/smart_ref_impl.hpp>
 #include <fc/uint128.hpp>
 
+#include <future>
+
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/hardfork.hpp>
 #include <graphene/chain/account_object.hpp>
@@ -65,13 +67,6 @@ vector<std::reference_wrapper<const typename Index::object_type>> database::sort
    return refs;
 }
 
-template<class... Types>
-void database::perform_account_maintenance(std::tuple<Types...> helpers)
-{
-   const auto& idx = get_index_type<account_index>().indices().get<by_name>();
-   for( const account_object& a : idx )
-      detail::for_each(helpers, a, detail::gen_seq<sizeof...(Types)>());
-}
 void database::update_active_miners()
 { try {
    assert( _miner_count_histogram_buffer.size() > 0 );
@@ -165,6 +160,18 @@ void database::process_budget()
          rec.from_initial_reserve = core_asset.reserved(*this);
          rec.from_accumulated_fees = core.accumulated_fees + dpo.unspent_fee_budget;
          rec._real_supply = get_real_supply();
+         if( _real_supply_audit )
+         {
+            real_supply scanned = scan_real_supply();
+            if( scanned.account_balances != rec._real_supply.account_balances
+                || scanned.vesting_balances != rec._real_supply.vesting_balances )
+            {
+               ++_real_supply_audit_failures;
+               elog( "Real supply audit failed at block ${b}: tracked ${t}, scanned ${s}",
+                     ("b", head_block_num())("t", rec._real_supply)("s", scanned) );
+               rec._real_supply = scanned;
+            }
+         }
          if(    (dpo.last_budget_time == fc::time_point_sec())
                 || (now <= dpo.last_budget_time) )
          {
@@ -216,70 +223,289 @@ void database::process_budget()
 }
 
 
-void database::perform_chain_maintenance(const signed_block& next_block, const global_property_object& global_props)
+vote_tally_state::voter database::get_voter(const account_object& stake_account) const
 {
-   const auto& gpo = get_global_properties();
+   // There may be a difference between the account whose stake is voting and the one specifying opinions.
+   // Usually they're the same, but if the stake account has specified a voting_account, that account is the one
+   // specifying the opinions.
+   vote_tally_state::voter v;
+   v.opinion = (stake_account.options.voting_account == GRAPHENE_PROXY_TO_SELF_ACCOUNT) ? stake_account.get_id() : stake_account.options.voting_account;
+
+   const auto& stats = stake_account.statistics(*this);
+   v.stake = stats.total_core_in_orders.value
+      + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(*this).balance.amount.value: 0)
+      + get_balance(stake_account.get_id(), asset_id_type()).amount.value;
+   return v;
+}
+
+void database::set_maintenance_threads(uint32_t thread_count)
+{
+   _maintenance_threads.clear();
+   _maintenance_threads.reserve(thread_count);
+   for( uint32_t i = 0; i < thread_count; ++i )
+      _maintenance_threads.emplace_back(new fc::thread("maintenance_" + fc::to_string(uint64_t(i))));
+}
 
-   struct vote_tally_helper {
-      database& d;
-      const global_property_object& props;
+/**
+ * Split [0, count) into one contiguous shard per maintenance thread and run work on each of them,
+ * blocking until all are done. The work must only read the database. Without maintenance threads
+ * everything runs as a single shard on the calling thread.
+ */
+void database::for_each_shard(size_t count, const std::function<void(size_t shard, size_t begin, size_t end)>& work) const
+{
+   const size_t shards = std::min(_maintenance_threads.size(), count);
+   if( shards <= 1 )
+   {
+      work(0, 0, count);
+      return;
+   }
+
+   vector<std::promise<void>> done(shards);
+   vector<optional<fc::exception>> errors(shards);
+   for( size_t t = 0; t < shards; ++t )
+   {
+      const size_t begin = count * t / shards;
+      const size_t end = count * (t + 1) / shards;
+      _maintenance_threads[t]->async([&work, &done, &errors, t, begin, end]() {
+         try {
+            work(t, begin, end);
+         } catch( const fc::exception& e ) {
+            errors[t] = e;
+         } catch( ... ) {
+            errors[t] = fc::exception(FC_LOG_MESSAGE(error, "unexpected exception in maintenance shard"));
+         }
+         done[t].set_value();
+      }, "maintenance shard");
+   }
 
-      vote_tally_helper(database& d, const global_property_object& gpo)
-         : d(d), props(gpo)
+   // block instead of waiting on an fc::future, no other task may run while the maintenance is half done
+   for( auto& d : done )
+      d.get_future().wait();
+   for( const auto& e : errors )
+      if( e.valid() )
+         e->dynamic_rethrow_exception();
+}
+
+/**
+ * Full recount of the votes of every account, only reads the database.
+ *
+ * The accounts and then the opinion accounts are split into shards counted into their own
+ * partial tallies on the maintenance threads, which are merged in shard order afterwards.
+ */
+void database::recount_votes(vote_tally_state& tally) const
+{
+   tally.clear_tally();
+
+   const auto& idx = get_index_type<account_index>().indices().get<by_name>();
+   vector<const account_object*> accounts;
+   accounts.reserve(idx.size());
+   for( const account_object& a : idx )
+      accounts.push_back(&a);
+
+   const size_t shard_count = std::max<size_t>(1, std::min(_maintenance_threads.size(), accounts.size()));
+   vector<vote_tally_state> parts(shard_count);
+   for_each_shard(accounts.size(), [&](size_t shard, size_t begin, size_t end) {
+      vote_tally_state& part = parts[shard];
+      for( size_t i = begin; i < end; ++i )
       {
-         d._vote_tally_buffer.resize(props.next_available_vote_id);
-         d._miner_count_histogram_buffer.resize(props.parameters.maximum_miner_count / 2 + 1);
-         d._total_voting_stake = 0;
+         const account_object& stake_account = *accounts[i];
+         vote_tally_state::voter v = get_voter(stake_account);
+         part.voters[stake_account.id] = v;
+         part.proxied_stake[v.opinion] += v.stake;
+         if( v.opinion != stake_account.id )
+            part.proxy_members[v.opinion].insert(stake_account.id);
+         part.total_stake += v.stake;
       }
+   });
+   for( auto& part : parts )
+   {
+      tally.merge(part);
+      part = vote_tally_state();
+   }
+
+   vector<std::pair<account_id_type, uint64_t>> opinion_stakes(tally.proxied_stake.begin(), tally.proxied_stake.end());
+   for_each_shard(opinion_stakes.size(), [&](size_t shard, size_t begin, size_t end) {
+      vote_tally_state& part = parts[shard];
+      for( size_t i = begin; i < end; ++i )
+      {
+         const account_object& opinion_account = get(opinion_stakes[i].first);
+         part.add_opinion(opinion_stakes[i].first, vote_tally_state::opinion(opinion_stakes[i].second, opinion_account.options));
+      }
+   });
+   for( const auto& part : parts )
+      tally.merge(part);
+}
 
-      void operator()(const account_object& stake_account) {
-         // There may be a difference between the account whose stake is voting and the one specifying opinions.
-         // Usually they're the same, but if the stake account has specified a voting_account, that account is the one
-         // specifying the opinions.
-         const account_object& opinion_account = (stake_account.options.voting_account == GRAPHENE_PROXY_TO_SELF_ACCOUNT) ? stake_account : d.get(stake_account.options.voting_account);
-         
-         const auto& stats = stake_account.statistics(d);
-         uint64_t voting_stake = stats.total_core_in_orders.value
-            + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
-            + d.get_balance(stake_account.get_id(), asset_id_type()).amount.value;
-
-         const auto &idx = d.get_index_type<account_balance_index>( ).indices( ).get<by_owner>( );
-         auto        it  = idx.find(stake_account.get_id());
-         if(idx.end( ) != it)
-             d.modify(*it, [&](account_balance_object &o) {
-                 o.vote_power = voting_stake;
-                 o.casted_vote = opinion_account.get_voted_miner();
-             });
-
-         for( vote_id_type id : opinion_account.options.votes )
+/**
+ * Record the stake and the voted miner of an account in its balance, they are used to share
+ * the miner rewards until the next maintenance.
+ */
+void database::update_vote_snapshot(account_id_type account, const vote_tally_state::voter& v)
+{
+   const auto& idx = get_index_type<account_balance_index>().indices().get<by_owner>();
+   auto it = idx.find(account);
+   if( it == idx.end() )
+      return;
+   vote_id_type casted_vote = v.opinion(*this).get_voted_miner();
+   if( it->vote_power != v.stake || !(it->casted_vote == casted_vote) )
+      modify(*it, [&](account_balance_object& o) {
+         o.vote_power = v.stake;
+         o.casted_vote = casted_vote;
+      });
+}
+
+/**
+ * Bring the vote tally up to date and fill the buffers used by the rest of the maintenance.
+ *
+ * Only the accounts marked dirty since the last maintenance are recounted: their stake is moved
+ * between opinion accounts, and the opinion accounts whose stake or votes changed replace their
+ * contribution. The tally is rebuilt from all accounts when it is not known to match the state.
+ */
+void database::update_vote_tally(const global_property_object& props)
+{
+   const dynamic_global_property_object& dpo = get_dynamic_global_properties();
+
+   if( !_vote_tally.valid_until.valid() || *_vote_tally.valid_until != dpo.next_maintenance_time )
+   {
+      ilog( "Recounting the votes of all accounts" );
+      recount_votes(_vote_tally);
+      for( const auto& item : _vote_tally.voters )
+         update_vote_snapshot(item.first, item.second);
+   }
+   else
+   {
+      // the stakes of the dirty accounts are read in parallel, the tally is then updated in account order
+      const vector<account_id_type> dirty(_vote_tally.dirty.begin(), _vote_tally.dirty.end());
+      vector<optional<vote_tally_state::voter>> new_voters(dirty.size());
+      for_each_shard(dirty.size(), [&](size_t, size_t begin, size_t end) {
+         for( size_t i = begin; i < end; ++i )
          {
-            uint32_t offset = id.instance();
-            // if they somehow managed to specify an illegal offset, ignore it.
-            if( offset < d._vote_tally_buffer.size() )
-               d._vote_tally_buffer[offset] += voting_stake;
+            const account_object* stake_account = find(dirty[i]);
+            if( stake_account != nullptr )
+               new_voters[i] = get_voter(*stake_account);
          }
-         
-         if( opinion_account.options.num_miner <= props.parameters.maximum_miner_count )
+      });
+
+      std::set<account_id_type> changed_opinions;
+      std::set<account_id_type> changed_snapshots;
+      for( size_t i = 0; i < dirty.size(); ++i )
+      {
+         const account_id_type id = dirty[i];
+         const optional<vote_tally_state::voter>& new_voter = new_voters[i];
+         if( new_voter.valid() )
+         {
+            changed_opinions.insert(id);
+            changed_snapshots.insert(id);
+         }
+
+         auto old_itr = _vote_tally.voters.find(id);
+         if( old_itr != _vote_tally.voters.end() && new_voter.valid()
+             && old_itr->second.stake == new_voter->stake && old_itr->second.opinion == new_voter->opinion )
+            continue;
+
+         if( old_itr != _vote_tally.voters.end() )
          {
-            uint16_t offset = std::min(size_t(opinion_account.options.num_miner/2),
-                                       d._miner_count_histogram_buffer.size() - 1);
-            // votes for a number greater than maximum_miner_count
-            // are turned into votes for maximum_miner_count.
-            //
-            // in particular, this takes care of the case where a
-            // member was voting for a high number, then the
-            // parameter was lowered.
-            d._miner_count_histogram_buffer[offset] += voting_stake;
+            const vote_tally_state::voter& old_voter = old_itr->second;
+            _vote_tally.proxied_stake[old_voter.opinion] -= old_voter.stake;
+            if( old_voter.opinion != id )
+               _vote_tally.proxy_members[old_voter.opinion].erase(id);
+            _vote_tally.total_stake -= old_voter.stake;
+            changed_opinions.insert(old_voter.opinion);
+            _vote_tally.voters.erase(old_itr);
          }
-         
-         d._total_voting_stake += voting_stake;
+         if( new_voter.valid() )
+         {
+            _vote_tally.proxied_stake[new_voter->opinion] += new_voter->stake;
+            if( new_voter->opinion != id )
+               _vote_tally.proxy_members[new_voter->opinion].insert(id);
+            _vote_tally.total_stake += new_voter->stake;
+            changed_opinions.insert(new_voter->opinion);
+            _vote_tally.voters[id] = *new_voter;
+         }
+      }
+
+      for( account_id_type id : changed_opinions )
+      {
+         auto stake_itr = _vote_tally.proxied_stake.find(id);
+         const uint64_t stake = stake_itr == _vote_tally.proxied_stake.end() ? 0 : stake_itr->second;
+         const account_object* opinion_account = find(id);
+
+         auto old_itr = _vote_tally.opinions.find(id);
+         if( old_itr != _vote_tally.opinions.end() && opinion_account != nullptr
+             && old_itr->second.stake == stake
+             && old_itr->second.votes == opinion_account->options.votes
+             && old_itr->second.num_miner == opinion_account->options.num_miner )
+            continue;
+
+         // the miner voted for by everyone following this opinion may have changed
+         auto members = _vote_tally.proxy_members.find(id);
+         if( members != _vote_tally.proxy_members.end() )
+            changed_snapshots.insert(members->second.begin(), members->second.end());
+
+         _vote_tally.remove_opinion(id);
+         if( opinion_account != nullptr && stake_itr != _vote_tally.proxied_stake.end() )
+            _vote_tally.add_opinion(id, vote_tally_state::opinion(stake, opinion_account->options));
       }
-      
-   } tally_helper(*this, gpo);
 
-   perform_account_maintenance(std::tie(
-      tally_helper
-   ));
+      for( account_id_type id : changed_snapshots )
+         update_vote_snapshot(id, _vote_tally.voters[id]);
+   }
+   // the snapshots written above marked their owners, nothing changed for the tally though
+   _vote_tally.dirty.clear();
+
+   auto fill_buffers = [&props]( const vote_tally_state& tally, vector<uint64_t>& votes, vector<uint64_t>& histogram ) {
+      votes.assign(props.next_available_vote_id, 0);
+      for( const auto& item : tally.votes )
+      {
+         // if they somehow managed to specify an illegal offset, ignore it.
+         if( item.first < votes.size() )
+            votes[item.first] += item.second;
+      }
+
+      histogram.assign(props.parameters.maximum_miner_count / 2 + 1, 0);
+      for( const auto& item : tally.miner_count_stake )
+      {
+         // votes for a number greater than maximum_miner_count are ignored, accounts that vote
+         // for 0 or 1 miner are counted in the first bucket and do not express an opinion.
+         if( item.first <= props.parameters.maximum_miner_count )
+            histogram[std::min(size_t(item.first/2), histogram.size() - 1)] += item.second;
+      }
+   };
+   fill_buffers(_vote_tally, _vote_tally_buffer, _miner_count_histogram_buffer);
+   _total_voting_stake = _vote_tally.total_stake;
+
+   if( _vote_tally_audit )
+   {
+      vote_tally_state recount;
+      recount_votes(recount);
+      vector<uint64_t> votes, histogram;
+      fill_buffers(recount, votes, histogram);
+      if( votes != _vote_tally_buffer || histogram != _miner_count_histogram_buffer || recount.total_stake != _total_voting_stake )
+      {
+         elog( "Incremental vote tally differs from a full recount, using the recount" );
+         ++_vote_tally_audit_failures;
+         _vote_tally_buffer = std::move(votes);
+         _miner_count_histogram_buffer = std::move(histogram);
+         _total_voting_stake = recount.total_stake;
+         recount.valid_until = _vote_tally.valid_until;
+         _vote_tally = std::move(recount);
+         for( const auto& item : _vote_tally.voters )
+            update_vote_snapshot(item.first, item.second);
+         _vote_tally.dirty.clear();
+      }
+   }
+}
+
+void database::perform_chain_maintenance(const signed_block& next_block, const global_property_object& global_props)
+{
+   const auto& gpo = get_global_properties();
+   const fc::time_point start = fc::time_point::now();
+   _last_maintenance_timings = maintenance_timings();
+   _last_maintenance_timings.block_num = next_block.block_num();
+
+   update_vote_tally(gpo);
+   fc::time_point step_end = fc::time_point::now();
+   _last_maintenance_timings.vote_tally = (step_end - start).count();
 
    struct clear_canary {
       clear_canary(vector<uint64_t>& target): target(target){}
@@ -290,7 +516,10 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
    clear_canary a(_miner_count_histogram_buffer),
                 b(_vote_tally_buffer);
 
+   fc::time_point step_start = step_end;
    update_active_miners();
+   step_end = fc::time_point::now();
+   _last_maintenance_timings.update_active_miners = (step_end - step_start).count();
    cyva_housekeeping();
 
    modify(gpo, [this](global_property_object& p) {
@@ -340,11 +569,17 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
       d.next_maintenance_time = next_maintenance_time;
       d.accounts_registered_this_interval = 0;
    });
+   // the tally now matches the state up to this maintenance, until this block is undone
+   _vote_tally.valid_until = next_maintenance_time;
 
    // process_budget needs to run at the bottom because
    //   it needs to know the next_maintenance_time
    //TODO_CYVA rework
+   step_start = fc::time_point::now();
    process_budget();
+   step_end = fc::time_point::now();
+   _last_maintenance_timings.process_budget = (step_end - step_start).count();
+   _last_maintenance_timings.total = (step_end - start).count();
 }
 
 } }
@@ -51,7 +51,7 @@ void database::reindex(fc::path data_dir, const genesis_state_type& initial_allo
 { try {
    ilog( "reindexing blockchain" );
    wipe(data_dir, false);
-   open(data_dir, [&initial_allocation]{return initial_allocation;});
+   _open(data_dir, [&initial_allocation]{return initial_allocation;});
 
    auto start = fc::time_point::now();
    auto last_block = _block_id_to_block.last();
@@ -99,6 +99,8 @@ void database::reindex(fc::path data_dir, const genesis_state_type& initial_allo
    _undo_db.enable();
    auto end = fc::time_point::now();
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+   restore_fork_database();
+   restore_pending_transactions();
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
 void database::wipe(const fc::path& data_dir, bool include_blocks)
@@ -107,7 +109,11 @@ void database::wipe(const fc::path& data_dir, bool include_blocks)
    close();
    object_database::wipe(data_dir);
    if( include_blocks )
+   {
       fc::remove_all( data_dir / "database" );
+      fc::remove_all( data_dir / GRAPHENE_PENDING_TRANSACTIONS_FILENAME );
+      fc::remove_all( data_dir / GRAPHENE_FORK_DATABASE_FILENAME );
+   }
 }
 
 void database::open(
@@ -116,6 +122,20 @@ void database::open(
 {
    try
    {
+      _open(data_dir, genesis_loader);
+      restore_fork_database();
+      restore_pending_transactions();
+   }
+   FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
+}
+
+void database::_open(
+   const fc::path& data_dir,
+   std::function<genesis_state_type()> genesis_loader)
+{
+   try
+   {
+      _data_dir = data_dir;
       object_database::open(data_dir );
 
       _block_id_to_block.open(data_dir / "database" / "block_num_to_block");
@@ -132,7 +152,7 @@ void database::open(
          {
             idump((last_block));
             idump((get( dynamic_global_property_id_type() )));
-            idump((_fork_db.head()->data));
+            idump((*_fork_db.head()->data));
             idump((_fork_db.head()->num));
 
             FC_ASSERT( head_block_num() == 0, "last block ID does not match current chain state" );
@@ -144,8 +164,10 @@ void database::open(
 
 void database::close(bool rewind)
 {
-   // TODO:  Save pending tx's on close()
+   std::vector<signed_transaction> pending_to_save( _pending_tx.begin(), _pending_tx.end() );
    clear_pending();
+   // before the rewind below drops the reversible blocks from the fork database
+   save_fork_database();
    // pop all of the blocks that we can given our undo history, this should
    // throw when there is no more undo history to pop
    if( rewind )
@@ -180,6 +202,11 @@ void database::close(bool rewind)
    // DB state (issue #336).
    clear_pending();
 
+   // popped transactions go first, the same order pending_transactions_restorer re-applies them in
+   pending_to_save.insert( pending_to_save.begin(), _popped_tx.begin(), _popped_tx.end() );
+   _popped_tx.clear();
+   save_pending_transactions( pending_to_save );
+
    object_database::flush();
    object_database::close();
 
@@ -187,6 +214,154 @@ void database::close(bool rewind)
       _block_id_to_block.close();
 
    _fork_db.reset();
+   _data_dir = fc::path();
+}
+
+/// writes a temporary file and renames it over @p file, so a crash never leaves it half written
+static void write_binary_file( const fc::path& file, const std::vector<char>& data )
+{
+   const fc::path temp_file = file.generic_string() + ".tmp";
+   {
+      std::ofstream out( temp_file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+      out.write( data.data(), data.size() );
+      out.close();
+      FC_ASSERT( !out.fail(), "Unable to write ${file}", ("file", temp_file) );
+   }
+   fc::rename( temp_file, file );
+}
+
+void database::save_pending_transactions( const std::vector<signed_transaction>& transactions )const
+{
+   if( _data_dir == fc::path() )
+      return;
+   const fc::path pending_file = _data_dir / GRAPHENE_PENDING_TRANSACTIONS_FILENAME;
+   try
+   {
+      if( transactions.empty() )
+      {
+         fc::remove_all( pending_file );
+         return;
+      }
+      write_binary_file( pending_file, fc::raw::pack( transactions ) );
+      ilog( "Saved ${n} pending transactions", ("n", transactions.size()) );
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Unable to save pending transactions: ${e}", ("e", e.to_detail_string()) );
+   }
+}
+
+void database::restore_pending_transactions()
+{
+   const fc::path pending_file = _data_dir / GRAPHENE_PENDING_TRANSACTIONS_FILENAME;
+   if( _data_dir == fc::path() || !fc::exists( pending_file ) )
+      return;
+
+   std::vector<signed_transaction> transactions;
+   try
+   {
+      std::string data;
+      fc::read_file_contents( pending_file, data );
+      transactions = fc::raw::unpack< std::vector<signed_transaction> >( std::vector<char>( data.begin(), data.end() ) );
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Discarding unreadable pending transactions file: ${e}", ("e", e.to_detail_string()) );
+   }
+   fc::remove_all( pending_file );
+
+   uint32_t restored = 0, expired = 0, known = 0, failed = 0;
+   for( const signed_transaction& trx : transactions )
+   {
+      if( trx.expiration < head_block_time() )
+      {
+         ++expired;
+         continue;
+      }
+      if( is_known_transaction( trx.id() ) )
+      {
+         ++known;
+         continue;
+      }
+      try
+      {
+         push_transaction( trx );
+         ++restored;
+      }
+      catch( const fc::exception& )
+      {
+         ++failed;
+      }
+   }
+   ilog( "Restored ${r} of ${n} saved pending transactions (${e} expired, ${k} already in chain, ${f} invalid)",
+         ("r", restored)("n", transactions.size())("e", expired)("k", known)("f", failed) );
+}
+
+void database::save_fork_database()const
+{
+   if( _data_dir == fc::path() )
+      return;
+   const fc::path fork_db_file = _data_dir / GRAPHENE_FORK_DATABASE_FILENAME;
+   try
+   {
+      // irreversible blocks are in the block database already
+      const uint32_t last_irreversible = get_dynamic_global_properties().last_irreversible_block_num;
+      std::vector<signed_block> blocks;
+      for( const item_ptr& item : _fork_db.fetch_all_blocks() )
+         if( item->num > last_irreversible )
+            blocks.push_back( *item->data );
+
+      if( blocks.empty() )
+      {
+         fc::remove_all( fork_db_file );
+         return;
+      }
+      write_binary_file( fork_db_file, fc::raw::pack( blocks ) );
+      ilog( "Saved ${n} reversible blocks", ("n", blocks.size()) );
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Unable to save the fork database: ${e}", ("e", e.to_detail_string()) );
+   }
+}
+
+void database::restore_fork_database()
+{
+   const fc::path fork_db_file = _data_dir / GRAPHENE_FORK_DATABASE_FILENAME;
+   if( _data_dir == fc::path() || !fc::exists( fork_db_file ) )
+      return;
+
+   std::vector<signed_block> blocks;
+   try
+   {
+      std::string data;
+      fc::read_file_contents( fork_db_file, data );
+      blocks = fc::raw::unpack< std::vector<signed_block> >( std::vector<char>( data.begin(), data.end() ) );
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Discarding unreadable fork database file: ${e}", ("e", e.to_detail_string()) );
+   }
+   fc::remove_all( fork_db_file );
+
+   // blocks are saved in block number order, so every block finds its parent already pushed
+   uint32_t restored = 0, failed = 0;
+   for( const signed_block& block : blocks )
+   {
+      if( block.block_num() <= head_block_num() && is_known_block( block.id() ) )
+         continue;
+      try
+      {
+         push_block( block );
+         ++restored;
+      }
+      catch( const fc::exception& )
+      {
+         ++failed;
+      }
+   }
+   ilog( "Restored ${r} of ${n} saved reversible blocks (${f} rejected), head is ${h}",
+         ("r", restored)("n", blocks.size())("f", failed)("h", head_block_num()) );
 }
 
 } }
@@ -34,6 +34,8 @@ void fork_database::reset()
 {
    _head.reset();
    _index.clear();
+   _unlinked_index.clear();
+   _unlinked_bytes = 0;
 }
 
 void fork_database::pop_block()
@@ -64,9 +66,9 @@ shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
    catch ( const unlinkable_block_exception& e )
    {
       wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",b.id())("num",b.block_num()) );
-      wlog( "Head: ${num}, ${id}", ("num",_head->data.block_num())("id",_head->data.id()) );
+      wlog( "Head: ${num}, ${id}", ("num",_head->num)("id",_head->id) );
+      _push_unlinked( item );
       throw;
-      _unlinked_index.insert( item );
    }
    return _head;
 }
@@ -99,8 +101,8 @@ void  fork_database::_push_block(const item_ptr& item)
       auto& num_idx = _index.get<block_num>();
       while( num_idx.size() && (*num_idx.begin())->num < min_num )
          num_idx.erase( num_idx.begin() );
-      
-      _unlinked_index.get<block_num>().erase(_head->num - _max_size);
+
+      _prune_unlinked();
    }
    //_push_next( item );
 }
@@ -120,6 +122,7 @@ void fork_database::_push_next( const item_ptr& new_item )
     {
        auto tmp = *itr;
        prev_idx.erase( itr );
+       _unlinked_bytes -= tmp->size;
        _push_block( tmp );
 
        itr = prev_idx.find( new_item->id );
@@ -143,18 +146,65 @@ void fork_database::set_max_size( uint32_t s )
          itr = by_num_idx.begin();
       }
    }
-   { /// unlinked_index
-      auto& by_num_idx = _unlinked_index.get<block_num>();
-      auto itr = by_num_idx.begin();
-      while( itr != by_num_idx.end() )
+   _prune_unlinked();
+}
+
+void fork_database::set_max_unlinked_bytes( uint64_t s )
+{
+   _max_unlinked_bytes = s;
+   _prune_unlinked();
+}
+
+void fork_database::_push_unlinked( const item_ptr& item )
+{
+   // a block this far ahead of the head will not link any time soon
+   if( _head && item->num > _head->num + MAX_BLOCK_REORDERING )
+      return;
+   if( !_unlinked_index.insert( item ).second )
+      return;
+   _unlinked_bytes += item->size;
+   _prune_unlinked();
+}
+
+void fork_database::_prune_unlinked()
+{
+   auto& by_num_idx = _unlinked_index.get<block_num>();
+   if( _head )
+   {
+      const int64_t min_num = std::max( int64_t(0), int64_t(_head->num) - _max_size );
+      while( !by_num_idx.empty() && int64_t((*by_num_idx.begin())->num) <= min_num )
       {
-         if( (*itr)->num < std::max(int64_t(0),int64_t(_head->num) - _max_size) )
-            by_num_idx.erase(itr);
-         else
-            break;
-         itr = by_num_idx.begin();
+         _unlinked_bytes -= (*by_num_idx.begin())->size;
+         by_num_idx.erase( by_num_idx.begin() );
       }
    }
+   // over budget, drop the blocks furthest in the future first: they are the least
+   // likely to link soon and the cheapest for a peer to fabricate
+   while( _unlinked_bytes > _max_unlinked_bytes && !by_num_idx.empty() )
+   {
+      auto last = std::prev( by_num_idx.end() );
+      _unlinked_bytes -= (*last)->size;
+      by_num_idx.erase( last );
+   }
+}
+
+vector<item_ptr> fork_database::pop_unlinked_children( const block_id_type& id )
+{
+   auto& prev_idx = _unlinked_index.get<by_previous>();
+   auto range = prev_idx.equal_range( id );
+   vector<item_ptr> result( range.first, range.second );
+   prev_idx.erase( range.first, range.second );
+   for( const item_ptr& item : result )
+      _unlinked_bytes -= item->size;
+   return result;
+}
+
+vector<item_ptr> fork_database::fetch_all_blocks()const
+{
+   vector<item_ptr> result( _index.get<block_num>().begin(), _index.get<block_num>().end() );
+   result.insert( result.end(), _unlinked_index.get<block_num>().begin(), _unlinked_index.get<block_num>().end() );
+   std::stable_sort( result.begin(), result.end(), []( const item_ptr& a, const item_ptr& b ) { return a->num < b->num; } );
+   return result;
 }
 
 bool fork_database::is_known_block(const block_id_type& id)const
@@ -211,19 +261,19 @@ pair<fork_database::branch_type,fork_database::branch_type>
    auto second_branch = *second_branch_itr;
 
 
-   while( first_branch->data.block_num() > second_branch->data.block_num() )
+   while( first_branch->num > second_branch->num )
    {
       result.first.push_back(first_branch);
       first_branch = first_branch->prev.lock();
       FC_ASSERT(first_branch);
    }
-   while( second_branch->data.block_num() > first_branch->data.block_num() )
+   while( second_branch->num > first_branch->num )
    {
       result.second.push_back( second_branch );
       second_branch = second_branch->prev.lock();
       FC_ASSERT(second_branch);
    }
-   while( first_branch->data.previous != second_branch->data.previous )
+   while( first_branch->previous_id() != second_branch->previous_id() )
    {
       result.first.push_back(first_branch);
       result.second.push_back(second_branch);
@@ -511,6 +511,21 @@ namespace graphene { namespace chain {
          set<public_key_type>  before_key_members;
    };
 
+   /**
+    *  @brief This secondary index keeps the sum of all account balances, so that the real supply
+    *  is known without walking over every balance object.
+    */
+   class balance_supply_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         share_type total_balances;
+   };
+
 
    struct by_account_asset;
    struct by_asset_balance;
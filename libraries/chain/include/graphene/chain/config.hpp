@@ -154,6 +154,10 @@
 #define GRAPHENE_RECENTLY_MISSED_COUNT_DECREMENT             3
 
 #define GRAPHENE_CURRENT_DB_VERSION                          "CVA1.0"
+/// file in the blockchain data directory holding the pending transactions between restarts
+#define GRAPHENE_PENDING_TRANSACTIONS_FILENAME               "pending_transactions.bin"
+/// file in the blockchain data directory holding the reversible blocks of the fork database between restarts
+#define GRAPHENE_FORK_DATABASE_FILENAME                      "fork_db.bin"
 
 #define GRAPHENE_IRREVERSIBLE_THRESHOLD                      (70 * GRAPHENE_1_PERCENT)
 
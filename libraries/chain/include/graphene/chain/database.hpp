@@ -32,6 +32,7 @@
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/global_property_object.hpp>
 #include <graphene/chain/node_property_object.hpp>
+#include <graphene/chain/vote_tally.hpp>
 
 #include <fc/signals.hpp>
 #include <graphene/db/object.hpp>
@@ -41,6 +42,7 @@
 #include <graphene/chain/protocol/protocol.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/thread/thread.hpp>
 
 #include <map>
 
@@ -56,6 +58,38 @@ namespace graphene
         struct budget_record;
         struct real_supply;
 
+        /**
+    *   @brief Time spent in the steps of the last maintenance, in microseconds
+    */
+        struct maintenance_timings
+        {
+            uint32_t block_num             = 0;
+            int64_t  vote_tally            = 0;
+            int64_t  update_active_miners  = 0;
+            int64_t  process_budget        = 0;
+            int64_t  update_miner_schedule = 0;
+            /// all of perform_chain_maintenance
+            int64_t  total = 0;
+        };
+
+        /**
+    *   @brief Counters of the fork switches since the database was opened, times in microseconds
+    */
+        struct fork_switch_statistics
+        {
+            uint64_t switches          = 0;
+            /// switches which failed and restored the previous branch, they are counted in switches too
+            uint64_t failed_switches   = 0;
+            uint64_t blocks_popped     = 0;
+            uint32_t max_blocks_popped = 0;
+            /// fork blocks applied during switches, including the ones restoring the previous branch
+            uint64_t blocks_applied    = 0;
+            /// blocks among them which skipped the merkle check and the signature recovery done before
+            uint64_t blocks_prechecked = 0;
+            int64_t  total_time        = 0;
+            int64_t  max_time          = 0;
+        };
+
         /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -116,6 +150,13 @@ namespace graphene
           * Will close the database before wiping. Database will be closed when this function returns.
           */
             void wipe(const fc::path &data_dir, bool include_blocks);
+
+            /**
+          * @brief Close the database
+          *
+          * The pending transactions, and the transactions of the blocks popped while rewinding, are saved
+          * to disk and re-admitted through push_transaction() by the next open().
+          */
             void close(bool rewind = true);
 
             //////////////////// db_block.cpp ////////////////////
@@ -129,6 +170,13 @@ namespace graphene
             block_id_type              get_block_id_for_num(uint32_t block_num) const;
             optional<signed_block>     fetch_block_by_id(const block_id_type &id) const;
             optional<signed_block>     fetch_block_by_number(uint32_t num) const;
+            /**
+          *  Same as fetch_block_by_id() and fetch_block_by_number(), but a block held by the fork
+          *  database is returned without copying it.  Blocks only in the block log are read into
+          *  a new block.  @return nullptr if the block is unknown
+          */
+            std::shared_ptr<const signed_block> fetch_shared_block_by_id(const block_id_type &id) const;
+            std::shared_ptr<const signed_block> fetch_shared_block_by_number(uint32_t num) const;
             const signed_transaction & get_recent_transaction(const transaction_id_type &trx_id) const;
             std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -142,11 +190,51 @@ namespace graphene
             const flat_map<uint32_t, block_id_type> get_checkpoints( ) const { return _checkpoints; }
             bool                                    before_last_checkpoint( ) const;
 
+            /**
+          *  Set the number of threads the maintenance splits its read-only passes over, such as
+          *  the vote recount. 0 (the default) runs them on the calling thread.
+          */
+            void     set_maintenance_threads(uint32_t thread_count);
+            uint32_t maintenance_threads( ) const { return _maintenance_threads.size( ); }
+
+            /**
+          *  Votes are tallied incrementally from the accounts changed since the last maintenance.
+          *  With the audit enabled every maintenance also recounts all accounts and compares the
+          *  results; a mismatch is logged, counted and the recount is used.
+          */
+            void     set_vote_tally_audit(bool enabled) { _vote_tally_audit = enabled; }
+            uint32_t vote_tally_audit_failures( ) const { return _vote_tally_audit_failures; }
+
+            /**
+          *  The real supply is kept up to date by secondary indexes on the balance and vesting
+          *  balance indexes. With the audit enabled every maintenance also sums all balances and
+          *  compares the results; a mismatch is logged, counted and the full sum is used.
+          */
+            void     set_real_supply_audit(bool enabled) { _real_supply_audit = enabled; }
+            uint32_t real_supply_audit_failures( ) const { return _real_supply_audit_failures; }
+
+            const maintenance_timings &get_last_maintenance_timings( ) const { return _last_maintenance_timings; }
+            const fork_switch_statistics &get_fork_switch_statistics( ) const { return _fork_switch_statistics; }
+
+            /// stateless results computed for a transaction before it is applied
+            struct precomputed_transaction
+            {
+                transaction_id_type                 id;
+                optional<fc::exception>             error;
+                /// keys recovered from the signatures, unset if they were not recovered
+                optional<flat_set<public_key_type>> signature_keys;
+            };
+
             bool push_block(const signed_block &b, uint32_t skip = skip_nothing, bool sync_mode = false);
             //bool ( const signed_block& b, uint32_t skip = skip_nothing );
             processed_transaction push_transaction(const signed_transaction &trx, uint32_t skip = skip_nothing);
+            /**
+          * @brief Push a transaction whose validate() and signature recovery already ran elsewhere,
+          * e.g. in the transaction precheck, without repeating them.
+          */
+            processed_transaction push_transaction(const signed_transaction &trx, const precomputed_transaction &precomputed, uint32_t skip = skip_nothing);
             bool                  _push_block(const signed_block &b, bool sync_mode = false);
-            processed_transaction _push_transaction(const signed_transaction &trx);
+            processed_transaction _push_transaction(const signed_transaction &trx, const precomputed_transaction *precomputed = nullptr);
 
             ///@throws fc::exception if the proposed transaction fails to apply.
             processed_transaction push_proposal(const proposal_object &proposal);
@@ -202,6 +290,12 @@ namespace graphene
           */
             fc::signal<void(const signed_transaction &)> on_pending_transaction;
 
+            /**
+          * This signal is emitted when a pending transaction, or one of a popped block, no
+          * longer applies on top of the new head block and is dropped.
+          */
+            fc::signal<void(const transaction_id_type &)> on_dropped_transaction;
+
             /**
           *  Emitted After a block has been applied and committed.  The callback
           *  should not yield and should execute quickly.
@@ -353,6 +447,8 @@ namespace graphene
             uint64_t                            get_next_reward_switch_block(uint64_t start) const;
 
             real_supply get_real_supply( ) const;
+            /// sums every balance and vesting balance object, used to audit get_real_supply
+            real_supply scan_real_supply( ) const;
 
             bool is_reward_switch_time( ) const;
 
@@ -372,7 +468,7 @@ namespace graphene
             {
                 auto fhd = _fork_db.head( );
                 if(fhd)
-                    return fhd->data.block_num( );
+                    return fhd->num;
                 return 0;
             }
             /**
@@ -384,6 +480,15 @@ namespace graphene
             void notify_changed_objects( );
 
           private:
+            void _open(const fc::path &data_dir, std::function<genesis_state_type( )> genesis_loader);
+            void save_pending_transactions(const std::vector<signed_transaction> &transactions) const;
+            /// re-admits the transactions saved by close(), dropping expired ones and ones already in the chain
+            void restore_pending_transactions( );
+            void save_fork_database( ) const;
+            /// pushes the reversible blocks saved by close() back, both the main chain and the forks
+            void restore_fork_database( );
+
+            fc::path                         _data_dir;
             optional<undo_database::session> _pending_tx_session;
             vector<unique_ptr<op_evaluator>> _operation_evaluators;
 
@@ -399,8 +504,12 @@ namespace graphene
             operation_result      apply_operation(transaction_evaluation_state &eval_state, const operation &op, const transaction_id_type &tx_id);
 
           private:
-            void                  _apply_block(const signed_block &next_block);
-            processed_transaction _apply_transaction(const signed_transaction &trx);
+            void                            _apply_block(const signed_block &next_block);
+            processed_transaction           _apply_transaction(const signed_transaction &trx, const precomputed_transaction *precomputed = nullptr);
+            bool                            _push_unlinked_children(const block_id_type &id, bool sync_mode);
+            void                            apply_fork_item(fork_item &item, uint32_t skip);
+            void                            precheck_fork_item(fork_item &item, uint32_t skip) const;
+            void                            record_fork_switch_time(fc::microseconds duration);
 
             ///Steps involved in applying a new block
             ///@{
@@ -427,9 +536,11 @@ namespace graphene
             void process_budget( );
             void perform_chain_maintenance(const signed_block &next_block, const global_property_object &global_props);
             void update_active_miners( );
-
-            template<class... Types>
-            void perform_account_maintenance(std::tuple<Types...> helpers);
+            void update_vote_tally(const global_property_object &props);
+            void recount_votes(vote_tally_state &tally) const;
+            void update_vote_snapshot(account_id_type account, const vote_tally_state::voter &v);
+            vote_tally_state::voter get_voter(const account_object &stake_account) const;
+            void for_each_shard(size_t count, const std::function<void(size_t shard, size_t begin, size_t end)> &work) const;
             ///@}
             ///@}
 
@@ -463,36 +574,27 @@ namespace graphene
             vector<uint64_t> _vote_tally_buffer;
             vector<uint64_t> _miner_count_histogram_buffer;
             uint64_t         _total_voting_stake;
+            vote_tally_state _vote_tally;
+            bool             _vote_tally_audit          = false;
+            uint32_t         _vote_tally_audit_failures = 0;
+            bool             _real_supply_audit          = false;
+            uint32_t         _real_supply_audit_failures = 0;
+
+            maintenance_timings _last_maintenance_timings;
+            fork_switch_statistics _fork_switch_statistics;
 
             flat_map<uint32_t, block_id_type> _checkpoints;
 
+            vector<std::unique_ptr<fc::thread>> _maintenance_threads;
+
             node_property_object _node_property_object;
         };
 
-        namespace detail
-        {
-            template<int... Is>
-            struct seq
-            {
-            };
-
-            template<int N, int... Is>
-            struct gen_seq : gen_seq<N - 1, N - 1, Is...>
-            {
-            };
-
-            template<int... Is>
-            struct gen_seq<0, Is...> : seq<Is...>
-            {
-            };
-
-            template<typename T, int... Is>
-            void for_each(T &&t, const account_object &a, seq<Is...>)
-            {
-                auto l = {(std::get<Is>(t)(a), 0)...};
-                (void) l;
-            }
-        } // namespace detail
-
     } // namespace chain
 } // namespace graphene
+
+FC_REFLECT(graphene::chain::maintenance_timings,
+           (block_num)(vote_tally)(update_active_miners)(process_budget)(update_miner_schedule)(total))
+
+FC_REFLECT(graphene::chain::fork_switch_statistics,
+           (switches)(failed_switches)(blocks_popped)(max_blocks_popped)(blocks_applied)(blocks_prechecked)(total_time)(max_time))
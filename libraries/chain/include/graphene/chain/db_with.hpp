@@ -85,6 +85,7 @@ struct pending_transactions_restorer
                _db._push_transaction( tx );
             }
          } catch ( const fc::exception&  ) {
+            _db.on_dropped_transaction( tx.id() );
          }
       }
       _db._popped_tx.clear();
@@ -104,6 +105,7 @@ struct pending_transactions_restorer
             wlog( "Pending transaction became invalid after switching to block ${b}  ${t}", ("b", _db.head_block_id())("t",_db.head_block_time()) );
             wlog( "The invalid pending transaction caused exception ${e}", ("e", e.to_detail_string() ) );
             */
+            _db.on_dropped_transaction( tx.id() );
          }
       }
    }
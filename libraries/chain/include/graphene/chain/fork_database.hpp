@@ -24,6 +24,8 @@
 #pragma once
 #include <graphene/chain/protocol/block.hpp>
 
+#include <fc/io/raw.hpp>
+
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -38,9 +40,12 @@ namespace graphene { namespace chain {
    struct fork_item
    {
       fork_item( signed_block d )
-      :num(d.block_num()),id(d.id()),data( std::move(d) ){}
+      :fork_item( std::make_shared<const signed_block>( std::move(d) ) ){}
+
+      fork_item( shared_ptr<const signed_block> d )
+      :num(d->block_num()),id(d->id()),size(fc::raw::pack_size(*d)),data( std::move(d) ){}
 
-      block_id_type previous_id()const { return data.previous; }
+      block_id_type previous_id()const { return data->previous; }
 
       weak_ptr< fork_item > prev;
       uint32_t              num;    // initialized in ctor
@@ -49,8 +54,18 @@ namespace graphene { namespace chain {
        * building on top of it.
        */
       bool                  invalid = false;
+      /**
+       * Stateless checks which already passed for this block, so that they are
+       * not redone when the block is applied again during a fork switch.
+       */
+      bool                      merkle_validated = false;
+      /// key which produced the miner signature, it is still compared with the miner's signing key
+      optional<public_key_type> signee;
       block_id_type         id;
-      signed_block          data;
+      /// serialized size of the block, charged against the unlinked block budget
+      uint64_t              size;
+      /// immutable block shared with everyone who fetched it from the fork database
+      shared_ptr<const signed_block> data;
    };
    typedef shared_ptr<fork_item> item_ptr;
 
@@ -64,6 +79,11 @@ namespace graphene { namespace chain {
     *
     *  Every time a block is pushed into the fork DB the
     *  block with the highest block_num will be returned.
+    *
+    *  Blocks which do not link yet are kept in a separate
+    *  cache until their parent arrives. The cache is bounded
+    *  by a byte budget, when it is exceeded the blocks
+    *  furthest ahead of the head are dropped first.
     */
    class fork_database
    {
@@ -71,6 +91,8 @@ namespace graphene { namespace chain {
          typedef vector<item_ptr> branch_type;
          /// The maximum number of blocks that may be skipped in an out-of-order push
          const static int MAX_BLOCK_REORDERING = 1024;
+         /// Default memory budget for blocks which do not link to the known chain
+         const static uint64_t DEFAULT_MAX_UNLINKED_BYTES = 64 * 1024 * 1024;
 
          fork_database();
          void reset();
@@ -89,6 +111,17 @@ namespace graphene { namespace chain {
          shared_ptr<fork_item>            head()const { return _head; }
          void                             pop_block();
 
+         /**
+          *  Remove and return the cached unlinked blocks whose parent is @ref id,
+          *  so that they can be pushed once that block has been applied.
+          */
+         vector<item_ptr>                 pop_unlinked_children(const block_id_type& id);
+
+         /**
+          *  @return every linked and unlinked block held by the fork database, ordered by block number
+          */
+         vector<item_ptr>                 fetch_all_blocks()const;
+
          /**
           *  Given two head blocks, return two branches of the fork graph that
           *  end with a common ancestor (same prior block)
@@ -110,12 +143,20 @@ namespace graphene { namespace chain {
 
          void set_max_size( uint32_t s );
 
+         void     set_max_unlinked_bytes( uint64_t s );
+         uint64_t unlinked_bytes()const { return _unlinked_bytes; }
+
       private:
          /** @return a pointer to the newly pushed item */
          void _push_block(const item_ptr& b );
          void _push_next(const item_ptr& newly_inserted);
+         void _push_unlinked(const item_ptr& item);
+         /// drops unlinked blocks which are too old or exceed the byte budget
+         void _prune_unlinked();
 
          uint32_t                 _max_size = 1024;
+         uint64_t                 _max_unlinked_bytes = DEFAULT_MAX_UNLINKED_BYTES;
+         uint64_t                 _unlinked_bytes = 0;
 
          fork_multi_index_type    _unlinked_index;
          fork_multi_index_type    _index;
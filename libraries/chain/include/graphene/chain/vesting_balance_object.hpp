@@ -185,6 +185,21 @@ namespace graphene { namespace chain {
     */
    typedef generic_index<vesting_balance_object, vesting_balance_multi_index_type> vesting_balance_index;
 
+   /**
+    *  @brief This secondary index keeps the sum of all vesting balances, so that the real supply
+    *  is known without walking over every vesting balance object.
+    */
+   class vesting_supply_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         share_type total_balances;
+   };
+
    struct vesting_balance_object_with_info : public vesting_balance_object
    {
        vesting_balance_object_with_info( const vesting_balance_object& vbo, fc::time_point_sec now );
@@ -0,0 +1,153 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#pragma once
+
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
+
+#include <graphene/db/index.hpp>
+
+#include <map>
+#include <set>
+
+namespace graphene { namespace chain {
+
+/**
+ * @brief Vote tally of the last maintenance interval, kept in memory so that the next
+ * maintenance only has to recount the accounts which changed in between.
+ *
+ * The tally is not part of the chain state. The values written to the chain at
+ * maintenance are the same as with a full recount, and the tally is rebuilt by a full
+ * recount whenever it can not be trusted: after a restart, or when the maintenance
+ * block it was computed in has been undone.
+ */
+struct vote_tally_state
+{
+   /// stake an account votes with and the account whose opinion it follows
+   struct voter
+   {
+      uint64_t        stake = 0;
+      account_id_type opinion;
+   };
+
+   /// what an opinion account currently contributes to the tally
+   struct opinion
+   {
+      opinion() {}
+      opinion( uint64_t stake, const account_options& options )
+         : stake( stake ), votes( options.votes ), num_miner( options.num_miner ) {}
+
+      uint64_t                stake = 0;
+      flat_set<vote_id_type>  votes;
+      uint16_t                num_miner = 0;
+   };
+
+   std::map<account_id_type, voter>                      voters;
+   /// total stake of the voters following each opinion account
+   std::map<account_id_type, uint64_t>                   proxied_stake;
+   std::map<account_id_type, opinion>                    opinions;
+   /// voters which follow another account's opinion, by opinion account
+   std::map<account_id_type, std::set<account_id_type>>  proxy_members;
+
+   /// stake by vote_id instance
+   std::map<uint32_t, uint64_t>                          votes;
+   /// stake by the number of miners voted for
+   std::map<uint16_t, uint64_t>                          miner_count_stake;
+   uint64_t                                              total_stake = 0;
+
+   /// accounts whose stake or opinion may have changed since the last maintenance
+   std::set<account_id_type>                             dirty;
+   /// next_maintenance_time the tally was brought up to date for, unset when it has to be rebuilt
+   optional<fc::time_point_sec>                          valid_until;
+
+   void clear_tally()
+   {
+      voters.clear();
+      proxied_stake.clear();
+      opinions.clear();
+      proxy_members.clear();
+      votes.clear();
+      miner_count_stake.clear();
+      total_stake = 0;
+   }
+
+   /// adds a tally counted over a disjoint part of the accounts or opinions
+   void merge( const vote_tally_state& part )
+   {
+      voters.insert( part.voters.begin(), part.voters.end() );
+      for( const auto& item : part.proxied_stake )
+         proxied_stake[item.first] += item.second;
+      for( const auto& item : part.proxy_members )
+         proxy_members[item.first].insert( item.second.begin(), item.second.end() );
+      opinions.insert( part.opinions.begin(), part.opinions.end() );
+      for( const auto& item : part.votes )
+         votes[item.first] += item.second;
+      for( const auto& item : part.miner_count_stake )
+         miner_count_stake[item.first] += item.second;
+      total_stake += part.total_stake;
+   }
+
+   void add_opinion( account_id_type id, const opinion& o )
+   {
+      for( vote_id_type v : o.votes )
+         votes[v.instance()] += o.stake;
+      miner_count_stake[o.num_miner] += o.stake;
+      opinions[id] = o;
+   }
+
+   void remove_opinion( account_id_type id )
+   {
+      auto itr = opinions.find( id );
+      if( itr == opinions.end() )
+         return;
+      for( vote_id_type v : itr->second.votes )
+      {
+         auto vitr = votes.find( v.instance() );
+         vitr->second -= itr->second.stake;
+         if( vitr->second == 0 )
+            votes.erase( vitr );
+      }
+      auto hitr = miner_count_stake.find( itr->second.num_miner );
+      hitr->second -= itr->second.stake;
+      if( hitr->second == 0 )
+         miner_count_stake.erase( hitr );
+      opinions.erase( itr );
+   }
+};
+
+/**
+ * @brief Marks the accounts owning changed balances, vesting balances, statistics and
+ * account objects as dirty in the vote tally.
+ *
+ * Undo goes through the same callbacks, so an account is also marked when a change to it
+ * is rolled back.
+ */
+class vote_tally_observer : public graphene::db::index_observer
+{
+   public:
+      explicit vote_tally_observer( vote_tally_state& state ) : _state( state ) {}
+
+      virtual void on_add( const object& obj ) override    { mark( obj ); }
+      virtual void on_remove( const object& obj ) override { mark( obj ); }
+      virtual void on_modify( const object& obj ) override { mark( obj ); }
+
+   private:
+      void mark( const object& obj )
+      {
+         if( obj.id.is<account_id_type>() )
+            _state.dirty.insert( account_id_type( obj.id ) );
+         else if( obj.id.is<account_balance_id_type>() )
+         {
+            const auto& balance = static_cast<const account_balance_object&>( obj );
+            if( balance.asset_type == asset_id_type() )
+               _state.dirty.insert( balance.owner );
+         }
+         else if( obj.id.is<vesting_balance_id_type>() )
+            _state.dirty.insert( static_cast<const vesting_balance_object&>( obj ).owner );
+         else if( obj.id.is<account_statistics_id_type>() )
+            _state.dirty.insert( static_cast<const account_statistics_object&>( obj ).owner );
+      }
+
+      vote_tally_state& _state;
+};
+
+} } // graphene::chain
@@ -244,5 +244,28 @@ vesting_balance_object_with_info::vesting_balance_object_with_info( const vestin
     allowed_withdraw_time = now;
 }
 
+void vesting_supply_index::object_inserted(const object& obj)
+{
+   assert( dynamic_cast<const vesting_balance_object*>(&obj) ); // for debug only
+   total_balances += static_cast<const vesting_balance_object&>(obj).balance.amount;
+}
+
+void vesting_supply_index::object_removed(const object& obj)
+{
+   assert( dynamic_cast<const vesting_balance_object*>(&obj) ); // for debug only
+   total_balances -= static_cast<const vesting_balance_object&>(obj).balance.amount;
+}
+
+void vesting_supply_index::about_to_modify(const object& before)
+{
+   assert( dynamic_cast<const vesting_balance_object*>(&before) ); // for debug only
+   total_balances -= static_cast<const vesting_balance_object&>(before).balance.amount;
+}
+
+void vesting_supply_index::object_modified(const object& after)
+{
+   assert( dynamic_cast<const vesting_balance_object*>(&after) ); // for debug only
+   total_balances += static_cast<const vesting_balance_object&>(after).balance.amount;
+}
 
 } } // graphene::chain
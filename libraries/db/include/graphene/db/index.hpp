@@ -267,6 +267,15 @@ namespace graphene { namespace db {
             return result;
          }
 
+         /** used by undo to restore removed objects, secondary indexes and observers have to see them again */
+         virtual const object&  insert( object&& obj )override
+         {
+            const auto& result = DerivedIndex::insert( std::move( obj ) );
+            for( const auto& item : _sindex )
+               item->object_inserted( result );
+            on_add( result );
+            return result;
+         }
 
          virtual const object&  create(const std::function<void(object&)>& constructor )override
          {
@@ -0,0 +1,115 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#include <graphene/net/aead_channel.hpp>
+#include <graphene/net/config.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <openssl/evp.h>
+#include <openssl/opensslv.h>
+
+#include <cstring>
+
+namespace graphene { namespace net { namespace detail {
+
+  namespace {
+
+    const EVP_CIPHER* get_cipher( const std::string& algorithm )
+    {
+      if( algorithm == "aes-256-gcm" )
+        return EVP_aes_256_gcm();
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L && !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+      if( algorithm == "chacha20-poly1305" )
+        return EVP_chacha20_poly1305();
+#endif
+      return nullptr;
+    }
+
+  }
+
+  aead_channel::aead_channel( const std::string& algorithm, const fc::sha256& key, bool encrypting ) :
+    algorithm( algorithm ),
+    context( EVP_CIPHER_CTX_new() ),
+    record_counter( 0 ),
+    encrypting( encrypting )
+  {
+    FC_ASSERT( context, "unable to allocate a cipher context" );
+    const EVP_CIPHER* cipher = get_cipher( algorithm );
+    const unsigned char* key_data = reinterpret_cast<const unsigned char*>( key.data() );
+    bool ok = cipher && ( encrypting ?
+      EVP_EncryptInit_ex( context, cipher, nullptr, nullptr, nullptr ) == 1 &&
+      EVP_CIPHER_CTX_ctrl( context, EVP_CTRL_GCM_SET_IVLEN, nonce_size, nullptr ) == 1 &&
+      EVP_EncryptInit_ex( context, nullptr, nullptr, key_data, nullptr ) == 1 :
+      EVP_DecryptInit_ex( context, cipher, nullptr, nullptr, nullptr ) == 1 &&
+      EVP_CIPHER_CTX_ctrl( context, EVP_CTRL_GCM_SET_IVLEN, nonce_size, nullptr ) == 1 &&
+      EVP_DecryptInit_ex( context, nullptr, nullptr, key_data, nullptr ) == 1 );
+    if( !ok )
+      EVP_CIPHER_CTX_free( context );
+    FC_ASSERT( ok, "unable to initialize transport cipher ${algorithm}", ("algorithm", algorithm) );
+  }
+
+  aead_channel::~aead_channel()
+  {
+    EVP_CIPHER_CTX_free( context );
+  }
+
+  bool aead_channel::is_supported( const std::string& algorithm )
+  {
+    return get_cipher( algorithm ) != nullptr;
+  }
+
+  uint32_t aead_channel::record_size( const char* header )
+  {
+    uint32_t size;
+    memcpy( &size, header, sizeof(size) );
+    FC_ASSERT( size > 0 && size <= GRAPHENE_NET_AEAD_MAX_RECORD_SIZE, "invalid record size ${size}", ("size", size) );
+    return size;
+  }
+
+  /** every record gets a new nonce, the record counter.  Each direction has its own key */
+  void aead_channel::next_nonce( unsigned char* nonce )
+  {
+    memset( nonce, 0, nonce_size );
+    uint64_t counter = record_counter++;
+    memcpy( nonce + nonce_size - sizeof(counter), &counter, sizeof(counter) );
+  }
+
+  void aead_channel::seal( const char* plaintext, uint32_t len, char* record )
+  {
+    unsigned char nonce[nonce_size];
+    next_nonce( nonce );
+    memcpy( record, &len, record_header_size );
+    unsigned char* ciphertext = reinterpret_cast<unsigned char*>( record + record_header_size );
+    int out_len = 0;
+    bool ok = EVP_EncryptInit_ex( context, nullptr, nullptr, nullptr, nonce ) == 1 &&
+              EVP_EncryptUpdate( context, nullptr, &out_len, reinterpret_cast<const unsigned char*>( record ), record_header_size ) == 1 &&
+              EVP_EncryptUpdate( context, ciphertext, &out_len, reinterpret_cast<const unsigned char*>( plaintext ), len ) == 1 &&
+              EVP_EncryptFinal_ex( context, ciphertext + out_len, &out_len ) == 1 &&
+              EVP_CIPHER_CTX_ctrl( context, EVP_CTRL_GCM_GET_TAG, tag_size, ciphertext + len ) == 1;
+    FC_ASSERT( ok, "unable to encrypt record" );
+  }
+
+  void aead_channel::open( uint32_t len, const char* body, char* plaintext )
+  {
+    unsigned char nonce[nonce_size];
+    next_nonce( nonce );
+    const unsigned char* ciphertext = reinterpret_cast<const unsigned char*>( body );
+    int out_len = 0;
+    bool ok = EVP_DecryptInit_ex( context, nullptr, nullptr, nullptr, nonce ) == 1 &&
+              EVP_DecryptUpdate( context, nullptr, &out_len, reinterpret_cast<const unsigned char*>( &len ), record_header_size ) == 1 &&
+              EVP_DecryptUpdate( context, reinterpret_cast<unsigned char*>( plaintext ), &out_len, ciphertext, len ) == 1 &&
+              EVP_CIPHER_CTX_ctrl( context, EVP_CTRL_GCM_SET_TAG, tag_size, const_cast<unsigned char*>( ciphertext + len ) ) == 1 &&
+              EVP_DecryptFinal_ex( context, reinterpret_cast<unsigned char*>( plaintext ) + out_len, &out_len ) == 1;
+    FC_ASSERT( ok, "record failed authentication" );
+  }
+
+  fc::sha256 derive_aead_key( const fc::sha512& shared_secret, const fc::ecc::public_key_data& sender_key,
+                              const std::string& algorithm )
+  {
+    fc::sha256::encoder key_encoder;
+    key_encoder.write( (const char*)&shared_secret, sizeof(shared_secret) );
+    key_encoder.write( (const char*)&sender_key, sizeof(sender_key) );
+    key_encoder.write( algorithm.data(), algorithm.size() );
+    return key_encoder.result();
+  }
+
+} } } // graphene::net::detail
@@ -0,0 +1,78 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#include <graphene/net/compact_blocks.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/raw.hpp>
+
+namespace graphene { namespace net {
+
+  compact_block_reconstruction::compact_block_reconstruction( const compact_block_message& compact_block,
+                                                              const std::function<fc::optional<signed_transaction>( uint64_t )>& find_transaction ) :
+    _compact_block( compact_block ),
+    _transactions( compact_block.transactions.size() )
+  {
+    for( uint32_t i = 0; i < _transactions.size(); ++i )
+    {
+      _transactions[i] = find_transaction( compact_block.transactions[i].short_id );
+      if( !_transactions[i] )
+        _missing_indexes.push_back( i );
+    }
+  }
+
+  void compact_block_reconstruction::add_missing_transactions( const compact_block_transactions_message& reply )
+  {
+    FC_ASSERT( reply.block_id == _compact_block.block_id, "The transactions are for block ${reply}, not ${block_id}",
+               ("reply", reply.block_id)("block_id", _compact_block.block_id) );
+    FC_ASSERT( reply.transactions.size() == _missing_indexes.size(), "Got ${count} transactions for the ${missing} missing from the block",
+               ("count", reply.transactions.size())("missing", _missing_indexes.size()) );
+    for( size_t i = 0; i < _missing_indexes.size(); ++i )
+      _transactions[_missing_indexes[i]] = reply.transactions[i];
+    _missing_indexes.clear();
+  }
+
+  message compact_block_reconstruction::rebuild() const
+  {
+    FC_ASSERT( _missing_indexes.empty(), "${missing} transactions of the block are missing", ("missing", _missing_indexes.size()) );
+    signed_block block;
+    static_cast<graphene::chain::signed_block_header&>( block ) = _compact_block.header;
+    block.transactions.reserve( _transactions.size() );
+    for( size_t i = 0; i < _transactions.size(); ++i )
+    {
+      block.transactions.emplace_back( *_transactions[i] );
+      block.transactions.back().operation_results = _compact_block.transactions[i].operation_results;
+    }
+    message rebuilt_message( block_message( std::move( block ) ) );
+    FC_ASSERT( rebuilt_message.id() == _compact_block.item_hash, "Rebuilt block does not match the requested block" );
+    return rebuilt_message;
+  }
+
+  compact_block_transactions_message answer_compact_block_transactions_request( const signed_block& block,
+                                                                                const fetch_compact_block_transactions_message& request,
+                                                                                size_t max_message_size )
+  {
+    FC_ASSERT( request.indexes.size() <= block.transactions.size(), "Asked for ${count} transactions of a block with ${size}",
+               ("count", request.indexes.size())("size", block.transactions.size()) );
+    for( size_t i = 0; i < request.indexes.size(); ++i )
+    {
+      FC_ASSERT( request.indexes[i] < block.transactions.size(), "Requested transaction index ${index} is out of range",
+                 ("index", request.indexes[i]) );
+      FC_ASSERT( i == 0 || request.indexes[i - 1] < request.indexes[i], "Requested transaction indexes are repeated or out of order" );
+    }
+
+    compact_block_transactions_message reply;
+    reply.block_id = request.block_id;
+    // the block id, and the transaction count packed as an unsigned_int of at most 5 bytes
+    size_t reply_size = fc::raw::pack_size( reply.block_id ) + 5;
+    for( uint32_t index : request.indexes )
+    {
+      reply_size += fc::raw::pack_size( static_cast<const signed_transaction&>( block.transactions[index] ) );
+      if( reply_size > max_message_size )
+        return reply;
+    }
+    reply.transactions.reserve( request.indexes.size() );
+    for( uint32_t index : request.indexes )
+      reply.transactions.push_back( block.transactions[index] );
+    return reply;
+  }
+
+} } // graphene::net
@@ -45,6 +45,22 @@ namespace graphene { namespace net {
   const core_message_type_enum check_firewall_reply_message::type            = core_message_type_enum::check_firewall_reply_message_type;
   const core_message_type_enum get_current_connections_request_message::type = core_message_type_enum::get_current_connections_request_message_type;
   const core_message_type_enum get_current_connections_reply_message::type   = core_message_type_enum::get_current_connections_reply_message_type;
+  const core_message_type_enum compact_block_message::type                   = core_message_type_enum::compact_block_message_type;
+  const core_message_type_enum fetch_compact_block_transactions_message::type = core_message_type_enum::fetch_compact_block_transactions_message_type;
+  const core_message_type_enum compact_block_transactions_message::type      = core_message_type_enum::compact_block_transactions_message_type;
+  const core_message_type_enum transport_upgrade_message::type               = core_message_type_enum::transport_upgrade_message_type;
+  const core_message_type_enum fetch_block_headers_message::type             = core_message_type_enum::fetch_block_headers_message_type;
+  const core_message_type_enum block_headers_message::type                   = core_message_type_enum::block_headers_message_type;
+
+  compact_block_message::compact_block_message(const signed_block& block, const item_hash_t& item_hash) :
+    item_hash(item_hash),
+    block_id(block.id()),
+    header(block)
+  {
+    transactions.reserve(block.transactions.size());
+    for (const graphene::chain::processed_transaction& trx : block.transactions)
+      transactions.push_back(compact_transaction{compact_transaction_short_id(trx.id()), trx.operation_results});
+  }
 
 } } // graphene::net
 
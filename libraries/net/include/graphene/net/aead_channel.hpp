@@ -0,0 +1,65 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#pragma once
+
+#include <fc/crypto/elliptic.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/crypto/sha512.hpp>
+
+#include <string>
+
+struct evp_cipher_ctx_st;
+
+namespace graphene { namespace net { namespace detail {
+
+  /**
+   *  One direction of a connection encrypted with an AEAD cipher, used by stcp_socket once
+   *  the peers upgraded the transport.
+   *
+   *  A record is the length of the plaintext, the ciphertext and the tag.  The length is
+   *  authenticated as additional data and every record is sealed with the next value of a
+   *  counter as nonce, so records can neither be altered nor reordered.
+   */
+  struct aead_channel
+  {
+    static const size_t tag_size = 16;
+    static const size_t nonce_size = 12;
+    static const size_t record_header_size = sizeof(uint32_t);
+
+    std::string        algorithm;
+    evp_cipher_ctx_st* context;
+    uint64_t           record_counter;
+    bool               encrypting;
+
+    aead_channel( const std::string& algorithm, const fc::sha256& key, bool encrypting );
+    ~aead_channel();
+
+    /** true if OpenSSL provides the cipher */
+    static bool is_supported( const std::string& algorithm );
+
+    /**
+     *  returns the plaintext length stored in a record header
+     *  @throws fc::exception if it is 0 or above GRAPHENE_NET_AEAD_MAX_RECORD_SIZE
+     */
+    static uint32_t record_size( const char* header );
+
+    /**
+     *  writes the record for len bytes of plaintext to record, which must have room for
+     *  record_header_size + len + tag_size bytes
+     */
+    void seal( const char* plaintext, uint32_t len, char* record );
+
+    /**
+     *  decrypts the body (ciphertext and tag) of a record whose header said it has len bytes of plaintext
+     *  @throws fc::exception if the record fails authentication
+     */
+    void open( uint32_t len, const char* body, char* plaintext );
+
+  private:
+    void next_nonce( unsigned char* nonce );
+  };
+
+  /** the key for the direction sending from the node with the given public key */
+  fc::sha256 derive_aead_key( const fc::sha512& shared_secret, const fc::ecc::public_key_data& sender_key,
+                              const std::string& algorithm );
+
+} } } // graphene::net::detail
@@ -0,0 +1,65 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/message.hpp>
+
+#include <fc/optional.hpp>
+
+#include <functional>
+#include <vector>
+
+namespace graphene { namespace net {
+
+  /**
+   * @brief A compact block being rebuilt from the transactions we already hold.
+   *
+   * The transactions that can't be found by their short id are asked from the peer which
+   * sent the compact block, by their index in the block.  The rebuilt block has to serialize
+   * to exactly the block_message that was requested, which also catches short id collisions
+   * with transactions we hold.
+   */
+  class compact_block_reconstruction
+  {
+  public:
+    compact_block_reconstruction() {}
+
+    /** find_transaction returns nothing for short ids that are unknown or ambiguous */
+    compact_block_reconstruction( const compact_block_message& compact_block,
+                                  const std::function<fc::optional<signed_transaction>( uint64_t )>& find_transaction );
+
+    const compact_block_message& compact_block() const { return _compact_block; }
+
+    /** the indexes of the transactions to ask the peer for, in increasing order */
+    const std::vector<uint32_t>& missing_indexes() const { return _missing_indexes; }
+
+    /**
+     * fills in the transactions of the reply to a request for missing_indexes()
+     * @throws fc::exception if the reply doesn't hold one transaction per missing index, nothing is filled in then
+     */
+    void add_missing_transactions( const compact_block_transactions_message& reply );
+
+    /**
+     * @returns the block_message of the block
+     * @throws fc::exception if a transaction is still missing or the block isn't the one requested
+     */
+    message rebuild() const;
+
+  private:
+    compact_block_message                          _compact_block;
+    std::vector<fc::optional<signed_transaction>>  _transactions;
+    std::vector<uint32_t>                          _missing_indexes;
+  };
+
+  /**
+   * answers a peer asking for the transactions missing from a compact block we sent it.  A peer
+   * only asks for the transactions it could not find, so the indexes must be in increasing order
+   * and within the block
+   * @returns the transactions requested, none if they don't fit in a message of max_message_size
+   * @throws fc::exception if the indexes are repeated, out of order or out of range
+   */
+  compact_block_transactions_message answer_compact_block_transactions_request( const signed_block& block,
+                                                                                const fetch_compact_block_transactions_message& request,
+                                                                                size_t max_message_size );
+
+} } // graphene::net
@@ -68,6 +68,13 @@
  */
 #define GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS        5
 
+/**
+ * Upper bound on the memory the message cache may use for the packed messages
+ * it holds.  When a flood of transactions would exceed it, the oldest messages
+ * are dropped before their time is up.
+ */
+#define GRAPHENE_NET_MESSAGE_CACHE_MAX_SIZE_IN_BYTES         (64 * 1024 * 1024)
+
 /**
  * We prevent a peer from offering us a list of blocks which, if we fetched them
  * all, would result in a blockchain that extended into the future.
@@ -82,17 +89,61 @@
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
 /**
- * During normal operation, how many items will be fetched from each
- * peer at a time.  This will only come into play when the network
- * is being flooded -- typically transactions will be fetched as soon
- * as we find out about them, so only one item will be requested
- * at a time.
- * 
+ * During sync, each peer gets a window of outstanding block requests sized from
+ * the rate it delivers blocks at times its round trip time (plus headroom), so
+ * the next blocks are already on their way while the last ones arrive.  The
+ * window starts at the minimum and is capped by GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING.
+ */
+#define GRAPHENE_NET_MIN_SYNC_REQUEST_WINDOW                 10
+#define GRAPHENE_NET_SYNC_WINDOW_HEADROOM_PERCENT            200
+
+/**
+ * Sync requests are striped over the peers in ranges of this many consecutive
+ * blocks, so every peer works on the blocks we need next.
+ */
+#define GRAPHENE_NET_SYNC_REQUEST_STRIPE_SIZE                20
+
+/**
+ * A sync request still outstanding after this many times the peer's round trip
+ * (but at least the minimum timeout) is handed to another peer.
+ */
+#define GRAPHENE_NET_SYNC_REQUEST_REASSIGN_LATENCY_MULTIPLE  4
+#define GRAPHENE_NET_SYNC_REQUEST_REASSIGN_MIN_TIMEOUT_MS    3000
+
+/**
+ * During normal operation, how many items may be requested from each
+ * peer before it delivers them.  This will only come into play when the
+ * network is being flooded -- typically transactions will be fetched as
+ * soon as we find out about them, from whichever peer that has them is
+ * expected to deliver first.
+ *
  * No tests have been done to find the optimal value for this
  * parameter, so consider increasing or decreasing it if performance
  * during flooding is lacking.
  */
-#define GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION  1 
+#define GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION  20
+
+/**
+ * An item request still outstanding after this many times the peer's round
+ * trip (but at least the minimum timeout) is retried with another peer that
+ * advertised the item.  Until a peer's round trip has been measured, the
+ * default is assumed when choosing peers to fetch from.
+ */
+#define GRAPHENE_NET_ITEM_REQUEST_RETRY_LATENCY_MULTIPLE     4
+#define GRAPHENE_NET_ITEM_REQUEST_RETRY_MIN_TIMEOUT_MS       2000
+#define GRAPHENE_NET_DEFAULT_ITEM_ROUND_TRIP_TIME_MS         250
+
+/**
+ * How many of the compact blocks last sent to a peer it may still ask the missing
+ * transactions of.
+ */
+#define GRAPHENE_NET_MAX_COMPACT_BLOCKS_AWAITING_TRANSACTIONS 8
+
+/**
+ * Smaller messages are left out of the rate we measure for sending to a peer,
+ * their transmission time is mostly overhead.
+ */
+#define GRAPHENE_NET_MIN_MESSAGE_SIZE_FOR_SEND_RATE          4096
 
 /**
  * Instead of fetching all item IDs from a peer, then fetching all blocks
@@ -102,4 +153,37 @@
  */
 #define GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH               10000
 
+/**
+ * With header-first sync, blocks are only requested from a peer once their
+ * headers have been checked: each links to the one before and matches the
+ * checkpoints.  Headers are requested in batches of up to this many, for the
+ * blocks among the next GRAPHENE_NET_SYNC_HEADERS_AHEAD the peer offered, or
+ * all of them up to the last checkpoint: blocks below it are only requested once
+ * the headers lead from it back to our chain.
+ */
+#define GRAPHENE_NET_MAX_BLOCK_HEADERS_PER_REQUEST           2000
+#define GRAPHENE_NET_SYNC_HEADERS_AHEAD                      4000
+
 #define GRAPHENE_NET_MAX_TRX_PER_SECOND                      1000
+
+/**
+ * Transaction inventory is not advertised to a peer as soon as we have it but
+ * collected and sent in one item_ids_inventory_message after a random delay
+ * between half and one and a half times the trickle interval, or as soon as a
+ * full batch is waiting.  Blocks are always advertised right away.
+ */
+#define GRAPHENE_NET_DEFAULT_INVENTORY_TRICKLE_INTERVAL_MS   100
+#define GRAPHENE_NET_MAX_INVENTORY_TRICKLE_BATCH_SIZE        1000
+
+/**
+ * Message bodies of at least this many bytes are compressed before they are
+ * encrypted, if the peer announced it can decompress them.  Small messages
+ * (inventory of a few items, transactions) rarely get smaller.
+ */
+#define GRAPHENE_NET_DEFAULT_COMPRESSION_THRESHOLD           1024
+
+/**
+ * Largest record a connection using an AEAD cipher sends or accepts.  A block
+ * usually fits in one record, so it is encrypted and written in one go.
+ */
+#define GRAPHENE_NET_AEAD_MAX_RECORD_SIZE                    (256 * 1024)
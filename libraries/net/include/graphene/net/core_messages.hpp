@@ -87,6 +87,12 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compact_block_message_type                   = 5018,
+    fetch_compact_block_transactions_message_type = 5019,
+    compact_block_transactions_message_type      = 5020,
+    transport_upgrade_message_type               = 5021,
+    fetch_block_headers_message_type             = 5022,
+    block_headers_message_type                   = 5023,
     core_message_type_last                       = 5099
   };
 
@@ -401,6 +407,111 @@ namespace graphene { namespace net {
     std::vector<current_connection_data> current_connections;
   };
 
+  /** the short id of a transaction in a compact block is the first 8 bytes of its transaction id */
+  inline uint64_t compact_transaction_short_id(const transaction_id_type& id)
+  {
+    uint64_t short_id;
+    memcpy(&short_id, id.data(), sizeof(short_id));
+    return short_id;
+  }
+
+  struct compact_transaction
+  {
+    uint64_t short_id;
+    std::vector<graphene::chain::operation_result> operation_results;
+  };
+
+  /**
+   * A block relayed as its header and the short ids of its transactions, which the receiving
+   * peer has most likely already seen as trx_messages.  It is sent instead of a block_message
+   * when a peer that announced compact_blocks in its hello asks for a compact_block_message_type
+   * item during normal operation.
+   */
+  struct compact_block_message
+  {
+    static const core_message_type_enum type;
+
+    compact_block_message() {}
+    compact_block_message(const signed_block& block, const item_hash_t& item_hash);
+
+    item_hash_t                           item_hash; /// the hash of the block_message the peer asked for
+    block_id_type                         block_id;
+    graphene::chain::signed_block_header  header;
+    std::vector<compact_transaction>      transactions;
+  };
+
+  /** asks for the transactions of a compact block that could not be found locally, by their index in the block in increasing order */
+  struct fetch_compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type         block_id;
+    std::vector<uint32_t> indexes;
+
+    fetch_compact_block_transactions_message() {}
+    fetch_compact_block_transactions_message(const block_id_type& block_id, const std::vector<uint32_t>& indexes) :
+      block_id(block_id),
+      indexes(indexes)
+    {}
+  };
+
+  struct compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type                   block_id;
+    /// in the order they were requested, empty if the block is no longer available
+    std::vector<signed_transaction> transactions;
+  };
+
+  /**
+   *  The last message encrypted with the original aes stream in this direction; everything the
+   *  sender writes after it is sealed in records of the AEAD cipher named here.  Only sent to peers
+   *  which listed the cipher under "transport" in their hello
+   */
+  struct transport_upgrade_message
+  {
+    static const core_message_type_enum type;
+
+    std::string algorithm;
+
+    transport_upgrade_message() {}
+    transport_upgrade_message(const std::string& algorithm) :
+      algorithm(algorithm)
+    {}
+  };
+
+  /**
+   *  During sync, asks a peer which listed "block_headers" in its hello for the headers of
+   *  blocks it offered us, so the header chain can be checked before the blocks are fetched
+   */
+  struct fetch_block_headers_message
+  {
+    static const core_message_type_enum type;
+
+    std::vector<block_id_type> block_ids;
+
+    fetch_block_headers_message() {}
+    fetch_block_headers_message(const std::vector<block_id_type>& block_ids) :
+      block_ids(block_ids)
+    {}
+  };
+
+  /**
+   *  The headers of the requested blocks, in the order requested.  May stop early if the
+   *  peer no longer has some of the blocks
+   */
+  struct block_headers_message
+  {
+    static const core_message_type_enum type;
+
+    std::vector<graphene::chain::signed_block_header> headers;
+
+    block_headers_message() {}
+    block_headers_message(std::vector<graphene::chain::signed_block_header> headers) :
+      headers(std::move(headers))
+    {}
+  };
 
 } } // graphene::net
 
@@ -425,6 +536,12 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compact_block_message_type)
+                 (fetch_compact_block_transactions_message_type)
+                 (compact_block_transactions_message_type)
+                 (transport_upgrade_message_type)
+                 (fetch_block_headers_message_type)
+                 (block_headers_message_type)
                  (core_message_type_last) )
 
 FC_REFLECT( graphene::net::trx_message, (trx) )
@@ -509,6 +626,13 @@ FC_REFLECT(graphene::net::get_current_connections_reply_message, (upload_rate_on
                                                             (upload_rate_one_hour)
                                                             (download_rate_one_hour)
                                                             (current_connections))
+FC_REFLECT(graphene::net::compact_transaction, (short_id)(operation_results))
+FC_REFLECT(graphene::net::compact_block_message, (item_hash)(block_id)(header)(transactions))
+FC_REFLECT(graphene::net::fetch_compact_block_transactions_message, (block_id)(indexes))
+FC_REFLECT(graphene::net::compact_block_transactions_message, (block_id)(transactions))
+FC_REFLECT(graphene::net::transport_upgrade_message, (algorithm))
+FC_REFLECT(graphene::net::fetch_block_headers_message, (block_ids))
+FC_REFLECT(graphene::net::block_headers_message, (headers))
 
 #include <unordered_map>
 #include <fc/crypto/city.hpp>
@@ -30,6 +30,7 @@
 #include <fc/io/raw.hpp>
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/reflect/variant.hpp>
+#include <memory>
 
 namespace graphene { namespace net {
 
@@ -110,6 +111,31 @@ namespace graphene { namespace net {
      }
   };
 
+  /**
+   *  A message in the form it is written to the connection: the header followed by the data,
+   *  padded to a multiple of 16 bytes.  It is immutable and shared, so a message sent to many
+   *  peers is packed once and only encrypted once per connection.
+   */
+  typedef std::shared_ptr<const std::vector<char> > serialized_message_ptr;
+
+  inline serialized_message_ptr serialize_message( const message& message_to_serialize )
+  {
+     size_t size_of_message_and_header = sizeof(message_header) + message_to_serialize.data.size();
+     std::shared_ptr<std::vector<char> > serialized = std::make_shared<std::vector<char> >( 16 * ((size_of_message_and_header + 15) / 16) );
+     memcpy( serialized->data(), static_cast<const message_header*>(&message_to_serialize), sizeof(message_header) );
+     if( !message_to_serialize.data.empty() )
+        memcpy( serialized->data() + sizeof(message_header), message_to_serialize.data.data(), message_to_serialize.data.size() );
+     return serialized;
+  }
+
+  inline message deserialize_message( const serialized_message_ptr& serialized )
+  {
+     message result;
+     memcpy( static_cast<message_header*>(&result), serialized->data(), sizeof(message_header) );
+     result.data.assign( serialized->data() + sizeof(message_header), serialized->data() + sizeof(message_header) + result.size );
+     return result;
+  }
+
 
 
 
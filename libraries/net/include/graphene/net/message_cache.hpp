@@ -0,0 +1,125 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#pragma once
+
+#include <graphene/net/config.hpp>
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/message.hpp>
+#include <graphene/net/node.hpp>
+
+#include <fc/optional.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+
+namespace graphene { namespace net {
+
+  /**
+   * @brief Messages this node received or broadcast recently, kept to answer item requests.
+   *
+   * Messages are serialized once and expire GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS
+   * blocks after they were received.  The cache also stays within a byte budget by evicting
+   * the oldest messages first; compressed copies made for peers count against the budget too.
+   */
+  class blockchain_tied_message_cache
+  {
+  private:
+    static const uint32_t cache_duration_in_blocks = GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS;
+
+    struct message_hash_index{};
+    struct message_contents_hash_index{};
+    struct short_id_index{};
+    struct message_info
+    {
+      message_hash_type message_hash;
+      uint32_t          message_type;
+      uint64_t          short_id; // of the message contents, to find the transactions a compact block refers to
+      serialized_message_ptr serialized_message; // packed once, shared by the send queues of all peers we send it to
+      mutable serialized_message_ptr compressed_message; // the same for peers that take compressed messages, made on first use
+      mutable bool      compression_attempted;
+      uint32_t          block_clock_when_received;
+
+      // for network performance stats
+      message_propagation_data propagation_data;
+      fc::uint160_t     message_contents_hash; // hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
+
+      message_info( const message_hash_type& message_hash,
+                    const message&           message_body,
+                    uint32_t                 block_clock_when_received,
+                    const message_propagation_data& propagation_data,
+                    fc::uint160_t            message_contents_hash ) :
+        message_hash( message_hash ),
+        message_type( message_body.msg_type ),
+        short_id( compact_transaction_short_id( message_contents_hash ) ),
+        serialized_message( serialize_message( message_body ) ),
+        compression_attempted( false ),
+        block_clock_when_received( block_clock_when_received ),
+        propagation_data( propagation_data ),
+        message_contents_hash( message_contents_hash )
+      {}
+
+      size_t size_in_bytes() const
+      {
+        return sizeof(message_info) + serialized_message->size() + ( compressed_message ? compressed_message->size() : 0 );
+      }
+    };
+    // the sequenced index is the insertion order, which is also block clock order
+    typedef boost::multi_index_container
+      < message_info,
+        boost::multi_index::indexed_by<
+          boost::multi_index::sequenced<>,
+          boost::multi_index::hashed_unique< boost::multi_index::tag<message_hash_index>,
+            boost::multi_index::member<message_info, message_hash_type, &message_info::message_hash>,
+            std::hash<message_hash_type> >,
+          boost::multi_index::hashed_non_unique< boost::multi_index::tag<message_contents_hash_index>,
+            boost::multi_index::member<message_info, fc::uint160_t, &message_info::message_contents_hash>,
+            std::hash<fc::uint160_t> >,
+          boost::multi_index::hashed_non_unique< boost::multi_index::tag<short_id_index>,
+            boost::multi_index::member<message_info, uint64_t, &message_info::short_id> > >
+      > message_cache_container;
+
+    message_cache_container _message_cache;
+
+    uint32_t block_clock;
+    size_t   _max_size_in_bytes;
+    size_t   _size_in_bytes; // grows when a message is first compressed
+    mutable uint64_t _hits;
+    mutable uint64_t _misses;
+    uint64_t _messages_evicted; // dropped to stay within the byte budget, before they expired
+
+    void evict_to_budget();
+
+  public:
+    blockchain_tied_message_cache() :
+      block_clock( 0 ),
+      _max_size_in_bytes( GRAPHENE_NET_MESSAGE_CACHE_MAX_SIZE_IN_BYTES ),
+      _size_in_bytes( 0 ),
+      _hits( 0 ),
+      _misses( 0 ),
+      _messages_evicted( 0 )
+    {}
+    void block_accepted();
+    void set_max_size_in_bytes( size_t max_size_in_bytes );
+    size_t get_max_size_in_bytes() const { return _max_size_in_bytes; }
+    void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
+                      const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
+    message get_message( const message_hash_type& hash_of_message_to_lookup );
+    /** @param message_contents_hash if set, receives the transaction id or block_id of the message */
+    /** @param compression_threshold if nonzero, the compressed form of messages at least this large is returned */
+    serialized_message_ptr get_serialized_message( const message_hash_type& hash_of_message_to_lookup,
+                                                   fc::uint160_t* message_contents_hash = nullptr,
+                                                   uint32_t compression_threshold = 0 );
+    message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
+    bool contains( const message_hash_type& hash_of_message_to_lookup ) const
+    {
+      return _message_cache.get<message_hash_index>().find( hash_of_message_to_lookup ) != _message_cache.get<message_hash_index>().end();
+    }
+    fc::optional<signed_transaction> find_transaction( uint64_t short_id ) const;
+    size_t size() const { return _message_cache.size(); }
+    size_t size_in_bytes() const { return _size_in_bytes; }
+    fc::variant_object get_statistics() const;
+  };
+
+} } // graphene::net
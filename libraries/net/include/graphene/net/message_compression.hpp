@@ -0,0 +1,47 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#pragma once
+#include <graphene/net/message.hpp>
+
+namespace graphene { namespace net {
+
+  /**
+   *  Set in message_header::msg_type of a message whose body is compressed on the wire.  The
+   *  body then starts with the uncompressed size as a little-endian uint32_t, followed by the
+   *  zlib stream.  Compression is done on the serialized message before it is encrypted, and
+   *  undone by the receiving connection, so the rest of the node never sees compressed messages
+   *  and message ids are computed over the uncompressed body.
+   */
+  const uint32_t compressed_message_flag = 0x80000000;
+
+  /** name of the algorithm advertised in the "compression" field of the hello user_data */
+  const char* const message_compression_algorithm = "zlib";
+
+  inline bool is_compressed_message( const serialized_message_ptr& serialized )
+  {
+     return (reinterpret_cast<const message_header*>(serialized->data())->msg_type & compressed_message_flag) != 0;
+  }
+
+  /** @return the size of the body of a serialized message before it was compressed */
+  inline uint32_t uncompressed_body_size( const serialized_message_ptr& serialized )
+  {
+     const message_header& header = *reinterpret_cast<const message_header*>(serialized->data());
+     if (!(header.msg_type & compressed_message_flag))
+        return header.size;
+     uint32_t uncompressed_size;
+     memcpy(&uncompressed_size, serialized->data() + sizeof(message_header), sizeof(uncompressed_size));
+     return uncompressed_size;
+  }
+
+  /**
+   *  @return the message with its body compressed, or nullptr if compressing doesn't make it
+   *  smaller
+   */
+  serialized_message_ptr compress_message( const serialized_message_ptr& serialized );
+
+  /**
+   *  Replaces a compressed message with the original.  Throws if the body is corrupt or would
+   *  expand beyond MAX_MESSAGE_SIZE.
+   */
+  message decompress_message( const message& compressed );
+
+} } // graphene::net
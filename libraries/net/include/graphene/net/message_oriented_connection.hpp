@@ -24,6 +24,7 @@
 #pragma once
 #include <fc/network/tcp_socket.hpp>
 #include <graphene/net/message.hpp>
+#include <fc/variant_object.hpp>
 
 namespace graphene { namespace net {
 
@@ -52,6 +53,11 @@ namespace graphene { namespace net {
        void connect_to(const fc::ip::endpoint& remote_endpoint);
 
        void send_message(const message& message_to_send);
+       void send_serialized_message(const serialized_message_ptr& message_to_send);
+       /** compress outgoing message bodies of at least this many bytes, 0 disables compression.
+        * Only enable it once the peer said it can decompress them */
+       void set_compression_threshold(uint32_t threshold);
+       uint32_t get_compression_threshold() const;
        void close_connection();
        void destroy_connection();
 
@@ -61,6 +67,9 @@ namespace graphene { namespace net {
        fc::time_point get_last_message_received_time() const;
        fc::time_point get_connection_time() const;
        fc::sha512     get_shared_secret() const;
+       fc::variant_object get_compression_statistics() const;
+       /** the cipher protecting each direction, the AEAD ones once the peer upgraded */
+       fc::variant_object get_transport_ciphers() const;
      private:
        std::unique_ptr<detail::message_oriented_connection_impl> my;
   };
@@ -115,6 +115,12 @@ namespace graphene { namespace net {
           */
          virtual message get_item( const item_id& id ) = 0;
 
+         /**
+          *  Returns the headers of the given blocks, in order, stopping at the first block
+          *  we don't have.
+          */
+         virtual std::vector<graphene::chain::signed_block_header> get_block_headers( const std::vector<item_hash_t>& block_ids ) = 0;
+
          virtual chain_id_type get_chain_id()const = 0;
 
          /**
@@ -267,6 +273,11 @@ namespace graphene { namespace net {
            edump((trx));
            broadcast( trx_message(trx) );
         }
+        /**
+         *  Add a batch of transactions to the outgoing inventory and advertise
+         *  them to every peer in one inventory message.
+         */
+        virtual void  broadcast_transactions( const std::vector<signed_transaction>& transactions );
 
         /**
          *  Node starts the process of fetching all items after item_id of the
@@ -274,6 +285,12 @@ namespace graphene { namespace net {
          */
         virtual void      sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers);
 
+        /**
+         * Block ids by block number that the chain we sync must contain.  Peers offering
+         * other blocks at these numbers are disconnected during sync
+         */
+        void add_checkpoints(const std::map<uint32_t, item_hash_t>& checkpoints);
+
         bool      is_connected() const;
 
         void set_advanced_node_parameters(const fc::variant_object& params);
@@ -293,6 +310,14 @@ namespace graphene { namespace net {
 
         fc::variant_object network_get_info() const;
         fc::variant_object network_get_usage_stats() const;
+        /**
+         * @return counters for messages and bytes by message type and by peer, queue depths,
+         *         the sync backlog, duplicate items, message handling times and the node
+         *         delegate call timings from get_call_statistics()
+         */
+        fc::variant_object network_get_metrics() const;
+        /** @return network_get_metrics() in the Prometheus text format */
+        std::string network_get_metrics_text() const;
 
         std::vector<potential_peer_record> get_potential_peers() const;
 
@@ -315,6 +340,7 @@ namespace graphene { namespace net {
 
       void      sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers) override {}
       void      broadcast(const message& item_to_broadcast) override;
+      void      broadcast_transactions(const std::vector<signed_transaction>& transactions) override;
       void      add_node_delegate(node_delegate* node_delegate_to_add);
 
       virtual uint32_t get_connection_count() const override { return 8; }
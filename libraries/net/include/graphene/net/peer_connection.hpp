@@ -24,6 +24,8 @@
 #pragma once
 
 #include <graphene/net/node.hpp>
+#include <graphene/net/compact_blocks.hpp>
+#include <graphene/net/slow_requests.hpp>
 #include <graphene/net/peer_database.hpp>
 #include <graphene/net/message_oriented_connection.hpp>
 #include <graphene/net/stcp_socket.hpp>
@@ -40,6 +42,7 @@
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+#include <deque>
 #include <queue>
 #include <boost/container/deque.hpp>
 #include <fc/thread/future.hpp>
@@ -69,8 +72,28 @@ namespace graphene { namespace net
                               const message& received_message) = 0;
       virtual void on_connection_closed(peer_connection* originating_peer) = 0;
       virtual message get_message_for_item(const item_id& item) = 0;
+      virtual serialized_message_ptr get_serialized_message_for_item(const item_id& item) = 0;
     };
 
+    /** messages and bytes exchanged with a peer for one message type, bytes are counted
+     * uncompressed and include the message header */
+    struct message_traffic_counters
+    {
+      uint64_t messages_received = 0;
+      uint64_t bytes_received = 0;
+      uint64_t messages_sent = 0;
+      uint64_t bytes_sent = 0;
+
+      void merge(const message_traffic_counters& other)
+      {
+        messages_received += other.messages_received;
+        bytes_received += other.bytes_received;
+        messages_sent += other.messages_sent;
+        bytes_sent += other.bytes_sent;
+      }
+    };
+    typedef std::map<uint32_t, message_traffic_counters> message_traffic_by_type;
+
     class peer_connection;
     typedef std::shared_ptr<peer_connection> peer_connection_ptr;
     class peer_connection : public message_oriented_connection_delegate,
@@ -124,6 +147,11 @@ namespace graphene { namespace net
         {}
 
         virtual message get_message(peer_connection_delegate* node) = 0;
+        /** the message as it goes on the wire, only the encryption is left to the connection */
+        virtual serialized_message_ptr get_serialized_message(peer_connection_delegate* node)
+        {
+          return serialize_message(get_message(node));
+        }
         /** returns roughly the number of bytes of memory the message is consuming while
          * it is sitting on the queue
          */
@@ -162,6 +190,24 @@ namespace graphene { namespace net
         {}
 
         message get_message(peer_connection_delegate* node) override;
+        serialized_message_ptr get_serialized_message(peer_connection_delegate* node) override;
+        size_t get_size_in_queue() override;
+      };
+
+      /* when you queue up a 'shared_queued_message', the queue holds a reference to a message
+       * that was serialized once for all the peers it is sent to (e.g., an item from the
+       * node's message cache)
+       */
+      struct shared_queued_message : queued_message
+      {
+        serialized_message_ptr message_to_send;
+
+        shared_queued_message(serialized_message_ptr message_to_send) :
+          message_to_send(std::move(message_to_send))
+        {}
+
+        message get_message(peer_connection_delegate* node) override;
+        serialized_message_ptr get_serialized_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -230,6 +276,16 @@ namespace graphene { namespace net
       item_hash_t last_block_delegate_has_seen; /// the hash of the last block  this peer has told us about that the peer knows
       fc::time_point_sec last_block_time_delegate_has_seen;
       bool inhibit_fetching_sync_blocks;
+      uint32_t sync_request_window; /// how many sync blocks may be requested from this peer at once
+      fc::microseconds sync_min_latency; /// shortest recent time between requesting a sync block and receiving it
+      double sync_blocks_per_second; /// smoothed rate this peer delivers sync blocks at
+      fc::time_point sync_rate_period_start;
+      uint32_t sync_blocks_in_rate_period;
+      handed_over_requests reassigned_sync_items; /// sync requests handed to another peer because this one was too slow, its blocks are still accepted until they time out
+      std::vector<item_hash_t> sync_headers_requested_from_peer; /// blocks whose headers we asked this peer for, empty if no request is outstanding
+      item_hash_t sync_headers_requested_after; /// the block the first of them should link to, zero if we don't know it
+      fc::time_point sync_headers_request_time;
+      size_t sync_headers_known_prefix; /// leading ids_of_items_to_get whose headers we have, where the next scan for headers to request starts
       /// @}
 
       /// non-synchronization state data
@@ -252,7 +308,25 @@ namespace graphene { namespace net
       timestamped_items_set_type inventory_peer_advertised_to_us;
       timestamped_items_set_type inventory_advertised_to_peer;
 
+      std::vector<item_id> inventory_to_trickle; /// items waiting to be advertised to this peer in the next batch
+      fc::time_point next_inventory_trickle_time; /// when inventory_to_trickle is sent, if not filled up before
+
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
+      handed_over_requests retried_items; /// item requests handed to another peer because this one was too slow, its items are still accepted until they time out
+      fc::microseconds item_round_trip_time; /// smoothed time between a fetch request going out and the item arriving, 0 until measured
+      double item_bytes_per_second; /// smoothed rate this peer delivers requested items at
+      double item_average_size; /// smoothed size of the items this peer delivered
+      fc::time_point last_item_received_time;
+      double send_bytes_per_second; /// smoothed rate our larger messages to this peer go out at
+
+      bool supports_compact_blocks; /// set if the peer's hello said it can send compact_block_messages
+      bool supports_compression; /// set if the peer's hello said it can read compressed messages
+      bool supports_block_headers; /// set if the peer's hello said it answers fetch_block_headers_messages
+      std::string aead_transport_algorithm; /// the AEAD cipher we and the peer both support, empty if none
+      /// compact blocks whose transactions were not all in our message cache, waiting for the rest from this peer
+      std::map<block_id_type, compact_block_reconstruction> partial_compact_blocks;
+      /// the last compact blocks we sent this peer, it may ask for the transactions of each of them once
+      std::deque<block_id_type> compact_blocks_sent;
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
@@ -264,6 +338,8 @@ namespace graphene { namespace net
       fc::future<void> accept_or_connect_task_done;
 
       firewall_check_state_data *firewall_check_state;
+
+      message_traffic_by_type message_traffic; /// counters by message type, for the metrics
 #ifndef NDEBUG
     private:
       fc::thread* _thread;
@@ -286,11 +362,14 @@ namespace graphene { namespace net
       void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
       void send_item(const item_id& item_to_send);
+      void send_serialized_message(const serialized_message_ptr& message_to_send);
       void close_connection();
       void destroy_connection();
 
       uint64_t get_total_bytes_sent() const;
       uint64_t get_total_bytes_received() const;
+      size_t get_total_queued_messages_size() const { return _total_queued_messages_size; }
+      size_t get_number_of_queued_messages() const { return _queued_messages.size(); }
 
       fc::time_point get_last_message_sent_time() const;
       fc::time_point get_last_message_received_time() const;
@@ -304,6 +383,10 @@ namespace graphene { namespace net
 
       bool is_transaction_fetching_inhibited() const;
       fc::sha512 get_shared_secret() const;
+      void set_compression_threshold(uint32_t threshold);
+      uint32_t get_compression_threshold() const;
+      fc::variant_object get_compression_statistics() const;
+      fc::variant_object get_transport_ciphers() const;
       void clear_old_inventory();
       bool is_inventory_advertised_to_us_list_full_for_transactions() const;
       bool is_inventory_advertised_to_us_list_full() const;
@@ -311,6 +394,7 @@ namespace graphene { namespace net
       fc::optional<fc::ip::endpoint> get_endpoint_for_connecting() const;
     private:
       void send_queued_messages_task();
+      void update_transmission_statistics(const queued_message& sent_message, const serialized_message_ptr& message_sent);
       void accept_connection_task();
       void connect_to_task(const fc::ip::endpoint& remote_endpoint);
     };
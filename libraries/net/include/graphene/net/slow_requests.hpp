@@ -0,0 +1,59 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+
+#include <fc/optional.hpp>
+#include <fc/time.hpp>
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace graphene { namespace net {
+
+  /**
+   * @brief The requests to a peer that were handed to another peer because this one was too slow.
+   *
+   * They are still waited for: the item is accepted when it arrives late instead of counting
+   * as one we never asked for, and a peer that never sends it still runs into the request
+   * timeout.  Only outstanding requests are handed over, so there are never more of them than
+   * the peer was asked for at once.
+   */
+  class handed_over_requests
+  {
+  public:
+    typedef std::unordered_map<item_id, fc::time_point> item_to_time_map_type;
+
+    /**
+     * moves the requests older than allowed_latency which another peer can take over from
+     * requests to here
+     * @param can_take_over true if another peer offers the item and may be asked for it
+     * @returns the items handed over
+     */
+    std::vector<item_id> hand_over_slow_requests( item_to_time_map_type& requests, const fc::time_point& now,
+                                                  const fc::microseconds& allowed_latency,
+                                                  const std::function<bool( const item_id& )>& can_take_over );
+
+    bool contains( const item_id& item ) const { return _requests.find( item ) != _requests.end(); }
+
+    /**
+     * forgets the request once the peer sent the item or said it doesn't have it
+     * @returns true if the item was handed over, false if we never asked this peer for it
+     */
+    bool remove( const item_id& item ) { return _requests.erase( item ) != 0; }
+
+    /** forgets the requests of the items no longer worth waiting for */
+    void remove_if( const std::function<bool( const item_id& )>& expired );
+
+    /** @returns an item this peer was asked for before threshold and never sent, if any */
+    fc::optional<item_id> find_requested_before( const fc::time_point& threshold ) const;
+
+    bool empty() const { return _requests.empty(); }
+    size_t size() const { return _requests.size(); }
+
+  private:
+    item_to_time_map_type _requests; /// with the time this peer was asked
+  };
+
+} } // graphene::net
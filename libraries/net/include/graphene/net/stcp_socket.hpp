@@ -26,11 +26,23 @@
 #include <fc/crypto/aes.hpp>
 #include <fc/crypto/elliptic.hpp>
 
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace graphene { namespace net {
 
+namespace detail { struct aead_channel; }
+
 /**
  *  Uses ECDH to negotiate a aes key for communicating
  *  with other nodes on the network.
+ *
+ *  After the connection is established, either direction can be switched from the aes stream
+ *  to an AEAD cipher.  The stream is then sent as records of up to GRAPHENE_NET_AEAD_MAX_RECORD_SIZE
+ *  bytes, each one authenticated.  Switching is coordinated by the caller: the sender calls
+ *  enable_aead_send() right after writing a message that tells the peer to call
+ *  enable_aead_receive() before reading any further.
  */
 class stcp_socket : public virtual fc::iostream
 {
@@ -56,8 +68,17 @@ class stcp_socket : public virtual fc::iostream
     using istream::get;
     void             get( char& c ) { read( &c, 1 ); }
     fc::sha512       get_shared_secret() const { return _shared_secret; }
+
+    /** AEAD ciphers available through OpenSSL, most preferred first */
+    static std::vector<std::string> get_supported_aead_algorithms();
+    void             enable_aead_send( const std::string& algorithm );
+    void             enable_aead_receive( const std::string& algorithm );
+    std::string      get_send_algorithm() const;
+    std::string      get_receive_algorithm() const;
   private:
     void do_key_exchange();
+    size_t aead_readsome( char* buffer, size_t len );
+    size_t aead_writesome( const char* buffer, size_t len );
 
     fc::sha512           _shared_secret;
     fc::ecc::private_key _priv_key;
@@ -68,6 +89,18 @@ class stcp_socket : public virtual fc::iostream
     fc::aes_decoder      _recv_aes;
     std::shared_ptr<char> _read_buffer;
     std::shared_ptr<char> _write_buffer;
+
+    fc::ecc::public_key_data _local_public_key;
+    fc::ecc::public_key_data _remote_public_key;
+    std::unique_ptr<detail::aead_channel> _send_aead;
+    std::unique_ptr<detail::aead_channel> _recv_aead;
+    std::shared_ptr<char> _aead_read_buffer;
+    size_t                _aead_read_buffer_size;
+    size_t                _aead_plaintext_offset; /// position of the next unread decrypted byte in _aead_plaintext
+    size_t                _aead_plaintext_size;
+    std::shared_ptr<char> _aead_plaintext;
+    std::shared_ptr<char> _aead_write_buffer;
+    size_t                _aead_write_buffer_size;
 #ifndef NDEBUG
     bool _read_buffer_in_use;
     bool _write_buffer_in_use;
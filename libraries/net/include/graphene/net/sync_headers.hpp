@@ -0,0 +1,76 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+
+#include <fc/optional.hpp>
+
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace graphene { namespace net {
+
+  /**
+   * @brief The block headers a syncing node checked before it asks for the blocks themselves.
+   *
+   * Each batch of headers must be the one of the blocks a peer offered, link to the block
+   * before it and match the checkpoints.  Below the last checkpoint the chain applies blocks
+   * without checking them, so there a block is only accepted once the headers form an
+   * unbroken chain from the last checkpoint back to a block we have.  The ids of the headers
+   * commit to the ones before, so that chain is pinned by the checkpoint.  Miner signatures
+   * are left to the chain, which knows the keys.
+   */
+  class sync_header_chain
+  {
+  public:
+    /** ignores checkpoints without a block id */
+    void add_checkpoints( const std::map<uint32_t, item_hash_t>& checkpoints );
+
+    /** true if the block has the number of a checkpoint but another id */
+    bool contradicts_checkpoint( const item_hash_t& block_id ) const;
+
+    /** 0 without checkpoints */
+    uint32_t last_checkpoint_block_num() const;
+
+    /**
+     * checks the headers a peer sent for the blocks requested, the first one must link to
+     * previous unless it is zero.  A peer may send fewer headers than requested
+     * @returns the number of headers accepted
+     * @throws fc::exception naming the first header that fails a check, nothing is accepted then
+     */
+    size_t accept_headers( const std::vector<item_hash_t>& requested, const item_hash_t& previous,
+                           const std::vector<graphene::chain::signed_block_header>& headers );
+
+    /** true if the header of the block was accepted, whether or not its block may be fetched yet */
+    bool has_header( const item_hash_t& block_id ) const;
+
+    /** true if the block may be fetched */
+    bool is_accepted( const item_hash_t& block_id ) const;
+
+    /**
+     * follows the accepted headers back from the last checkpoint, continuing where the last
+     * call stopped.  have_block is only asked about blocks numbered up to head_block_num
+     * @returns true once they reach a block we have or the start of the chain
+     */
+    bool reached_last_checkpoint( uint32_t head_block_num, const std::function<bool( const item_hash_t& )>& have_block );
+
+    /** called once the block was received */
+    void forget( const item_hash_t& block_id );
+
+    /** drops every header, the checkpoints are kept */
+    void clear();
+
+    size_t size() const { return _headers.size() + _pinned.size(); }
+
+  private:
+    std::map<uint32_t, item_hash_t>              _checkpoints;
+    std::unordered_map<item_hash_t, item_hash_t> _headers; /// accepted headers not yet known to lead to the last checkpoint, id to previous
+    std::unordered_set<item_hash_t>              _pinned; /// headers on the chain leading to the last checkpoint
+    fc::optional<item_hash_t>                    _walk_position; /// the block the walk from the last checkpoint stopped at
+    bool                                         _last_checkpoint_reached = false;
+  };
+
+} } // graphene::net
@@ -0,0 +1,143 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#include <graphene/net/message_cache.hpp>
+#include <graphene/net/message_compression.hpp>
+
+#include <fc/exception/exception.hpp>
+
+namespace graphene { namespace net {
+
+  void blockchain_tied_message_cache::block_accepted()
+  {
+    ++block_clock;
+    if( block_clock > cache_duration_in_blocks )
+      while( !_message_cache.empty() &&
+             _message_cache.front().block_clock_when_received < block_clock - cache_duration_in_blocks )
+      {
+        _size_in_bytes -= _message_cache.front().size_in_bytes();
+        _message_cache.pop_front();
+      }
+  }
+
+  void blockchain_tied_message_cache::evict_to_budget()
+  {
+    // always keep the newest message, even if it alone is over the budget
+    while( _size_in_bytes > _max_size_in_bytes && _message_cache.size() > 1 )
+    {
+      _size_in_bytes -= _message_cache.front().size_in_bytes();
+      _message_cache.pop_front();
+      ++_messages_evicted;
+    }
+  }
+
+  void blockchain_tied_message_cache::set_max_size_in_bytes( size_t max_size_in_bytes )
+  {
+    _max_size_in_bytes = max_size_in_bytes;
+    evict_to_budget();
+  }
+
+  fc::variant_object blockchain_tied_message_cache::get_statistics() const
+  {
+    fc::mutable_variant_object statistics;
+    statistics["messages"] = _message_cache.size();
+    statistics["size_in_bytes"] = _size_in_bytes;
+    statistics["max_size_in_bytes"] = _max_size_in_bytes;
+    statistics["hits"] = _hits;
+    statistics["misses"] = _misses;
+    statistics["messages_evicted"] = _messages_evicted;
+    return statistics;
+  }
+
+  void blockchain_tied_message_cache::cache_message( const message& message_to_cache,
+                                                   const message_hash_type& hash_of_message_to_cache,
+                                                   const message_propagation_data& propagation_data,
+                                                   const fc::uint160_t& message_content_hash )
+  {
+    if( _message_cache.get<message_hash_index>().find( hash_of_message_to_cache ) != _message_cache.get<message_hash_index>().end() )
+      return;
+    auto result = _message_cache.push_back( message_info(hash_of_message_to_cache,
+                                                         message_to_cache,
+                                                         block_clock,
+                                                         propagation_data,
+                                                         message_content_hash ) );
+    _size_in_bytes += result.first->size_in_bytes();
+    evict_to_budget();
+  }
+
+  message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
+  {
+    message_cache_container::index<message_hash_index>::type::const_iterator iter =
+       _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
+    if( iter != _message_cache.get<message_hash_index>().end() )
+    {
+      ++_hits;
+      return deserialize_message( iter->serialized_message );
+    }
+    ++_misses;
+    FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+  }
+
+  serialized_message_ptr blockchain_tied_message_cache::get_serialized_message( const message_hash_type& hash_of_message_to_lookup,
+                                                                                fc::uint160_t* message_contents_hash,
+                                                                                uint32_t compression_threshold )
+  {
+    message_cache_container::index<message_hash_index>::type::const_iterator iter =
+       _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
+    if( iter == _message_cache.get<message_hash_index>().end() )
+    {
+      ++_misses;
+      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+    }
+    ++_hits;
+    if( message_contents_hash )
+      *message_contents_hash = iter->message_contents_hash;
+    if( compression_threshold &&
+        reinterpret_cast<const message_header*>( iter->serialized_message->data() )->size >= compression_threshold )
+    {
+      if( !iter->compression_attempted )
+      {
+        iter->compressed_message = compress_message( iter->serialized_message );
+        iter->compression_attempted = true;
+        if( iter->compressed_message )
+        {
+          serialized_message_ptr result = iter->compressed_message;
+          _size_in_bytes += result->size();
+          // the copy may push the cache over its budget, the caller keeps the result alive if it goes
+          evict_to_budget();
+          return result;
+        }
+      }
+      if( iter->compressed_message )
+        return iter->compressed_message;
+    }
+    return iter->serialized_message;
+  }
+
+  message_propagation_data blockchain_tied_message_cache::get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const
+  {
+    if( hash_of_message_contents_to_lookup != fc::uint160_t() )
+    {
+      message_cache_container::index<message_contents_hash_index>::type::const_iterator iter =
+         _message_cache.get<message_contents_hash_index>().find(hash_of_message_contents_to_lookup );
+      if( iter != _message_cache.get<message_contents_hash_index>().end() )
+        return iter->propagation_data;
+    }
+    FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+  }
+
+  fc::optional<signed_transaction> blockchain_tied_message_cache::find_transaction( uint64_t short_id ) const
+  {
+    fc::optional<signed_transaction> result;
+    auto range = _message_cache.get<short_id_index>().equal_range( short_id );
+    for( auto iter = range.first; iter != range.second; ++iter )
+    {
+      if( iter->message_type != trx_message_type )
+        continue;
+      // an ambiguous short id is treated as missing, the block will ask for it
+      if( result )
+        return fc::optional<signed_transaction>();
+      result = deserialize_message( iter->serialized_message ).as<trx_message>().trx;
+    }
+    return result;
+  }
+
+} } // graphene::net
@@ -0,0 +1,59 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#include <graphene/net/message_compression.hpp>
+#include <graphene/net/config.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <zlib.h>
+
+namespace graphene { namespace net {
+
+  serialized_message_ptr compress_message( const serialized_message_ptr& serialized )
+  {
+     const message_header& header = *reinterpret_cast<const message_header*>(serialized->data());
+     FC_ASSERT( !(header.msg_type & compressed_message_flag), "message is already compressed" );
+     const Bytef* body = reinterpret_cast<const Bytef*>(serialized->data() + sizeof(message_header));
+
+     uLongf compressed_size = compressBound( header.size );
+     std::vector<char> compressed( sizeof(message_header) + sizeof(uint32_t) + compressed_size );
+     if( compress2( reinterpret_cast<Bytef*>(compressed.data() + sizeof(message_header) + sizeof(uint32_t)), &compressed_size,
+                    body, header.size, Z_BEST_SPEED ) != Z_OK )
+        return serialized_message_ptr();
+
+     size_t compressed_body_size = sizeof(uint32_t) + compressed_size;
+     size_t size_with_padding = 16 * ((sizeof(message_header) + compressed_body_size + 15) / 16);
+     if( size_with_padding >= serialized->size() )
+        return serialized_message_ptr();
+
+     message_header compressed_header;
+     compressed_header.size = (uint32_t)compressed_body_size;
+     compressed_header.msg_type = header.msg_type | compressed_message_flag;
+     memcpy( compressed.data(), &compressed_header, sizeof(message_header) );
+     memcpy( compressed.data() + sizeof(message_header), &header.size, sizeof(uint32_t) );
+     compressed.resize( size_with_padding );
+     return std::make_shared<const std::vector<char> >( std::move(compressed) );
+  }
+
+  message decompress_message( const message& compressed )
+  {
+     FC_ASSERT( compressed.msg_type & compressed_message_flag );
+     FC_ASSERT( compressed.data.size() >= sizeof(uint32_t), "compressed message is truncated" );
+     uint32_t uncompressed_size;
+     memcpy( &uncompressed_size, compressed.data.data(), sizeof(uint32_t) );
+     FC_ASSERT( uncompressed_size <= MAX_MESSAGE_SIZE, "compressed message expands beyond the maximum message size",
+                ("uncompressed_size", uncompressed_size)("MAX_MESSAGE_SIZE", MAX_MESSAGE_SIZE) );
+
+     message result;
+     result.msg_type = compressed.msg_type & ~compressed_message_flag;
+     result.size = uncompressed_size;
+     result.data.resize( uncompressed_size );
+     uLongf decompressed_size = uncompressed_size;
+     int status = uncompress( reinterpret_cast<Bytef*>(result.data.data()), &decompressed_size,
+                              reinterpret_cast<const Bytef*>(compressed.data.data() + sizeof(uint32_t)),
+                              compressed.data.size() - sizeof(uint32_t) );
+     FC_ASSERT( status == Z_OK && decompressed_size == uncompressed_size, "unable to decompress message",
+                ("status", status)("msg_type", result.msg_type) );
+     return result;
+  }
+
+} } // graphene::net
@@ -29,6 +29,8 @@
 #include <fc/io/enum_type.hpp>
 
 #include <graphene/net/message_oriented_connection.hpp>
+#include <graphene/net/message_compression.hpp>
+#include <graphene/net/core_messages.hpp>
 #include <graphene/net/stcp_socket.hpp>
 #include <graphene/net/config.hpp>
 
@@ -56,6 +58,14 @@ namespace graphene { namespace net {
       uint64_t _bytes_received;
       uint64_t _bytes_sent;
 
+      uint32_t _compression_threshold;
+      uint64_t _messages_compressed;
+      uint64_t _bytes_saved_sending;
+      fc::microseconds _time_spent_compressing;
+      uint64_t _messages_decompressed;
+      uint64_t _bytes_saved_receiving;
+      fc::microseconds _time_spent_decompressing;
+
       fc::time_point _connected_time;
       fc::time_point _last_message_received_time;
       fc::time_point _last_message_sent_time;
@@ -79,6 +89,9 @@ namespace graphene { namespace net {
       ~message_oriented_connection_impl();
 
       void send_message(const message& message_to_send);
+      void send_serialized_message(const serialized_message_ptr& message_to_send);
+      void set_compression_threshold(uint32_t threshold) { _compression_threshold = threshold; }
+      uint32_t get_compression_threshold() const { return _compression_threshold; }
       void close_connection();
       void destroy_connection();
 
@@ -89,6 +102,8 @@ namespace graphene { namespace net {
       fc::time_point get_last_message_received_time() const;
       fc::time_point get_connection_time() const { return _connected_time; }
       fc::sha512 get_shared_secret() const;
+      fc::variant_object get_compression_statistics() const;
+      fc::variant_object get_transport_ciphers() const;
     };
 
     message_oriented_connection_impl::message_oriented_connection_impl(message_oriented_connection* self,
@@ -97,6 +112,11 @@ namespace graphene { namespace net {
       _delegate(delegate),
       _bytes_received(0),
       _bytes_sent(0),
+      _compression_threshold(0),
+      _messages_compressed(0),
+      _bytes_saved_sending(0),
+      _messages_decompressed(0),
+      _bytes_saved_receiving(0),
       _send_message_in_progress(false)
 #ifndef NDEBUG
       ,_thread(&fc::thread::current())
@@ -172,8 +192,26 @@ namespace graphene { namespace net {
           }
           m.data.resize(m.size); // truncate off the padding bytes
 
+          if (m.msg_type & compressed_message_flag)
+          {
+            fc::time_point decompression_start_time = fc::time_point::now();
+            size_t compressed_size = m.size;
+            m = decompress_message(m);
+            _time_spent_decompressing += fc::time_point::now() - decompression_start_time;
+            ++_messages_decompressed;
+            if (m.size > compressed_size)
+              _bytes_saved_receiving += m.size - compressed_size;
+          }
+
           _last_message_received_time = fc::time_point::now();
 
+          if (m.msg_type == transport_upgrade_message_type)
+          {
+            // the peer seals everything after this message, the delegate never needs to see it
+            _sock.enable_aead_receive(m.as<transport_upgrade_message>().algorithm);
+            continue;
+          }
+
           try
           {
             // message handling errors are warnings...
@@ -229,6 +267,12 @@ namespace graphene { namespace net {
     void message_oriented_connection_impl::send_message(const message& message_to_send)
     {
       VERIFY_CORRECT_THREAD();
+      send_serialized_message(serialize_message(message_to_send));
+    }
+
+    void message_oriented_connection_impl::send_serialized_message(const serialized_message_ptr& message_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
 #if 0 // this gets too verbose
 #ifndef NDEBUG
       fc::optional<fc::ip::endpoint> remote_endpoint;
@@ -255,18 +299,41 @@ namespace graphene { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
-        if( message_to_send.size > MAX_MESSAGE_SIZE )
+        serialized_message_ptr serialized = message_to_send;
+        if (is_compressed_message(serialized))
+        {
+          // compressed by the sender's message cache, which only hands those to peers that can
+          // read them.  Still, never put one on the wire if this peer didn't ask for them
+          if (!_compression_threshold)
+            serialized = serialize_message(decompress_message(deserialize_message(serialized)));
+        }
+        else if (_compression_threshold &&
+                 reinterpret_cast<const message_header*>(serialized->data())->size >= _compression_threshold)
+        {
+          fc::time_point compression_start_time = fc::time_point::now();
+          serialized_message_ptr compressed = compress_message(serialized);
+          _time_spent_compressing += fc::time_point::now() - compression_start_time;
+          if (compressed)
+            serialized = compressed;
+        }
+
+        const message_header& header = *reinterpret_cast<const message_header*>(serialized->data());
+        if( header.size > MAX_MESSAGE_SIZE )
            elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
-        _sock.write(padded_message.get(), size_with_padding);
+        if (header.msg_type & compressed_message_flag)
+        {
+          uint32_t uncompressed_size = uncompressed_body_size(serialized);
+          ++_messages_compressed;
+          if (uncompressed_size > header.size)
+            _bytes_saved_sending += uncompressed_size - header.size;
+        }
+        // already padded to a multiple of 16 bytes by serialize_message()
+        _sock.write(serialized->data(), serialized->size());
         _sock.flush();
-        _bytes_sent += size_with_padding;
+        _bytes_sent += serialized->size();
         _last_message_sent_time = fc::time_point::now();
+        if (header.msg_type == transport_upgrade_message_type)
+          _sock.enable_aead_send(deserialize_message(serialized).as<transport_upgrade_message>().algorithm);
       } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" );
     }
 
@@ -334,6 +401,29 @@ namespace graphene { namespace net {
       return _sock.get_shared_secret();
     }
 
+    fc::variant_object message_oriented_connection_impl::get_transport_ciphers() const
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::mutable_variant_object ciphers;
+      ciphers["send"] = _sock.get_send_algorithm();
+      ciphers["receive"] = _sock.get_receive_algorithm();
+      return ciphers;
+    }
+
+    fc::variant_object message_oriented_connection_impl::get_compression_statistics() const
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::mutable_variant_object statistics;
+      statistics["compression_threshold"] = _compression_threshold;
+      statistics["messages_compressed"] = _messages_compressed;
+      statistics["bytes_saved_sending"] = _bytes_saved_sending;
+      statistics["time_spent_compressing_us"] = _time_spent_compressing.count();
+      statistics["messages_decompressed"] = _messages_decompressed;
+      statistics["bytes_saved_receiving"] = _bytes_saved_receiving;
+      statistics["time_spent_decompressing_us"] = _time_spent_decompressing.count();
+      return statistics;
+    }
+
   } // end namespace graphene::net::detail
 
 
@@ -371,6 +461,21 @@ namespace graphene { namespace net {
     my->send_message(message_to_send);
   }
 
+  void message_oriented_connection::send_serialized_message(const serialized_message_ptr& message_to_send)
+  {
+    my->send_serialized_message(message_to_send);
+  }
+
+  void message_oriented_connection::set_compression_threshold(uint32_t threshold)
+  {
+    my->set_compression_threshold(threshold);
+  }
+
+  uint32_t message_oriented_connection::get_compression_threshold() const
+  {
+    return my->get_compression_threshold();
+  }
+
   void message_oriented_connection::close_connection()
   {
     my->close_connection();
@@ -408,5 +513,14 @@ namespace graphene { namespace net {
   {
     return my->get_shared_secret();
   }
+  fc::variant_object message_oriented_connection::get_compression_statistics() const
+  {
+    return my->get_compression_statistics();
+  }
+
+  fc::variant_object message_oriented_connection::get_transport_ciphers() const
+  {
+    return my->get_transport_ciphers();
+  }
 
 } } // end namespace graphene::net
@@ -30,7 +30,9 @@
 #include <forward_list>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 #include <tuple>
+#include <random>
 #include <boost/tuple/tuple.hpp>
 #include <boost/circular_buffer.hpp>
 
@@ -78,6 +80,10 @@
 #include <graphene/net/stcp_socket.hpp>
 #include <graphene/net/config.hpp>
 #include <graphene/net/exceptions.hpp>
+#include <graphene/net/message_compression.hpp>
+#include <graphene/net/message_cache.hpp>
+#include <graphene/net/sync_headers.hpp>
+#include <graphene/net/compact_blocks.hpp>
 
 #include <graphene/chain/config.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
@@ -125,102 +131,6 @@ namespace graphene { namespace net {
   namespace detail
   {
     namespace bmi = boost::multi_index;
-    class blockchain_tied_message_cache
-    {
-    private:
-      static const uint32_t cache_duration_in_blocks = GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS;
-
-      struct message_hash_index{};
-      struct message_contents_hash_index{};
-      struct block_clock_index{};
-      struct message_info
-      {
-        message_hash_type message_hash;
-        message           message_body;
-        uint32_t          block_clock_when_received;
-
-        // for network performance stats
-        message_propagation_data propagation_data;
-        fc::uint160_t     message_contents_hash; // hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
-
-        message_info( const message_hash_type& message_hash,
-                      const message&           message_body,
-                      uint32_t                 block_clock_when_received,
-                      const message_propagation_data& propagation_data,
-                      fc::uint160_t            message_contents_hash ) :
-          message_hash( message_hash ),
-          message_body( message_body ),
-          block_clock_when_received( block_clock_when_received ),
-          propagation_data( propagation_data ),
-          message_contents_hash( message_contents_hash )
-        {}
-      };
-      typedef boost::multi_index_container
-        < message_info,
-            bmi::indexed_by< bmi::ordered_unique< bmi::tag<message_hash_index>,
-                                                  bmi::member<message_info, message_hash_type, &message_info::message_hash> >,
-                             bmi::ordered_non_unique< bmi::tag<message_contents_hash_index>,
-                                                      bmi::member<message_info, fc::uint160_t, &message_info::message_contents_hash> >,
-                             bmi::ordered_non_unique< bmi::tag<block_clock_index>,
-                                                      bmi::member<message_info, uint32_t, &message_info::block_clock_when_received> > >
-        > message_cache_container;
-
-      message_cache_container _message_cache;
-
-      uint32_t block_clock;
-
-    public:
-      blockchain_tied_message_cache() :
-        block_clock( 0 )
-      {}
-      void block_accepted();
-      void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
-                        const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
-      message get_message( const message_hash_type& hash_of_message_to_lookup );
-      message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
-      size_t size() const { return _message_cache.size(); }
-    };
-
-    void blockchain_tied_message_cache::block_accepted()
-    {
-      ++block_clock;
-      if( block_clock > cache_duration_in_blocks )
-        _message_cache.get<block_clock_index>().erase(_message_cache.get<block_clock_index>().begin(),
-                                                      _message_cache.get<block_clock_index>().lower_bound(block_clock - cache_duration_in_blocks ) );
-    }
-
-    void blockchain_tied_message_cache::cache_message( const message& message_to_cache,
-                                                     const message_hash_type& hash_of_message_to_cache,
-                                                     const message_propagation_data& propagation_data,
-                                                     const fc::uint160_t& message_content_hash )
-    {
-      _message_cache.insert( message_info(hash_of_message_to_cache,
-                                         message_to_cache,
-                                         block_clock,
-                                         propagation_data,
-                                         message_content_hash ) );
-    }
-
-    message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
-    {
-      message_cache_container::index<message_hash_index>::type::const_iterator iter =
-         _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
-      if( iter != _message_cache.get<message_hash_index>().end() )
-        return iter->message_body;
-      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
-    }
-
-    message_propagation_data blockchain_tied_message_cache::get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const
-    {
-      if( hash_of_message_contents_to_lookup != fc::uint160_t() )
-      {
-        message_cache_container::index<message_contents_hash_index>::type::const_iterator iter =
-           _message_cache.get<message_contents_hash_index>().find(hash_of_message_contents_to_lookup );
-        if( iter != _message_cache.get<message_contents_hash_index>().end() )
-          return iter->propagation_data;
-      }
-      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
-    }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -292,6 +202,7 @@ namespace graphene { namespace net { namespace detail {
                                    (handle_transaction) \
                                    (get_block_ids) \
                                    (get_item) \
+                                   (get_block_headers) \
                                    (get_chain_id) \
                                    (get_blockchain_synopsis) \
                                    (sync_status) \
@@ -390,6 +301,7 @@ namespace graphene { namespace net { namespace detail {
                                              uint32_t& remaining_item_count,
                                              uint32_t limit = 2000) override;
       message get_item( const item_id& id ) override;
+      std::vector<graphene::chain::signed_block_header> get_block_headers( const std::vector<item_hash_t>& block_ids ) override;
       chain_id_type get_chain_id() const override;
       std::vector<item_hash_t> get_blockchain_synopsis(const item_hash_t& reference_point, 
                                                        uint32_t number_of_blocks_after_reference_point) override;
@@ -452,6 +364,10 @@ namespace graphene { namespace net { namespace detail {
       active_sync_requests_map              _active_sync_requests; /// list of sync blocks we've asked for from peers but have not yet received
       std::list<graphene::net::block_message> _new_received_sync_items; /// list of sync blocks we've just received but haven't yet tried to process
       std::list<graphene::net::block_message> _received_sync_items; /// list of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
+
+      bool                                  _header_first_sync_enabled; /// only fetch sync blocks whose headers we checked, from peers able to send headers
+      sync_header_chain                     _sync_headers; /// headers of sync blocks we checked, and the checkpoints they must match
+      std::unordered_set<item_hash_t>       _active_sync_header_requests; /// sync blocks whose headers we've asked a peer for
       // @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
@@ -553,6 +469,24 @@ namespace graphene { namespace net { namespace detail {
 
       fc::future<void> _dump_node_status_task_done;
 
+      /// metrics, see network_get_metrics()
+      /// @{
+      struct message_handling_statistics
+      {
+        uint64_t         messages_handled = 0;
+        fc::microseconds total_handling_time;
+        fc::microseconds max_handling_time;
+      };
+      std::map<uint32_t, message_handling_statistics> _message_handling_statistics; /// time spent in on_message(), by message type
+      message_traffic_by_type _closed_connections_message_traffic; /// traffic of the peers we're no longer connected to
+      uint64_t _items_received; /// blocks and ordinary items peers delivered to us
+      uint64_t _duplicate_items_received; /// those of _items_received that were already in the message cache
+      uint64_t _inventory_messages_sent; /// item_ids_inventory_messages advertising new items to peers
+      uint64_t _inventory_items_advertised; /// item ids in those messages
+      uint64_t _inventory_messages_sent_at_last_second;
+      uint32_t _inventory_messages_per_second; /// inventory messages sent during the last second
+      /// @}
+
       /* We have two alternate paths through the schedule_peer_for_deletion code -- one that
        * uses a mutex to prevent one fiber from adding items to the queue while another is deleting
        * items from it, and one that doesn't.  The one that doesn't is simpler and more efficient
@@ -577,6 +511,18 @@ namespace graphene { namespace net { namespace detail {
       unsigned _maximum_number_of_blocks_to_handle_at_one_time;
       unsigned _maximum_number_of_sync_blocks_to_prefetch;
       unsigned _maximum_blocks_per_peer_during_syncing;
+      unsigned _minimum_sync_request_window;
+      unsigned _sync_window_headroom_percent;
+      unsigned _sync_request_stripe_size;
+      unsigned _sync_request_reassign_latency_multiple;
+      unsigned _sync_request_reassign_min_timeout_ms;
+      unsigned _item_request_retry_latency_multiple;
+      unsigned _item_request_retry_min_timeout_ms;
+      unsigned _compression_threshold; /// compress messages to peers supporting it from this many bytes on, 0 disables
+      bool _aead_transport_enabled; /// offer peers to switch the connection to an AEAD cipher after the hello
+      unsigned _inventory_trickle_interval_ms; /// mean delay before transaction inventory goes out to a peer, 0 sends it at once
+      unsigned _inventory_trickle_max_batch_size; /// inventory sent to a peer without waiting for the trickle delay once this many items are queued
+      std::minstd_rand _inventory_trickle_random;
 
       std::list<fc::future<void> > _handle_message_calls_in_progress;
 
@@ -589,16 +535,26 @@ namespace graphene { namespace net { namespace detail {
       void trigger_p2p_network_connect_loop();
 
       bool have_already_received_sync_item( const item_hash_t& item_hash );
+      bool needs_ids_up_to_last_checkpoint( const peer_connection* peer ) const;
+      void add_checkpoints( const std::map<uint32_t, item_hash_t>& checkpoints );
       void request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request );
       void request_sync_items_from_peer( const peer_connection_ptr& peer, const std::vector<item_hash_t>& items_to_request );
+      fc::microseconds sync_request_reassign_latency( const peer_connection* peer ) const;
+      void reassign_slow_sync_requests();
+      void update_sync_request_window( peer_connection* peer, const fc::time_point& request_time );
       void fetch_sync_items_loop();
       void trigger_fetch_sync_items_loop();
 
       bool is_item_in_any_peers_inventory(const item_id& item) const;
+      fc::microseconds estimate_item_delivery_time( const peer_connection* peer, size_t items_in_flight ) const;
+      void update_item_fetch_statistics( peer_connection* peer, const fc::time_point& request_time, size_t item_size );
+      fc::microseconds item_request_retry_latency( const peer_connection* peer ) const;
+      fc::time_point retry_slow_item_requests();
       void fetch_items_loop();
       void trigger_fetch_items_loop();
 
       void advertise_inventory_loop();
+      fc::microseconds next_inventory_trickle_delay();
       void trigger_advertise_inventory_loop();
 
       void terminate_inactive_connections_loop();
@@ -679,6 +635,23 @@ namespace graphene { namespace net { namespace detail {
       void on_get_current_connections_reply_message(peer_connection* originating_peer,
                                                     const get_current_connections_reply_message& get_current_connections_reply_message_received);
 
+      void on_compact_block_message(peer_connection* originating_peer,
+                                    const compact_block_message& compact_block_message_received);
+
+      void on_fetch_compact_block_transactions_message(peer_connection* originating_peer,
+                                                       const fetch_compact_block_transactions_message& fetch_compact_block_transactions_message_received);
+
+      void on_compact_block_transactions_message(peer_connection* originating_peer,
+                                                 const compact_block_transactions_message& compact_block_transactions_message_received);
+
+      void process_compact_block(peer_connection* originating_peer, const compact_block_reconstruction& partial_block);
+
+      void on_fetch_block_headers_message(peer_connection* originating_peer,
+                                          const fetch_block_headers_message& fetch_block_headers_message_received);
+
+      void on_block_headers_message(peer_connection* originating_peer,
+                                    const block_headers_message& block_headers_message_received);
+
       void on_connection_closed(peer_connection* originating_peer) override;
 
       void send_sync_block_to_node_delegate(const graphene::net::block_message& block_message_to_send);
@@ -737,6 +710,7 @@ namespace graphene { namespace net { namespace detail {
 
       void broadcast(const message& item_to_broadcast, const message_propagation_data& propagation_data);
       void broadcast(const message& item_to_broadcast);
+      void broadcast_transactions(const std::vector<signed_transaction>& transactions);
       void sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers);
       bool is_connected() const;
       std::vector<potential_peer_record> get_potential_peers() const;
@@ -753,9 +727,12 @@ namespace graphene { namespace net { namespace detail {
       void                       disable_peer_advertising();
       fc::variant_object         get_call_statistics() const;
       message                    get_message_for_item(const item_id& item) override;
+      serialized_message_ptr     get_serialized_message_for_item(const item_id& item) override;
 
       fc::variant_object         network_get_info() const;
       fc::variant_object         network_get_usage_stats() const;
+      fc::variant_object         network_get_metrics() const;
+      std::string                network_get_metrics_text() const;
 
       bool is_hard_fork_block(uint32_t block_number) const;
       uint32_t get_next_known_hard_fork_block_number(uint32_t block_number) const;
@@ -801,6 +778,7 @@ namespace graphene { namespace net { namespace detail {
       _is_firewalled(firewalled_state::unknown),
       _potential_peer_database_updated(false),
       _sync_items_to_fetch_updated(false),
+      _header_first_sync_enabled(true),
       _suspend_fetching_sync_blocks(false),
       _items_to_fetch_updated(false),
       _items_to_fetch_sequence_counter(0),
@@ -823,10 +801,28 @@ namespace graphene { namespace net { namespace detail {
       _average_network_write_speed_hours(72),
       _average_network_usage_second_counter(0),
       _average_network_usage_minute_counter(0),
+      _items_received(0),
+      _duplicate_items_received(0),
+      _inventory_messages_sent(0),
+      _inventory_items_advertised(0),
+      _inventory_messages_sent_at_last_second(0),
+      _inventory_messages_per_second(0),
       _node_is_shutting_down(false),
       _maximum_number_of_blocks_to_handle_at_one_time(MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME),
       _maximum_number_of_sync_blocks_to_prefetch(MAXIMUM_NUMBER_OF_BLOCKS_TO_PREFETCH),
-      _maximum_blocks_per_peer_during_syncing(GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING)
+      _maximum_blocks_per_peer_during_syncing(GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING),
+      _minimum_sync_request_window(GRAPHENE_NET_MIN_SYNC_REQUEST_WINDOW),
+      _sync_window_headroom_percent(GRAPHENE_NET_SYNC_WINDOW_HEADROOM_PERCENT),
+      _sync_request_stripe_size(GRAPHENE_NET_SYNC_REQUEST_STRIPE_SIZE),
+      _sync_request_reassign_latency_multiple(GRAPHENE_NET_SYNC_REQUEST_REASSIGN_LATENCY_MULTIPLE),
+      _sync_request_reassign_min_timeout_ms(GRAPHENE_NET_SYNC_REQUEST_REASSIGN_MIN_TIMEOUT_MS),
+      _item_request_retry_latency_multiple(GRAPHENE_NET_ITEM_REQUEST_RETRY_LATENCY_MULTIPLE),
+      _item_request_retry_min_timeout_ms(GRAPHENE_NET_ITEM_REQUEST_RETRY_MIN_TIMEOUT_MS),
+      _compression_threshold(GRAPHENE_NET_DEFAULT_COMPRESSION_THRESHOLD),
+      _aead_transport_enabled(true),
+      _inventory_trickle_interval_ms(GRAPHENE_NET_DEFAULT_INVENTORY_TRICKLE_INTERVAL_MS),
+      _inventory_trickle_max_batch_size(GRAPHENE_NET_MAX_INVENTORY_TRICKLE_BATCH_SIZE),
+      _inventory_trickle_random(std::random_device()())
     {
       _rate_limiter.set_actual_rate_time_constant(fc::seconds(2));
       fc::rand_pseudo_bytes(&_node_id.data[0], (int)_node_id.size());
@@ -1001,6 +997,21 @@ namespace graphene { namespace net { namespace detail {
                           [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _new_received_sync_items.end();                          ;
     }
 
+    // bodies below the last checkpoint wait for the headers leading to it, so with header-first
+    // sync we need the peer's list of block ids to reach it before we can fetch any of them
+    bool node_impl::needs_ids_up_to_last_checkpoint( const peer_connection* peer ) const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _header_first_sync_enabled && peer->supports_block_headers && !peer->ids_of_items_to_get.empty() &&
+             graphene::chain::block_header::num_from_id( peer->ids_of_items_to_get.back() ) < _sync_headers.last_checkpoint_block_num();
+    }
+
+    void node_impl::add_checkpoints( const std::map<uint32_t, item_hash_t>& checkpoints )
+    {
+      VERIFY_CORRECT_THREAD();
+      _sync_headers.add_checkpoints( checkpoints );
+    }
+
     void node_impl::request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request )
     {
       VERIFY_CORRECT_THREAD();
@@ -1017,6 +1028,12 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "requesting ${item_count} item(s) ${items_to_request} from peer ${endpoint}",
             ("item_count", items_to_request.size())("items_to_request", items_to_request)("endpoint", peer->get_remote_endpoint()) );
+      // the delivery rate is only measured while the peer has requests to work on
+      if (peer->sync_items_requested_from_peer.empty())
+      {
+        peer->sync_rate_period_start = fc::time_point::now();
+        peer->sync_blocks_in_rate_period = 0;
+      }
       for (const item_hash_t& item_to_request : items_to_request)
       {
         _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
@@ -1037,42 +1054,154 @@ namespace graphene { namespace net { namespace detail {
         if (!_suspend_fetching_sync_blocks)
         {
           std::map<peer_connection_ptr, std::vector<item_hash_t> > sync_item_requests_to_send;
+          std::vector<peer_connection_ptr> header_requests_to_send;
+
+          // bodies below the last checkpoint are only fetched once the headers from it lead
+          // back to our chain.  This may ask the delegate, so it is done before the section below
+          if( _header_first_sync_enabled )
+            _sync_headers.reached_last_checkpoint( _delegate->get_block_number( _delegate->get_head_block_id() ),
+                                                   [this]( const item_hash_t& block_id ) {
+                                                     return _delegate->has_item( item_id( graphene::net::block_message_type, block_id ) );
+                                                   } );
 
           {
             ASSERT_TASK_NOT_PREEMPTED();
-            std::set<item_hash_t> sync_items_to_request;
+            reassign_slow_sync_requests();
+
+            // ask each peer able to send headers for those of the next blocks it offered us
+            // that nobody has vouched for yet.  Each request covers consecutive blocks so the
+            // headers can be checked to link up.  Below the last checkpoint there is no limit
+            // on how far ahead, every header up to it is needed before the first body, and
+            // each peer gets a different range so the requests run in parallel
+            if( _header_first_sync_enabled )
+              for( const peer_connection_ptr& peer : _active_connections )
+              {
+                if( !peer->we_need_sync_items_from_peer || !peer->supports_block_headers ||
+                    !peer->sync_headers_requested_from_peer.empty() )
+                  continue;
+                const uint32_t last_checkpoint_block_num = _sync_headers.last_checkpoint_block_num();
+                peer->sync_headers_known_prefix = std::min<size_t>( peer->sync_headers_known_prefix, peer->ids_of_items_to_get.size() );
+                for( size_t i = peer->sync_headers_known_prefix;
+                     i < peer->ids_of_items_to_get.size() &&
+                     ( i < GRAPHENE_NET_SYNC_HEADERS_AHEAD ||
+                       graphene::chain::block_header::num_from_id( peer->ids_of_items_to_get[i] ) <= last_checkpoint_block_num ) &&
+                     peer->sync_headers_requested_from_peer.size() < GRAPHENE_NET_MAX_BLOCK_HEADERS_PER_REQUEST;
+                     ++i )
+                {
+                  const item_hash_t& block_id = peer->ids_of_items_to_get[i];
+                  if( _sync_headers.has_header(block_id) )
+                  {
+                    // so the next scan starts after the headers we already have
+                    if( i == peer->sync_headers_known_prefix )
+                      ++peer->sync_headers_known_prefix;
+                    else if( !peer->sync_headers_requested_from_peer.empty() )
+                      break;
+                  }
+                  else if( _active_sync_header_requests.find(block_id) == _active_sync_header_requests.end() &&
+                           !have_already_received_sync_item(block_id) )
+                  {
+                    if( peer->sync_headers_requested_from_peer.empty() )
+                    {
+                      if( i > 0 )
+                        peer->sync_headers_requested_after = peer->ids_of_items_to_get[i - 1];
+                      else if( graphene::chain::block_header::num_from_id(peer->last_block_delegate_has_seen) + 1 ==
+                               graphene::chain::block_header::num_from_id(block_id) )
+                        peer->sync_headers_requested_after = peer->last_block_delegate_has_seen;
+                      else
+                        peer->sync_headers_requested_after = item_hash_t();
+                    }
+                    peer->sync_headers_requested_from_peer.push_back(block_id);
+                  }
+                  else if( !peer->sync_headers_requested_from_peer.empty() )
+                    break;
+                }
+                if( !peer->sync_headers_requested_from_peer.empty() )
+                {
+                  _active_sync_header_requests.insert(peer->sync_headers_requested_from_peer.begin(),
+                                                      peer->sync_headers_requested_from_peer.end());
+                  peer->sync_headers_request_time = fc::time_point::now();
+                  header_requests_to_send.push_back(peer);
+                }
+              }
 
-            // for each idle peer that we're syncing with
+            // every syncing peer with room left in its request window, fastest first so the
+            // blocks we need next come from the peers most likely to deliver them soon
+            struct syncing_peer
+            {
+              peer_connection_ptr peer;
+              unsigned next_item_index;
+              unsigned requests_available;
+            };
+            std::vector<syncing_peer> syncing_peers;
             for( const peer_connection_ptr& peer : _active_connections )
             {
+              unsigned window = std::max<unsigned>(_minimum_sync_request_window,
+                                                   std::min<unsigned>(peer->sync_request_window, _maximum_blocks_per_peer_during_syncing));
               if( peer->we_need_sync_items_from_peer &&
-                  sync_item_requests_to_send.find(peer) == sync_item_requests_to_send.end() && // if we've already scheduled a request for this peer, don't consider scheduling another
-                  peer->idle() )
+                  !peer->inhibit_fetching_sync_blocks &&
+                  !peer->item_ids_requested_from_peer && // wait for the list of item ids we asked for before requesting more blocks
+                  peer->items_requested_from_peer.empty() &&
+                  peer->sync_items_requested_from_peer.size() + peer->reassigned_sync_items.size() < window ) // the blocks it was too slow with are still due
+              {
+                syncing_peer peer_to_sync_from;
+                peer_to_sync_from.peer = peer;
+                peer_to_sync_from.next_item_index = 0;
+                peer_to_sync_from.requests_available = window - peer->sync_items_requested_from_peer.size() - peer->reassigned_sync_items.size();
+                syncing_peers.push_back(peer_to_sync_from);
+              }
+            }
+            std::stable_sort(syncing_peers.begin(), syncing_peers.end(),
+                             [](const syncing_peer& a, const syncing_peer& b) { return a.peer->sync_blocks_per_second > b.peer->sync_blocks_per_second; });
+
+            // blocks requested or received but not yet pushed to the client.  Once there are enough
+            // of them, requesting more only grows the backlog, block application is the bottleneck
+            size_t sync_blocks_in_flight = _active_sync_requests.size() + _received_sync_items.size() + _new_received_sync_items.size();
+            std::set<item_hash_t> sync_items_to_request;
+
+            // hand out stripes of consecutive blocks round-robin until every window is full
+            bool stripe_assigned = true;
+            while( stripe_assigned && sync_blocks_in_flight < _maximum_number_of_sync_blocks_to_prefetch )
+            {
+              stripe_assigned = false;
+              for( syncing_peer& peer_to_sync_from : syncing_peers )
               {
-                if (!peer->inhibit_fetching_sync_blocks)
+                const peer_connection_ptr& peer = peer_to_sync_from.peer;
+                bool needs_verified_headers = _header_first_sync_enabled && peer->supports_block_headers;
+                unsigned stripe_size = std::min<unsigned>(std::max<unsigned>(_sync_request_stripe_size, 1), peer_to_sync_from.requests_available);
+                unsigned items_in_stripe = 0;
+                // loop through the items it has that we don't yet have on our blockchain
+                for( ; peer_to_sync_from.next_item_index < peer->ids_of_items_to_get.size() &&
+                       items_in_stripe < stripe_size &&
+                       sync_blocks_in_flight < _maximum_number_of_sync_blocks_to_prefetch;
+                     ++peer_to_sync_from.next_item_index )
                 {
-                  // loop through the items it has that we don't yet have on our blockchain
-                  for( unsigned i = 0; i < peer->ids_of_items_to_get.size(); ++i )
+                  item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[peer_to_sync_from.next_item_index];
+                  // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
+                  if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
+                      sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
+                      _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() && // we've requested it in a previous iteration and we're still waiting for it to arrive
+                      !peer->reassigned_sync_items.contains(item_id(graphene::net::block_message_type, item_to_potentially_request)) ) // this peer was too slow with it before
                   {
-                    item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
-                    // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
-                    if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
-                        sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
-                        _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
-                    {
-                      // then schedule a request from this peer
-                      sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
-                      sync_items_to_request.insert( item_to_potentially_request );
-                      if (sync_item_requests_to_send[peer].size() >= _maximum_blocks_per_peer_during_syncing)
-                        break;
-                    }
+                    // headers are checked in order, so none of the rest of the peer's list is yet
+                    if( needs_verified_headers && !_sync_headers.is_accepted(item_to_potentially_request) )
+                      break;
+                    // then schedule a request from this peer
+                    sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
+                    sync_items_to_request.insert( item_to_potentially_request );
+                    ++items_in_stripe;
+                    ++sync_blocks_in_flight;
                   }
                 }
+                peer_to_sync_from.requests_available -= items_in_stripe;
+                if( items_in_stripe > 0 )
+                  stripe_assigned = true;
               }
             }
           } // end non-preemptable section
 
           // make all the requests we scheduled in the loop above
+          for( const peer_connection_ptr& peer : header_requests_to_send )
+            peer->send_message(fetch_block_headers_message(peer->sync_headers_requested_from_peer));
           for( auto sync_item_request : sync_item_requests_to_send )
             request_sync_items_from_peer( sync_item_request.first, sync_item_request.second );
           sync_item_requests_to_send.clear();
@@ -1090,6 +1219,82 @@ namespace graphene { namespace net { namespace detail {
       } // while( !canceled )
     }
 
+    fc::microseconds node_impl::sync_request_reassign_latency( const peer_connection* peer ) const
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::microseconds allowed_latency = fc::milliseconds(_sync_request_reassign_min_timeout_ms);
+      if( peer->sync_min_latency != fc::microseconds::maximum() )
+        allowed_latency = std::max(allowed_latency, fc::microseconds(peer->sync_min_latency.count() * _sync_request_reassign_latency_multiple));
+      return allowed_latency;
+    }
+
+    void node_impl::reassign_slow_sync_requests()
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::time_point now = fc::time_point::now();
+      for( const peer_connection_ptr& peer : _active_connections )
+      {
+        if( peer->sync_items_requested_from_peer.empty() )
+          continue;
+
+        // only worth doing if another peer offers the block and may be asked for it.  The request
+        // to the slow peer stays tracked, its block is still accepted and it still times out
+        std::vector<item_id> reassigned_items = peer->reassigned_sync_items.hand_over_slow_requests(
+          peer->sync_items_requested_from_peer, now, sync_request_reassign_latency(peer.get()),
+          [this, &peer]( const item_id& requested_item ) {
+            for( const peer_connection_ptr& other_peer : _active_connections )
+              if( other_peer != peer && other_peer->we_need_sync_items_from_peer && !other_peer->inhibit_fetching_sync_blocks &&
+                  !other_peer->reassigned_sync_items.contains(requested_item) &&
+                  std::find(other_peer->ids_of_items_to_get.begin(), other_peer->ids_of_items_to_get.end(),
+                            requested_item.item_hash) != other_peer->ids_of_items_to_get.end() )
+                return true;
+            return false;
+          } );
+        for( const item_id& reassigned_item : reassigned_items )
+        {
+          dlog( "reassigning sync item ${item_hash} requested from slow peer ${endpoint}",
+                ("item_hash", reassigned_item.item_hash)("endpoint", peer->get_remote_endpoint()) );
+          _active_sync_requests.erase(reassigned_item.item_hash);
+        }
+        if( !reassigned_items.empty() )
+          peer->sync_request_window = std::max<uint32_t>(_minimum_sync_request_window, peer->sync_request_window / 2);
+      }
+    }
+
+    void node_impl::update_sync_request_window( peer_connection* peer, const fc::time_point& request_time )
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::time_point now = fc::time_point::now();
+      fc::microseconds latency = now - request_time;
+      if( latency < peer->sync_min_latency )
+        peer->sync_min_latency = latency;
+      else // drift up slowly so we follow a peer whose round trip got longer
+        peer->sync_min_latency += fc::microseconds((latency - peer->sync_min_latency).count() / 64);
+
+      ++peer->sync_blocks_in_rate_period;
+      fc::microseconds rate_period = now - peer->sync_rate_period_start;
+      if( rate_period < fc::seconds(1) )
+        return;
+
+      double blocks_per_second = peer->sync_blocks_in_rate_period * 1000000.0 / rate_period.count();
+      if( peer->sync_blocks_per_second == 0 )
+        peer->sync_blocks_per_second = blocks_per_second;
+      else
+        peer->sync_blocks_per_second = (3 * peer->sync_blocks_per_second + blocks_per_second) / 4;
+      peer->sync_rate_period_start = now;
+      peer->sync_blocks_in_rate_period = 0;
+
+      // keep enough requests outstanding to cover one round trip at the rate the peer delivers.
+      // the headroom lets the window grow while the peer still keeps up with it
+      double window = peer->sync_blocks_per_second * peer->sync_min_latency.count() / 1000000.0 *
+                      _sync_window_headroom_percent / 100.0;
+      window = std::min<double>(std::max<double>(std::ceil(window), _minimum_sync_request_window), _maximum_blocks_per_peer_during_syncing);
+      peer->sync_request_window = (uint32_t)window;
+      dlog( "sync request window for peer ${endpoint} is ${window} (${rate} blocks/s, ${latency} us round trip)",
+            ("endpoint", peer->get_remote_endpoint())("window", peer->sync_request_window)
+            ("rate", peer->sync_blocks_per_second)("latency", peer->sync_min_latency.count()) );
+    }
+
     void node_impl::trigger_fetch_sync_items_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -1121,28 +1326,31 @@ namespace graphene { namespace net { namespace detail {
         fc::time_point oldest_timestamp_to_fetch = fc::time_point::now() - fc::seconds(_recent_block_interval_in_seconds * GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS);
         fc::time_point next_peer_unblocked_time = fc::time_point::maximum();
 
+        // requests that took too long go back into _items_to_fetch for another peer
+        fc::time_point next_retry_time = retry_slow_item_requests();
+
         // we need to construct a list of items to request from each peer first,
         // then send the messages (in two steps, to avoid yielding while iterating)
-        // we want to evenly distribute our requests among our peers.
-        struct requested_item_count_index {};
+        // each item goes to the peer we expect to deliver it first, given how fast it
+        // has been and how many of our requests it still has to answer
         struct peer_and_items_to_fetch
         {
           peer_connection_ptr peer;
           std::vector<item_id> item_ids;
-          peer_and_items_to_fetch(const peer_connection_ptr& peer) : peer(peer) {}
-          bool operator<(const peer_and_items_to_fetch& rhs) const { return peer < rhs.peer; }
-          size_t number_of_items() const { return item_ids.size(); }
+          size_t items_in_flight;
+          fc::microseconds estimated_delivery_time; // of one more item requested now
+          peer_and_items_to_fetch(const peer_connection_ptr& peer) : peer(peer), items_in_flight(peer->items_requested_from_peer.size()) {}
         };
-        typedef boost::multi_index_container<peer_and_items_to_fetch,
-                                             boost::multi_index::indexed_by<boost::multi_index::ordered_unique<boost::multi_index::member<peer_and_items_to_fetch, peer_connection_ptr, &peer_and_items_to_fetch::peer> >,
-                                                                            boost::multi_index::ordered_non_unique<boost::multi_index::tag<requested_item_count_index>,
-                                                                                                                   boost::multi_index::const_mem_fun<peer_and_items_to_fetch, size_t, &peer_and_items_to_fetch::number_of_items> > > > fetch_messages_to_send_set;
-        fetch_messages_to_send_set items_by_peer;
+        std::vector<peer_and_items_to_fetch> items_by_peer;
 
-        // initialize the fetch_messages_to_send with an empty set of items for all idle peers
+        // peers busy with sync requests are left alone
         for (const peer_connection_ptr& peer : _active_connections)
-          if (peer->idle())
-            items_by_peer.insert(peer_and_items_to_fetch(peer));
+          if (peer->sync_items_requested_from_peer.empty() && !peer->item_ids_requested_from_peer &&
+              peer->items_requested_from_peer.size() < GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION)
+          {
+            items_by_peer.emplace_back(peer);
+            items_by_peer.back().estimated_delivery_time = estimate_item_delivery_time(peer.get(), items_by_peer.back().items_in_flight);
+          }
 
         // now loop over all items we want to fetch
         for (auto item_iter = _items_to_fetch.begin(); item_iter != _items_to_fetch.end();)
@@ -1157,33 +1365,34 @@ namespace graphene { namespace net { namespace detail {
           }
           else
           {
-            // find a peer that has it, we'll use the one who has the least requests going to it to load balance
-            bool item_fetched = false;
-            for (auto peer_iter = items_by_peer.get<requested_item_count_index>().begin(); peer_iter != items_by_peer.get<requested_item_count_index>().end(); ++peer_iter)
+            // find the peer that has it and is expected to deliver it first
+            peer_and_items_to_fetch* best_peer = nullptr;
+            for (peer_and_items_to_fetch& peer_and_items : items_by_peer)
             {
-              const peer_connection_ptr& peer = peer_iter->peer;
-              // if they have the item and we haven't already decided to ask them for too many other items
-              if (peer_iter->item_ids.size() < GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION &&
-                  peer->inventory_peer_advertised_to_us.find(item_iter->item) != peer->inventory_peer_advertised_to_us.end())
+              const peer_connection_ptr& peer = peer_and_items.peer;
+              // if they have the item, we haven't already asked them for too many other items,
+              // and they aren't the ones who were too slow with it before
+              if (peer_and_items.items_in_flight < GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION &&
+                  peer->inventory_peer_advertised_to_us.find(item_iter->item) != peer->inventory_peer_advertised_to_us.end() &&
+                  !peer->retried_items.contains(item_iter->item))
               {
                 if (item_iter->item.item_type == graphene::net::trx_message_type && peer->is_transaction_fetching_inhibited())
                   next_peer_unblocked_time = std::min(peer->transaction_fetching_inhibited_until, next_peer_unblocked_time);
-                else
-                {
-                  //dlog("requesting item ${hash} from peer ${endpoint}",
-                  //     ("hash", iter->item.item_hash)("endpoint", peer->get_remote_endpoint()));
-                  item_id item_id_to_fetch = item_iter->item;
-                  peer->items_requested_from_peer.insert(peer_connection::item_to_time_map_type::value_type(item_id_to_fetch, fc::time_point::now()));
-                  item_iter = _items_to_fetch.erase(item_iter);
-                  item_fetched = true;
-                  items_by_peer.get<requested_item_count_index>().modify(peer_iter, [&item_id_to_fetch](peer_and_items_to_fetch& peer_and_items) {
-                    peer_and_items.item_ids.push_back(item_id_to_fetch);
-                  });
-                  break;
-                }
-              }  
+                else if (!best_peer || peer_and_items.estimated_delivery_time < best_peer->estimated_delivery_time)
+                  best_peer = &peer_and_items;
+              }
             }
-            if (!item_fetched)
+            if (best_peer)
+            {
+              //dlog("requesting item ${hash} from peer ${endpoint}",
+              //     ("hash", iter->item.item_hash)("endpoint", peer->get_remote_endpoint()));
+              best_peer->peer->items_requested_from_peer.insert(peer_connection::item_to_time_map_type::value_type(item_iter->item, fc::time_point::now()));
+              best_peer->item_ids.push_back(item_iter->item);
+              ++best_peer->items_in_flight;
+              best_peer->estimated_delivery_time = estimate_item_delivery_time(best_peer->peer.get(), best_peer->items_in_flight);
+              item_iter = _items_to_fetch.erase(item_iter);
+            }
+            else
               ++item_iter;
           }
         }
@@ -1202,7 +1411,12 @@ namespace graphene { namespace net { namespace detail {
                  ("count", items_by_type.second.size())("type", (uint32_t)items_by_type.first)
                  ("endpoint", peer_and_items.peer->get_remote_endpoint())
                  ("hashes", items_by_type.second));
-            peer_and_items.peer->send_message(fetch_items_message(items_by_type.first,
+            // peers that can send compact blocks are asked for those instead, the request is still
+            // tracked as a block_message in items_requested_from_peer
+            uint32_t item_type_to_request = items_by_type.first;
+            if (item_type_to_request == graphene::net::block_message_type && peer_and_items.peer->supports_compact_blocks)
+              item_type_to_request = graphene::net::compact_block_message_type;
+            peer_and_items.peer->send_message(fetch_items_message(item_type_to_request,
                                                                   items_by_type.second));
           }
         }
@@ -1212,8 +1426,9 @@ namespace graphene { namespace net { namespace detail {
         {
           _retrigger_fetch_item_loop_promise = fc::promise<void>::ptr(new fc::promise<void>("graphene::net::retrigger_fetch_item_loop"));
           fc::microseconds time_until_retrigger = fc::microseconds::maximum();
-          if (next_peer_unblocked_time != fc::time_point::maximum())
-            time_until_retrigger = next_peer_unblocked_time - fc::time_point::now();
+          fc::time_point next_wakeup_time = std::min(next_peer_unblocked_time, next_retry_time);
+          if (next_wakeup_time != fc::time_point::maximum())
+            time_until_retrigger = next_wakeup_time - fc::time_point::now();
           try
           {
             if (time_until_retrigger > fc::microseconds(0))
@@ -1221,13 +1436,91 @@ namespace graphene { namespace net { namespace detail {
           }
           catch (const fc::timeout_exception&)
           {
-            dlog("Resuming fetch_items_loop due to timeout -- one of our peers should no longer be throttled");
+            dlog("Resuming fetch_items_loop due to timeout -- one of our peers should no longer be throttled, or a request is overdue");
           }
           _retrigger_fetch_item_loop_promise.reset();
         }
       } // while (!canceled)
     }
 
+    fc::microseconds node_impl::estimate_item_delivery_time( const peer_connection* peer, size_t items_in_flight ) const
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::microseconds round_trip_time = peer->item_round_trip_time.count() > 0 ? peer->item_round_trip_time :
+                                                                                 fc::milliseconds(GRAPHENE_NET_DEFAULT_ITEM_ROUND_TRIP_TIME_MS);
+      // the items already requested from it have to come down the connection first
+      if( peer->item_bytes_per_second > 0 )
+        return round_trip_time + fc::microseconds((int64_t)(items_in_flight * peer->item_average_size * 1000000.0 / peer->item_bytes_per_second));
+      return round_trip_time;
+    }
+
+    void node_impl::update_item_fetch_statistics( peer_connection* peer, const fc::time_point& request_time, size_t item_size )
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::time_point now = fc::time_point::now();
+      fc::microseconds round_trip_time = now - request_time;
+      if( peer->item_round_trip_time.count() == 0 )
+        peer->item_round_trip_time = round_trip_time;
+      else
+        peer->item_round_trip_time += fc::microseconds((round_trip_time - peer->item_round_trip_time).count() / 8);
+
+      // with several requests outstanding, the peer only spent the time since the previous item on this one
+      fc::microseconds delivery_time = now - std::max(request_time, peer->last_item_received_time);
+      peer->last_item_received_time = now;
+      peer->item_average_size = peer->item_average_size == 0 ? item_size : (7 * peer->item_average_size + item_size) / 8;
+      if( delivery_time.count() > 0 )
+      {
+        double bytes_per_second = item_size * 1000000.0 / delivery_time.count();
+        peer->item_bytes_per_second = peer->item_bytes_per_second == 0 ? bytes_per_second : (3 * peer->item_bytes_per_second + bytes_per_second) / 4;
+      }
+    }
+
+    fc::microseconds node_impl::item_request_retry_latency( const peer_connection* peer ) const
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::microseconds allowed_latency = fc::milliseconds(_item_request_retry_min_timeout_ms);
+      if( peer->item_round_trip_time.count() > 0 )
+        allowed_latency = std::max(allowed_latency, fc::microseconds(peer->item_round_trip_time.count() * _item_request_retry_latency_multiple));
+      return allowed_latency;
+    }
+
+    fc::time_point node_impl::retry_slow_item_requests()
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::time_point now = fc::time_point::now();
+      fc::time_point next_retry_time = fc::time_point::maximum();
+      for( const peer_connection_ptr& peer : _active_connections )
+      {
+        fc::microseconds allowed_latency = item_request_retry_latency(peer.get());
+
+        // only worth doing if someone else can take over the request.  The request to the slow
+        // peer stays tracked, its item is still accepted and it still times out
+        std::vector<item_id> retried_items = peer->retried_items.hand_over_slow_requests(
+          peer->items_requested_from_peer, now, allowed_latency,
+          [this, &peer]( const item_id& requested_item ) {
+            for( const peer_connection_ptr& other_peer : _active_connections )
+              if( other_peer != peer &&
+                  other_peer->inventory_peer_advertised_to_us.find(requested_item) != other_peer->inventory_peer_advertised_to_us.end() &&
+                  other_peer->items_requested_from_peer.find(requested_item) == other_peer->items_requested_from_peer.end() &&
+                  !other_peer->retried_items.contains(requested_item) )
+                return true;
+            return false;
+          } );
+        for( const item_id& retried_item : retried_items )
+        {
+          dlog( "retrying item ${item_hash} requested from slow peer ${endpoint} with another peer",
+                ("item_hash", retried_item.item_hash)("endpoint", peer->get_remote_endpoint()) );
+          _items_to_fetch.insert(prioritized_item_id(retried_item, _items_to_fetch_sequence_counter++));
+        }
+
+        // overdue requests nobody else can take over are left to the request timeout
+        for( const peer_connection::item_to_time_map_type::value_type& item_and_time : peer->items_requested_from_peer )
+          if( now - item_and_time.second <= allowed_latency )
+            next_retry_time = std::min(next_retry_time, item_and_time.second + allowed_latency);
+      }
+      return next_retry_time;
+    }
+
     void node_impl::trigger_fetch_items_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -1250,60 +1543,107 @@ namespace graphene { namespace net { namespace detail {
         // first, then send them all in a batch (to avoid any fiber interruption points while
         // we're computing the messages)
         std::list<std::pair<peer_connection_ptr, item_ids_inventory_message> > inventory_messages_to_send;
+        fc::time_point now = fc::time_point::now();
+        fc::time_point next_trickle_time = fc::time_point::maximum();
 
         for (const peer_connection_ptr& peer : _active_connections)
         {
           // only advertise to peers who are in sync with us
-           wdump((peer->peer_needs_sync_items_from_us));
           if( !peer->peer_needs_sync_items_from_us )
           {
             std::map<uint32_t, std::vector<item_hash_t> > items_to_advertise_by_type;
             // don't send the peer anything we've already advertised to it
             // or anything it has advertised to us
             // group the items we need to send by type, because we'll need to send one inventory message per type
-            unsigned total_items_to_send_to_this_peer = 0;
-            wdump((inventory_to_advertise));
             for (const item_id& item_to_advertise : inventory_to_advertise)
             {
-              if (peer->inventory_advertised_to_peer.find(item_to_advertise) != peer->inventory_advertised_to_peer.end() )
-                 wdump((*peer->inventory_advertised_to_peer.find(item_to_advertise)));
-              if (peer->inventory_peer_advertised_to_us.find(item_to_advertise) != peer->inventory_peer_advertised_to_us.end() )
-                 wdump((*peer->inventory_peer_advertised_to_us.find(item_to_advertise)));
-
               if (peer->inventory_advertised_to_peer.find(item_to_advertise) == peer->inventory_advertised_to_peer.end() &&
                   peer->inventory_peer_advertised_to_us.find(item_to_advertise) == peer->inventory_peer_advertised_to_us.end())
               {
-                items_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
-                peer->inventory_advertised_to_peer.insert(peer_connection::timestamped_item_id(item_to_advertise, fc::time_point::now()));
-                ++total_items_to_send_to_this_peer;
+                peer->inventory_advertised_to_peer.insert(peer_connection::timestamped_item_id(item_to_advertise, now));
                 if (item_to_advertise.item_type == trx_message_type)
                   testnetlog("advertising transaction ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
-                dlog("advertising item ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
+                // blocks are worth a message of their own, everything else waits for the next batch
+                if (item_to_advertise.item_type == block_message_type || _inventory_trickle_interval_ms == 0)
+                  items_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
+                else
+                {
+                  if (peer->inventory_to_trickle.empty())
+                    peer->next_inventory_trickle_time = now + next_inventory_trickle_delay();
+                  peer->inventory_to_trickle.push_back(item_to_advertise);
+                }
+              }
+            }
+
+            if (!peer->inventory_to_trickle.empty() &&
+                (peer->next_inventory_trickle_time <= now ||
+                 peer->inventory_to_trickle.size() >= _inventory_trickle_max_batch_size ||
+                 _inventory_trickle_interval_ms == 0))
+            {
+              size_t batch_size = std::min<size_t>(peer->inventory_to_trickle.size(), std::max(_inventory_trickle_max_batch_size, 1u));
+              for (size_t i = 0; i < batch_size; ++i)
+              {
+                const item_id& item_to_advertise = peer->inventory_to_trickle[i];
+                // the peer may have told us about it while it was waiting
+                if (peer->inventory_peer_advertised_to_us.find(item_to_advertise) == peer->inventory_peer_advertised_to_us.end())
+                  items_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
               }
+              peer->inventory_to_trickle.erase(peer->inventory_to_trickle.begin(), peer->inventory_to_trickle.begin() + batch_size);
+              if (!peer->inventory_to_trickle.empty())
+                peer->next_inventory_trickle_time = peer->inventory_to_trickle.size() >= _inventory_trickle_max_batch_size ?
+                                                    now : now + next_inventory_trickle_delay();
             }
-              dlog("advertising ${count} new item(s) of ${types} type(s) to peer ${endpoint}",
-                   ("count", total_items_to_send_to_this_peer)
+            if (!peer->inventory_to_trickle.empty())
+              next_trickle_time = std::min(next_trickle_time, peer->next_inventory_trickle_time);
+
+            if (!items_to_advertise_by_type.empty())
+              dlog("advertising new item(s) of ${types} type(s) to peer ${endpoint}, ${waiting} more waiting",
                    ("types", items_to_advertise_by_type.size())
+                   ("waiting", peer->inventory_to_trickle.size())
                    ("endpoint", peer->get_remote_endpoint()));
-            for (auto items_group : items_to_advertise_by_type)
+            for (auto& items_group : items_to_advertise_by_type)
+            {
+              _inventory_items_advertised += items_group.second.size();
               inventory_messages_to_send.push_back(std::make_pair(peer, item_ids_inventory_message(items_group.first, items_group.second)));
+            }
           }
           peer->clear_old_inventory();
         }
 
+        _inventory_messages_sent += inventory_messages_to_send.size();
         for (auto iter = inventory_messages_to_send.begin(); iter != inventory_messages_to_send.end(); ++iter)
           iter->first->send_message(iter->second);
         inventory_messages_to_send.clear();
 
-        if (_new_inventory.empty())
+        if (_new_inventory.empty() && next_trickle_time > fc::time_point::now())
         {
           _retrigger_advertise_inventory_loop_promise = fc::promise<void>::ptr(new fc::promise<void>("graphene::net::retrigger_advertise_inventory_loop"));
-          _retrigger_advertise_inventory_loop_promise->wait();
+          try
+          {
+            if (next_trickle_time == fc::time_point::maximum())
+              _retrigger_advertise_inventory_loop_promise->wait();
+            else
+              _retrigger_advertise_inventory_loop_promise->wait_until(next_trickle_time);
+          }
+          catch (const fc::timeout_exception&)
+          {
+            // time to send the inventory that has been trickling in
+          }
           _retrigger_advertise_inventory_loop_promise.reset();
         }
       } // while(!canceled)
     }
 
+    fc::microseconds node_impl::next_inventory_trickle_delay()
+    {
+      VERIFY_CORRECT_THREAD();
+      // randomized so the peers don't all get our inventory at the same moment and an observer
+      // can't tell which transactions we originated from when we advertise them
+      int64_t interval_us = _inventory_trickle_interval_ms * INT64_C(1000);
+      std::uniform_int_distribution<int64_t> delay(interval_us / 2, interval_us + interval_us / 2);
+      return fc::microseconds(delay(_inventory_trickle_random));
+    }
+
     void node_impl::trigger_advertise_inventory_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -1370,6 +1710,8 @@ namespace graphene { namespace net { namespace detail {
         // 1 second seems reasonable.  When we get closer to our eventual target of 1 second 
         // blocks, this will need to be re-evaluated (i.e., can we set the timeout to 500ms
         // and still handle normal network & processing delays without excessive disconnects)
+        // Requests for sync blocks and items get longer, a slow one is asked from another peer
+        // first by reassign_slow_sync_requests() and retry_slow_item_requests()
         fc::microseconds active_ignored_request_timeout = fc::seconds(1);
 
         fc::time_point active_disconnect_threshold = fc::time_point::now() - fc::seconds(active_disconnect_timeout);
@@ -1387,14 +1729,28 @@ namespace graphene { namespace net { namespace detail {
           else
           {
             bool disconnect_due_to_request_timeout = false;
+            // a slow sync request is handed to another peer after the reassign latency, this peer
+            // gets as long again to send the block, whether or not it was handed over
+            fc::microseconds sync_request_reassign_timeout = sync_request_reassign_latency(active_peer.get());
+            fc::time_point ignored_sync_request_threshold = fc::time_point::now() - sync_request_reassign_timeout - sync_request_reassign_timeout;
             for (const peer_connection::item_to_time_map_type::value_type& item_and_time : active_peer->sync_items_requested_from_peer)
-              if (item_and_time.second < active_ignored_request_threshold)
+              if (item_and_time.second < ignored_sync_request_threshold)
               {
                 wlog("Disconnecting peer ${peer} because they didn't respond to my request for sync item ${id}",
                       ("peer", active_peer->get_remote_endpoint())("id", item_and_time.first.item_hash));
                 disconnect_due_to_request_timeout = true;
                 break;
               }
+            if (!disconnect_due_to_request_timeout)
+            {
+              fc::optional<item_id> ignored_item = active_peer->reassigned_sync_items.find_requested_before(ignored_sync_request_threshold);
+              if (ignored_item)
+              {
+                wlog("Disconnecting peer ${peer} because they never sent sync item ${id}, which was fetched from another peer",
+                      ("peer", active_peer->get_remote_endpoint())("id", ignored_item->item_hash));
+                disconnect_due_to_request_timeout = true;
+              }
+            }
             if (!disconnect_due_to_request_timeout &&
                 active_peer->item_ids_requested_from_peer &&
                 active_peer->item_ids_requested_from_peer->get<1>() < active_ignored_request_threshold)
@@ -1404,15 +1760,37 @@ namespace graphene { namespace net { namespace detail {
                       ("synopsis", active_peer->item_ids_requested_from_peer->get<0>()));
                 disconnect_due_to_request_timeout = true;
               }
+            if (!disconnect_due_to_request_timeout &&
+                !active_peer->sync_headers_requested_from_peer.empty() &&
+                active_peer->sync_headers_request_time < active_ignored_request_threshold)
+              {
+                wlog("Disconnecting peer ${peer} because they didn't respond to my request for the headers of ${count} blocks",
+                      ("peer", active_peer->get_remote_endpoint())
+                      ("count", active_peer->sync_headers_requested_from_peer.size()));
+                disconnect_due_to_request_timeout = true;
+              }
+            // likewise a slow item request is retried with another peer after the retry latency
+            fc::microseconds item_request_retry_timeout = item_request_retry_latency(active_peer.get());
+            fc::time_point ignored_item_request_threshold = fc::time_point::now() - item_request_retry_timeout - item_request_retry_timeout;
             if (!disconnect_due_to_request_timeout)
               for (const peer_connection::item_to_time_map_type::value_type& item_and_time : active_peer->items_requested_from_peer)
-                if (item_and_time.second < active_ignored_request_threshold)
+                if (item_and_time.second < ignored_item_request_threshold)
                 {
                   wlog("Disconnecting peer ${peer} because they didn't respond to my request for item ${id}",
                         ("peer", active_peer->get_remote_endpoint())("id", item_and_time.first.item_hash));
                   disconnect_due_to_request_timeout = true;
                   break;
                 }
+            if (!disconnect_due_to_request_timeout)
+            {
+              fc::optional<item_id> ignored_item = active_peer->retried_items.find_requested_before(ignored_item_request_threshold);
+              if (ignored_item)
+              {
+                wlog("Disconnecting peer ${peer} because they never sent item ${id}, which was fetched from another peer",
+                      ("peer", active_peer->get_remote_endpoint())("id", ignored_item->item_hash));
+                disconnect_due_to_request_timeout = true;
+              }
+            }
             if (disconnect_due_to_request_timeout)
             {
               // we should probably disconnect nicely and give them a reason, but right now the logic
@@ -1574,6 +1952,9 @@ namespace graphene { namespace net { namespace detail {
       update_bandwidth_data(bytes_read_this_second, bytes_written_this_second);
       _bandwidth_monitor_last_update_time = current_time;
 
+      _inventory_messages_per_second = (uint32_t)((_inventory_messages_sent - _inventory_messages_sent_at_last_second) / seconds_since_last_update);
+      _inventory_messages_sent_at_last_second = _inventory_messages_sent;
+
       if (!_node_is_shutting_down && !_bandwidth_monitor_loop_done.canceled())
         _bandwidth_monitor_loop_done = fc::schedule( [=](){ bandwidth_monitor_loop(); },
                                                      fc::time_point::now() + fc::seconds(1),
@@ -1756,6 +2137,31 @@ namespace graphene { namespace net { namespace detail {
            ("type", graphene::net::core_message_type_enum(received_message.msg_type))("hash", message_hash)
            ("size", received_message.size)
            ("endpoint", originating_peer->get_remote_endpoint()));
+
+      if (received_message.msg_type == core_message_type_enum::block_message_type ||
+          received_message.msg_type < core_message_type_enum::core_message_type_first ||
+          received_message.msg_type > core_message_type_enum::core_message_type_last)
+      {
+        ++_items_received;
+        if (_message_cache.contains(message_hash))
+          ++_duplicate_items_received;
+      }
+
+      // handlers may yield (e.g., waiting on the delegate), so this is the latency until the
+      // message is dealt with rather than the cpu time spent on it
+      struct handling_time_recorder
+      {
+        message_handling_statistics& statistics;
+        fc::time_point start_time;
+        ~handling_time_recorder()
+        {
+          fc::microseconds handling_time = fc::time_point::now() - start_time;
+          ++statistics.messages_handled;
+          statistics.total_handling_time += handling_time;
+          statistics.max_handling_time = std::max(statistics.max_handling_time, handling_time);
+        }
+      } record_handling_time{_message_handling_statistics[received_message.msg_type], fc::time_point::now()};
+
       switch ( received_message.msg_type )
       {
       case core_message_type_enum::hello_message_type:
@@ -1812,6 +2218,21 @@ namespace graphene { namespace net { namespace detail {
       case core_message_type_enum::get_current_connections_reply_message_type:
         on_get_current_connections_reply_message(originating_peer, received_message.as<get_current_connections_reply_message>());
         break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::fetch_compact_block_transactions_message_type:
+        on_fetch_compact_block_transactions_message(originating_peer, received_message.as<fetch_compact_block_transactions_message>());
+        break;
+      case core_message_type_enum::compact_block_transactions_message_type:
+        on_compact_block_transactions_message(originating_peer, received_message.as<compact_block_transactions_message>());
+        break;
+      case core_message_type_enum::fetch_block_headers_message_type:
+        on_fetch_block_headers_message(originating_peer, received_message.as<fetch_block_headers_message>());
+        break;
+      case core_message_type_enum::block_headers_message_type:
+        on_block_headers_message(originating_peer, received_message.as<block_headers_message>());
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
@@ -1855,6 +2276,14 @@ namespace graphene { namespace net { namespace detail {
       if (!_hard_fork_block_numbers.empty())
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
+      user_data["compact_blocks"] = true;
+      user_data["block_headers"] = true;
+      // the compression algorithms we can read, the peer compresses what it sends us if it knows one
+      user_data["compression"] = std::vector<std::string>{message_compression_algorithm};
+      // the AEAD ciphers we can switch the connection to, in order of preference
+      if (_aead_transport_enabled)
+        user_data["transport"] = stcp_socket::get_supported_aead_algorithms();
+
       return user_data;
     }
     void node_impl::parse_hello_user_data_for_peer(peer_connection* originating_peer, const fc::variant_object& user_data)
@@ -1877,6 +2306,28 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->node_id = user_data["node_id"].as<node_id_t>();
       if (user_data.contains("last_known_fork_block_number"))
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>();
+      if (user_data.contains("compact_blocks"))
+        originating_peer->supports_compact_blocks = user_data["compact_blocks"].as<bool>();
+      if (user_data.contains("block_headers"))
+        originating_peer->supports_block_headers = user_data["block_headers"].as<bool>();
+      if (user_data.contains("compression"))
+      {
+        std::vector<std::string> algorithms = user_data["compression"].as<std::vector<std::string> >();
+        originating_peer->supports_compression = std::find(algorithms.begin(), algorithms.end(),
+                                                           message_compression_algorithm) != algorithms.end();
+        if (originating_peer->supports_compression)
+          originating_peer->set_compression_threshold(_compression_threshold);
+      }
+      if (_aead_transport_enabled && user_data.contains("transport"))
+      {
+        std::vector<std::string> algorithms = user_data["transport"].as<std::vector<std::string> >();
+        for (const std::string& algorithm : stcp_socket::get_supported_aead_algorithms())
+          if (std::find(algorithms.begin(), algorithms.end(), algorithm) != algorithms.end())
+          {
+            originating_peer->aead_transport_algorithm = algorithm;
+            break;
+          }
+      }
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -2072,6 +2523,9 @@ namespace graphene { namespace net { namespace detail {
             originating_peer->send_message(message(connection_accepted_message()));
             dlog("Received a hello_message from peer ${peer}, sending reply to accept connection",
                  ("peer", originating_peer->get_remote_endpoint()));
+            // the peer does the same for the other direction when it accepts our hello
+            if (!originating_peer->aead_transport_algorithm.empty())
+              originating_peer->send_message(message(transport_upgrade_message(originating_peer->aead_transport_algorithm)));
           }
         }
       }
@@ -2477,6 +2931,19 @@ namespace graphene { namespace net { namespace detail {
             }
           }
 
+          for (const item_hash_t& block_id : blockchain_item_ids_inventory_message_received.item_hashes_available)
+            if (_sync_headers.contradicts_checkpoint(block_id))
+            {
+              wlog("Peer ${peer_endpoint} offered us block ${block_id}, which doesn't match our checkpoints",
+                   ("peer_endpoint", originating_peer->get_remote_endpoint())("block_id", block_id));
+              fc::exception error_for_peer(FC_LOG_MESSAGE(error, "You offered me block ${block_id}, which doesn't match my checkpoints",
+                                                          ("block_id", block_id)));
+              disconnect_from_peer(originating_peer,
+                                   "You offered me a block which doesn't match my checkpoints",
+                                   true, error_for_peer);
+              return;
+            }
+
           const std::vector<item_hash_t>& synopsis_sent_in_request = originating_peer->item_ids_requested_from_peer->get<0>();
           const item_hash_t& first_item_hash = blockchain_item_ids_inventory_message_received.item_hashes_available.front();
 
@@ -2543,7 +3010,13 @@ namespace graphene { namespace net { namespace detail {
           uint32_t new_number_of_unfetched_items = calculate_unsynced_block_count_from_all_peers();
           _total_number_of_unfetched_items = new_number_of_unfetched_items;
           if( new_number_of_unfetched_items == 0 )
+          {
             _delegate->sync_status( blockchain_item_ids_inventory_message_received.item_type, 0 );
+            // left over from forks we didn't follow
+            _sync_headers.clear();
+            for (const peer_connection_ptr& peer : _active_connections)
+              peer->sync_headers_known_prefix = 0;
+          }
 
           return;
         }
@@ -2631,6 +3104,8 @@ namespace graphene { namespace net { namespace detail {
           assert(item_hashes_received.front() != originating_peer->ids_of_items_to_get.back());
 
         // append the remaining items to the peer's list
+        originating_peer->sync_headers_known_prefix = std::min<size_t>(originating_peer->sync_headers_known_prefix,
+                                                                        originating_peer->ids_of_items_to_get.size());
         boost::push_back(originating_peer->ids_of_items_to_get, item_hashes_received);
 
         originating_peer->number_of_unfetched_item_ids = blockchain_item_ids_inventory_message_received.total_remaining_item_count;
@@ -2665,7 +3140,8 @@ namespace graphene { namespace net { namespace detail {
         if (blockchain_item_ids_inventory_message_received.total_remaining_item_count != 0)
         {
           // the peer hasn't sent us all the items it knows about.
-          if (originating_peer->ids_of_items_to_get.size() > GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH)
+          if (originating_peer->ids_of_items_to_get.size() > GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH &&
+              !needs_ids_up_to_last_checkpoint(originating_peer))
           {
             // we have a good number of item ids from this peer, start fetching blocks from it;
             // we'll switch back later to finish the job.
@@ -2676,6 +3152,9 @@ namespace graphene { namespace net { namespace detail {
             // keep fetching the peer's list of sync items until we get enough to switch into block-
             // fetchimg mode
             fetch_next_batch_of_item_ids_from_peer(originating_peer);
+            // meanwhile, check the headers of the ids we already have
+            if (needs_ids_up_to_last_checkpoint(originating_peer))
+              trigger_fetch_sync_items_loop();
           }
         }
         else
@@ -2719,6 +3198,17 @@ namespace graphene { namespace net { namespace detail {
       return item_not_available_message(item);
     }
 
+    serialized_message_ptr node_impl::get_serialized_message_for_item(const item_id& item)
+    {
+      try
+      {
+        return _message_cache.get_serialized_message(item.item_hash);
+      }
+      catch (fc::key_not_found_exception&)
+      {}
+      return serialize_message(get_message_for_item(item));
+    }
+
     void node_impl::on_fetch_items_message(peer_connection* originating_peer, const fetch_items_message& fetch_items_message_received)
     {
       VERIFY_CORRECT_THREAD();
@@ -2727,20 +3217,63 @@ namespace graphene { namespace net { namespace detail {
            ("type", fetch_items_message_received.item_type)
            ("endpoint", originating_peer->get_remote_endpoint()));
 
-      fc::optional<message> last_block_message_sent;
+      if (fetch_items_message_received.item_type == compact_block_message_type)
+      {
+        for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
+        {
+          item_id block_item(block_message_type, item_hash);
+          fc::optional<graphene::net::block_message> block;
+          try
+          {
+            message requested_message = get_message_for_item(block_item);
+            if (requested_message.msg_type == block_message_type)
+              block = requested_message.as<graphene::net::block_message>();
+          }
+          catch (const fc::exception&)
+          {
+          }
+          if (!block)
+          {
+            dlog("received compact block request from peer ${endpoint} but we don't have it",
+                 ("endpoint", originating_peer->get_remote_endpoint()));
+            originating_peer->send_message(item_not_available_message(block_item));
+            continue;
+          }
+          originating_peer->last_block_delegate_has_seen = block->block_id;
+          originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block->block_id);
+          originating_peer->send_message(compact_block_message(block->block, item_hash));
+          originating_peer->compact_blocks_sent.push_back(block->block_id);
+          if (originating_peer->compact_blocks_sent.size() > GRAPHENE_NET_MAX_COMPACT_BLOCKS_AWAITING_TRANSACTIONS)
+            originating_peer->compact_blocks_sent.pop_front();
+        }
+        return;
+      }
+
+      fc::optional<block_id_type> last_block_sent;
 
-      std::list<message> reply_messages;
+      // cached items are sent from the buffer serialized when they were cached, the delegate's
+      // blocks are looked up again by block id when they reach the front of the send queue
+      struct reply_message
+      {
+        serialized_message_ptr  cached_message;
+        fc::optional<message>   message_to_send;
+        fc::optional<item_id>   item_to_send;
+      };
+      std::list<reply_message> reply_messages;
       for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
       {
         try
         {
-          message requested_message = _message_cache.get_message(item_hash);
+          fc::uint160_t message_contents_hash;
+          reply_message reply;
+          reply.cached_message = _message_cache.get_serialized_message(item_hash, &message_contents_hash,
+                                                                       originating_peer->get_compression_threshold());
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
-               ("id", requested_message.id()));
-          reply_messages.push_back(requested_message);
+               ("id", item_hash));
+          reply_messages.push_back(reply);
           if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
+            last_block_sent = message_contents_hash;
           continue;
         }
         catch (fc::key_not_found_exception&)
@@ -2756,36 +3289,189 @@ namespace graphene { namespace net { namespace detail {
                ("id", requested_message.id())
                ("size", requested_message.size)
                ("endpoint", originating_peer->get_remote_endpoint()));
-          reply_messages.push_back(requested_message);
-          if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
+          reply_message reply;
+          if (requested_message.msg_type == block_message_type)
+          {
+            last_block_sent = requested_message.as<graphene::net::block_message>().block_id;
+            reply.item_to_send = item_id(block_message_type, *last_block_sent);
+          }
+          else
+            reply.message_to_send = requested_message;
+          reply_messages.push_back(reply);
           continue;
         }
         catch (fc::key_not_found_exception&)
         {
-          reply_messages.push_back(item_not_available_message(item_to_fetch));
+          reply_message reply;
+          reply.message_to_send = message(item_not_available_message(item_to_fetch));
+          reply_messages.push_back(reply);
           dlog("received item request from peer ${endpoint} but we don't have it",
                ("endpoint", originating_peer->get_remote_endpoint()));
         }
       }
 
       // if we sent them a block, update our record of the last block they've seen accordingly
-      if (last_block_message_sent)
+      if (last_block_sent)
       {
-        graphene::net::block_message block = last_block_message_sent->as<graphene::net::block_message>();
-        originating_peer->last_block_delegate_has_seen = block.block_id;
-        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
+        originating_peer->last_block_delegate_has_seen = *last_block_sent;
+        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(*last_block_sent);
       }
 
-      for (const message& reply : reply_messages)
+      for (const reply_message& reply : reply_messages)
       {
-        if (reply.msg_type == block_message_type)
-          originating_peer->send_item(item_id(block_message_type, reply.as<graphene::net::block_message>().block_id));
+        if (reply.cached_message)
+          originating_peer->send_serialized_message(reply.cached_message);
+        else if (reply.item_to_send)
+          originating_peer->send_item(*reply.item_to_send);
         else
-          originating_peer->send_message(reply);
+          originating_peer->send_message(*reply.message_to_send);
       }
     }
 
+    void node_impl::on_compact_block_message(peer_connection* originating_peer,
+                                             const compact_block_message& compact_block_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      item_id requested_item(block_message_type, compact_block_message_received.item_hash);
+      if (originating_peer->items_requested_from_peer.find(requested_item) == originating_peer->items_requested_from_peer.end() &&
+          originating_peer->retried_items.remove(requested_item))
+      {
+        dlog("dropping late compact block ${block_id} from peer ${endpoint}, another peer was asked for it",
+             ("block_id", compact_block_message_received.block_id)("endpoint", originating_peer->get_remote_endpoint()));
+        return;
+      }
+      if (originating_peer->items_requested_from_peer.find(requested_item) == originating_peer->items_requested_from_peer.end())
+      {
+        wlog("received a compact block ${block_id} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", compact_block_message_received.block_id));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a compact block that I didn't ask for, block_id: ${block_id}",
+                                                    ("block_id", compact_block_message_received.block_id)));
+        disconnect_from_peer(originating_peer, "You sent me a compact block that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      compact_block_reconstruction partial_block(compact_block_message_received,
+                                                 [this](uint64_t short_id) { return _message_cache.find_transaction(short_id); });
+      if (partial_block.missing_indexes().empty())
+      {
+        process_compact_block(originating_peer, partial_block);
+        return;
+      }
+
+      dlog("compact block ${block_id} from peer ${endpoint} is missing ${missing} of ${count} transactions, requesting them",
+           ("block_id", compact_block_message_received.block_id)
+           ("endpoint", originating_peer->get_remote_endpoint())
+           ("missing", partial_block.missing_indexes().size())
+           ("count", compact_block_message_received.transactions.size()));
+      fetch_compact_block_transactions_message request(compact_block_message_received.block_id, partial_block.missing_indexes());
+      originating_peer->partial_compact_blocks[compact_block_message_received.block_id] = std::move(partial_block);
+      originating_peer->send_message(request);
+    }
+
+    void node_impl::on_fetch_compact_block_transactions_message(peer_connection* originating_peer,
+                                                                const fetch_compact_block_transactions_message& fetch_compact_block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      const block_id_type& block_id = fetch_compact_block_transactions_message_received.block_id;
+      compact_block_transactions_message reply;
+      reply.block_id = block_id;
+
+      // only the transactions of a compact block we sent are handed out, once, the full block is
+      // the way to get the others
+      auto sent_iter = std::find(originating_peer->compact_blocks_sent.begin(), originating_peer->compact_blocks_sent.end(), block_id);
+      if (sent_iter == originating_peer->compact_blocks_sent.end())
+      {
+        dlog("peer ${endpoint} asked for the transactions of compact block ${block_id}, which we didn't send it or already completed",
+             ("endpoint", originating_peer->get_remote_endpoint())("block_id", block_id));
+        originating_peer->send_message(reply);
+        return;
+      }
+      originating_peer->compact_blocks_sent.erase(sent_iter);
+
+      fc::optional<graphene::net::block_message> block;
+      try
+      {
+        // the delegate looks blocks up by block id
+        message block_message_to_read = _delegate->get_item(item_id(block_message_type, block_id));
+        block = block_message_to_read.as<graphene::net::block_message>();
+      }
+      catch (const fc::exception& e)
+      {
+        dlog("unable to supply compact block transactions to peer ${endpoint}: ${e}",
+             ("endpoint", originating_peer->get_remote_endpoint())("e", e));
+        originating_peer->send_message(reply);
+        return;
+      }
+
+      try
+      {
+        reply = answer_compact_block_transactions_request(block->block, fetch_compact_block_transactions_message_received, MAX_MESSAGE_SIZE);
+      }
+      catch (const fc::exception& e)
+      {
+        wlog("peer ${endpoint} sent an invalid request for the transactions of compact block ${block_id}, disconnecting from peer: ${e}",
+             ("endpoint", originating_peer->get_remote_endpoint())("block_id", block_id)("e", e));
+        disconnect_from_peer(originating_peer, "You sent me an invalid request for the transactions of a compact block", true, e);
+        return;
+      }
+      if (reply.transactions.empty() && !fetch_compact_block_transactions_message_received.indexes.empty())
+        dlog("the transactions of compact block ${block_id} requested by peer ${endpoint} don't fit in a message",
+             ("block_id", block_id)("endpoint", originating_peer->get_remote_endpoint()));
+      originating_peer->send_message(reply);
+    }
+
+    void node_impl::on_compact_block_transactions_message(peer_connection* originating_peer,
+                                                          const compact_block_transactions_message& compact_block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      auto partial_iter = originating_peer->partial_compact_blocks.find(compact_block_transactions_message_received.block_id);
+      if (partial_iter == originating_peer->partial_compact_blocks.end())
+      {
+        dlog("received transactions for compact block ${block_id} we aren't waiting for, ignoring them",
+             ("block_id", compact_block_transactions_message_received.block_id));
+        return;
+      }
+      compact_block_reconstruction partial_block = std::move(partial_iter->second);
+      originating_peer->partial_compact_blocks.erase(partial_iter);
+
+      try
+      {
+        partial_block.add_missing_transactions(compact_block_transactions_message_received);
+      }
+      catch (const fc::exception& e)
+      {
+        wlog("peer ${endpoint} didn't send the missing transactions of compact block ${block_id}, fetching the full block: ${e}",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", partial_block.compact_block().block_id)("e", e));
+        originating_peer->send_message(fetch_items_message(block_message_type,
+                                                           std::vector<item_hash_t>{partial_block.compact_block().item_hash}));
+        return;
+      }
+      process_compact_block(originating_peer, partial_block);
+    }
+
+    void node_impl::process_compact_block(peer_connection* originating_peer, const compact_block_reconstruction& partial_block)
+    {
+      VERIFY_CORRECT_THREAD();
+      const compact_block_message& compact_block = partial_block.compact_block();
+      fc::optional<message> block_message_to_process;
+      try
+      {
+        block_message_to_process = partial_block.rebuild();
+      }
+      catch (const fc::exception& e)
+      {
+        wlog("unable to rebuild compact block ${block_id} from peer ${endpoint}, fetching the full block: ${e}",
+             ("block_id", compact_block.block_id)
+             ("endpoint", originating_peer->get_remote_endpoint())("e", e));
+        originating_peer->send_message(fetch_items_message(block_message_type,
+                                                           std::vector<item_hash_t>{compact_block.item_hash}));
+        return;
+      }
+      process_block_message(originating_peer, *block_message_to_process, compact_block.item_hash);
+    }
+
     void node_impl::on_item_not_available_message( peer_connection* originating_peer, const item_not_available_message& item_not_available_message_received )
     {
       VERIFY_CORRECT_THREAD();
@@ -2803,9 +3489,11 @@ namespace graphene { namespace net { namespace detail {
       }
 
       auto sync_item_iter = originating_peer->sync_items_requested_from_peer.find(requested_item);
-      if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end())
+      if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end() ||
+          originating_peer->reassigned_sync_items.remove(requested_item))
       {
-        originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
+        if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end())
+          originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
 
         if (originating_peer->peer_needs_sync_items_from_us)
           originating_peer->inhibit_fetching_sync_blocks = true;
@@ -2818,6 +3506,7 @@ namespace graphene { namespace net { namespace detail {
         return;
       }
 
+      originating_peer->retried_items.remove(requested_item);
       dlog("Peer doesn't have an item we're looking for, which is fine because we weren't looking for it");
     }
 
@@ -2889,6 +3578,74 @@ namespace graphene { namespace net { namespace detail {
 
     }
 
+    void node_impl::on_fetch_block_headers_message(peer_connection* originating_peer,
+                                                   const fetch_block_headers_message& fetch_block_headers_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (fetch_block_headers_message_received.block_ids.size() > GRAPHENE_NET_MAX_BLOCK_HEADERS_PER_REQUEST)
+      {
+        wlog("Peer ${endpoint} requested ${count} block headers at once",
+             ("endpoint", originating_peer->get_remote_endpoint())("count", fetch_block_headers_message_received.block_ids.size()));
+        fc::exception error_for_peer(FC_LOG_MESSAGE(error, "You requested ${count} block headers, the limit is ${limit}",
+                                                    ("count", fetch_block_headers_message_received.block_ids.size())
+                                                    ("limit", GRAPHENE_NET_MAX_BLOCK_HEADERS_PER_REQUEST)));
+        disconnect_from_peer(originating_peer, "You requested too many block headers", true, error_for_peer);
+        return;
+      }
+
+      block_headers_message reply;
+      try
+      {
+        reply.headers = _delegate->get_block_headers(fetch_block_headers_message_received.block_ids);
+      }
+      catch (const fc::canceled_exception&)
+      {
+        throw;
+      }
+      catch (const fc::exception& e)
+      {
+        dlog("unable to supply block headers to peer ${endpoint}: ${e}",
+             ("endpoint", originating_peer->get_remote_endpoint())("e", e));
+      }
+      originating_peer->send_message(reply);
+    }
+
+    void node_impl::on_block_headers_message(peer_connection* originating_peer,
+                                             const block_headers_message& block_headers_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      std::vector<item_hash_t> headers_requested;
+      headers_requested.swap(originating_peer->sync_headers_requested_from_peer);
+      for (const item_hash_t& block_id : headers_requested)
+        _active_sync_header_requests.erase(block_id);
+      trigger_fetch_sync_items_loop();
+      if (headers_requested.empty())
+      {
+        wlog("received block headers from peer ${endpoint}, but I didn't ask for any!",
+             ("endpoint", originating_peer->get_remote_endpoint()));
+        return;
+      }
+
+      const std::vector<graphene::chain::signed_block_header>& headers = block_headers_message_received.headers;
+      try
+      {
+        _sync_headers.accept_headers(headers_requested, originating_peer->sync_headers_requested_after, headers);
+      }
+      catch (const fc::exception& e)
+      {
+        wlog("Invalid block headers from peer ${endpoint}: ${error}",
+             ("endpoint", originating_peer->get_remote_endpoint())("error", e.to_string()));
+        disconnect_from_peer(originating_peer, "You sent me invalid block headers", true, e);
+        return;
+      }
+      dlog("sync: verified ${count} block headers from peer ${endpoint}",
+           ("count", headers.size())("endpoint", originating_peer->get_remote_endpoint()));
+
+      // the peer no longer has the rest of the blocks it offered, it must have switched forks
+      if (headers.size() < headers_requested.size() && !originating_peer->item_ids_requested_from_peer)
+        fetch_next_batch_of_item_ids_from_peer(originating_peer);
+    }
+
     void node_impl::on_closing_connection_message( peer_connection* originating_peer, const closing_connection_message& closing_connection_message_received )
     {
       VERIFY_CORRECT_THREAD();
@@ -2939,6 +3696,9 @@ namespace graphene { namespace net { namespace detail {
         }
       }
 
+      for (const auto& traffic_for_type : originating_peer->message_traffic)
+        _closed_connections_message_traffic[traffic_for_type.first].merge(traffic_for_type.second);
+
       _closing_connections.erase(originating_peer_ptr);
       _handshaking_connections.erase(originating_peer_ptr);
       _terminating_connections.erase(originating_peer_ptr);
@@ -2994,6 +3754,13 @@ namespace graphene { namespace net { namespace detail {
           _active_sync_requests.erase(sync_item_and_time.first.item_hash);
         trigger_fetch_sync_items_loop();
       }
+      if (!originating_peer->sync_headers_requested_from_peer.empty())
+      {
+        for (const item_hash_t& block_id : originating_peer->sync_headers_requested_from_peer)
+          _active_sync_header_requests.erase(block_id);
+        originating_peer->sync_headers_requested_from_peer.clear();
+        trigger_fetch_sync_items_loop();
+      }
 
       if (!originating_peer->items_requested_from_peer.empty())
       {
@@ -3245,6 +4012,8 @@ namespace graphene { namespace net { namespace detail {
             {
               potential_first_block = true;
               peer->ids_of_items_to_get.pop_front();
+              if (peer->sync_headers_known_prefix > 0)
+                --peer->sync_headers_known_prefix;
               peer->ids_of_items_being_processed.insert(received_block_iter->block_id);
             }
           }
@@ -3252,6 +4021,7 @@ namespace graphene { namespace net { namespace detail {
           // if it is, process it, remove it from all sync peers lists
           if (potential_first_block)
           {
+            _sync_headers.forget(received_block_iter->block_id);
             // we can get into an interesting situation near the end of synchronization.  We can be in
             // sync with one peer who is sending us the last block on the chain via a regular inventory
             // message, while at the same time still be synchronizing with a peer who is sending us the
@@ -3307,6 +4077,20 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "received a sync block from peer ${endpoint}", ("endpoint", originating_peer->get_remote_endpoint() ) );
 
+      // the chain skips most checks on blocks up to its last checkpoint.  Make sure the header
+      // is the one pinned by the checkpoint, the chain still checks the transactions match it
+      const graphene::chain::signed_block& block = block_message_to_process.block;
+      if( block.block_num() <= _sync_headers.last_checkpoint_block_num() &&
+          block.id() != block_message_to_process.block_id )
+      {
+        wlog( "sync block ${id} from peer ${endpoint} doesn't match its header",
+              ("id", block_message_to_process.block_id)("endpoint", originating_peer->get_remote_endpoint() ) );
+        fc::exception error_for_peer( FC_LOG_MESSAGE( error, "You sent me block ${id} with a header not matching its id",
+                                                      ("id", block_message_to_process.block_id) ) );
+        disconnect_from_peer( originating_peer, "You sent me a block which doesn't match its header", true, error_for_peer );
+        return;
+      }
+
       // add it to the front of _received_sync_items, then process _received_sync_items to try to
       // pass as many messages as possible to the client.
       _new_received_sync_items.push_front( block_message_to_process );
@@ -3471,10 +4255,17 @@ namespace graphene { namespace net { namespace detail {
       auto item_iter = originating_peer->items_requested_from_peer.find(item_id(graphene::net::block_message_type, message_hash));
       if (item_iter != originating_peer->items_requested_from_peer.end())
       {
+        update_item_fetch_statistics(originating_peer, item_iter->second, message_to_process.size);
         originating_peer->items_requested_from_peer.erase(item_iter);
         process_block_during_normal_operation(originating_peer, block_message_to_process, message_hash);
-        if (originating_peer->idle())
-          trigger_fetch_items_loop();
+        trigger_fetch_items_loop(); // room for another request to this peer
+        return;
+      }
+      else if (originating_peer->retried_items.remove(item_id(graphene::net::block_message_type, message_hash)))
+      {
+        // we gave up waiting for it and asked another peer, but it's still good if that peer hasn't
+        // delivered yet.  process_block_during_normal_operation() ignores blocks we already accepted
+        process_block_during_normal_operation(originating_peer, block_message_to_process, message_hash);
         return;
       }
       else
@@ -3484,6 +4275,7 @@ namespace graphene { namespace net { namespace detail {
                                                                                             block_message_to_process.block_id));
         if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end())
         {
+          update_sync_request_window(originating_peer, sync_item_iter->second);
           originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
           _active_sync_requests.erase(block_message_to_process.block_id);
           process_block_during_sync(originating_peer, block_message_to_process, message_hash);
@@ -3497,6 +4289,23 @@ namespace graphene { namespace net { namespace detail {
             else
               trigger_fetch_sync_items_loop();
           }
+          else
+            trigger_fetch_sync_items_loop(); // keep the request window full
+          return;
+        }
+
+        // a sync block we gave up waiting for and asked another peer for.  Use it unless the
+        // other request is still outstanding or the block already arrived some other way
+        if (originating_peer->reassigned_sync_items.remove(item_id(graphene::net::block_message_type, block_message_to_process.block_id)))
+        {
+          if (_active_sync_requests.find(block_message_to_process.block_id) == _active_sync_requests.end() &&
+              !have_already_received_sync_item(block_message_to_process.block_id) &&
+              !_delegate->has_item(item_id(graphene::net::block_message_type, block_message_to_process.block_id)))
+            process_block_during_sync(originating_peer, block_message_to_process, message_hash);
+          else
+            dlog("dropping late sync block ${block_id} from peer ${endpoint}",
+                 ("block_id", block_message_to_process.block_id)("endpoint", originating_peer->get_remote_endpoint()));
+          trigger_fetch_sync_items_loop();
           return;
         }
       }
@@ -3786,6 +4595,13 @@ namespace graphene { namespace net { namespace detail {
 
       // only process it if we asked for it
       auto iter = originating_peer->items_requested_from_peer.find( item_id(message_to_process.msg_type, message_hash) );
+      if( iter == originating_peer->items_requested_from_peer.end() &&
+          originating_peer->retried_items.remove( item_id(message_to_process.msg_type, message_hash) ) )
+      {
+        // we gave up waiting for it and asked another peer
+        dlog( "dropping late item ${hash} from peer ${endpoint}", ("hash", message_hash)("endpoint", originating_peer->get_remote_endpoint() ) );
+        return;
+      }
       if( iter == originating_peer->items_requested_from_peer.end() )
       {
         wlog( "received a message I didn't ask for from peer ${endpoint}, disconnecting from peer",
@@ -3797,9 +4613,9 @@ namespace graphene { namespace net { namespace detail {
       }
       else
       {
+        update_item_fetch_statistics( originating_peer, iter->second, message_to_process.size );
         originating_peer->items_requested_from_peer.erase( iter );
-        if (originating_peer->idle())
-          trigger_fetch_items_loop();
+        trigger_fetch_items_loop(); // room for another request to this peer
 
         // Next: have the delegate process the message
         fc::time_point message_validated_time;
@@ -3837,6 +4653,7 @@ namespace graphene { namespace net { namespace detail {
     {
       VERIFY_CORRECT_THREAD();
       peer->ids_of_items_to_get.clear();
+      peer->sync_headers_known_prefix = 0;
       peer->number_of_unfetched_item_ids = 0;
       peer->we_need_sync_items_from_peer = true;
       peer->last_block_delegate_has_seen = item_hash_t();
@@ -4680,7 +5497,7 @@ namespace graphene { namespace net { namespace detail {
       ilog( "node._new_received_sync_items size: ${size}", ("size", _new_received_sync_items.size() ) );
       ilog( "node._items_to_fetch size: ${size}", ("size", _items_to_fetch.size() ) );
       ilog( "node._new_inventory size: ${size}", ("size", _new_inventory.size() ) );
-      ilog( "node._message_cache size: ${size}", ("size", _message_cache.size() ) );
+      ilog( "node._message_cache: ${statistics}", ("statistics", _message_cache.get_statistics() ) );
       for( const peer_connection_ptr& peer : _active_connections )
       {
         ilog( "  peer ${endpoint}", ("endpoint", peer->get_remote_endpoint() ) );
@@ -4839,6 +5656,14 @@ namespace graphene { namespace net { namespace detail {
         peer_details["current_head_block"] = peer->last_block_delegate_has_seen;
         peer_details["current_head_block_number"] = _delegate->get_block_number(peer->last_block_delegate_has_seen);
         peer_details["current_head_block_time"] = peer->last_block_time_delegate_has_seen;
+        peer_details["sync_request_window"] = peer->sync_request_window;
+        peer_details["sync_blocks_per_second"] = peer->sync_blocks_per_second;
+        peer_details["item_round_trip_time_us"] = peer->item_round_trip_time.count();
+        peer_details["item_bytes_per_second"] = peer->item_bytes_per_second;
+        peer_details["items_in_flight"] = (uint32_t)peer->items_requested_from_peer.size();
+        peer_details["send_bytes_per_second"] = peer->send_bytes_per_second;
+        peer_details["compression"] = peer->get_compression_statistics();
+        peer_details["transport"] = peer->get_transport_ciphers();
 
         this_peer_status.info = peer_details;
         statuses.push_back(this_peer_status);
@@ -4884,6 +5709,23 @@ namespace graphene { namespace net { namespace detail {
       broadcast( item_to_broadcast, propagation_data );
     }
 
+    void node_impl::broadcast_transactions( const std::vector<signed_transaction>& transactions )
+    {
+      VERIFY_CORRECT_THREAD();
+      // cache all transactions first and wake the advertise loop once, so the whole batch
+      // goes out to each peer in a single item_ids_inventory_message
+      message_propagation_data propagation_data{fc::time_point::now(), fc::time_point::now(), _node_id};
+      for( const signed_transaction& trx : transactions )
+      {
+        message item_to_broadcast = trx_message( trx );
+        message_hash_type hash_of_item_to_broadcast = item_to_broadcast.id();
+        _message_cache.cache_message( item_to_broadcast, hash_of_item_to_broadcast, propagation_data, trx.id() );
+        _new_inventory.insert( item_id(item_to_broadcast.msg_type, hash_of_item_to_broadcast ) );
+      }
+      dlog( "broadcasting batch of ${n} transactions", ("n", transactions.size()) );
+      trigger_advertise_inventory_loop();
+    }
+
     void node_impl::sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers)
     {
       VERIFY_CORRECT_THREAD();
@@ -4924,6 +5766,40 @@ namespace graphene { namespace net { namespace detail {
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>();
       if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>();
+      if (params.contains("minimum_sync_request_window"))
+        _minimum_sync_request_window = params["minimum_sync_request_window"].as<uint32_t>();
+      if (params.contains("sync_window_headroom_percent"))
+        _sync_window_headroom_percent = params["sync_window_headroom_percent"].as<uint32_t>();
+      if (params.contains("sync_request_stripe_size"))
+        _sync_request_stripe_size = params["sync_request_stripe_size"].as<uint32_t>();
+      if (params.contains("sync_request_reassign_latency_multiple"))
+        _sync_request_reassign_latency_multiple = params["sync_request_reassign_latency_multiple"].as<uint32_t>();
+      if (params.contains("sync_request_reassign_min_timeout_ms"))
+        _sync_request_reassign_min_timeout_ms = params["sync_request_reassign_min_timeout_ms"].as<uint32_t>();
+      if (params.contains("item_request_retry_latency_multiple"))
+        _item_request_retry_latency_multiple = params["item_request_retry_latency_multiple"].as<uint32_t>();
+      if (params.contains("item_request_retry_min_timeout_ms"))
+        _item_request_retry_min_timeout_ms = params["item_request_retry_min_timeout_ms"].as<uint32_t>();
+      if (params.contains("compression_threshold"))
+      {
+        _compression_threshold = params["compression_threshold"].as<uint32_t>();
+        for (const peer_connection_ptr& peer : _active_connections)
+          if (peer->supports_compression)
+            peer->set_compression_threshold(_compression_threshold);
+      }
+      if (params.contains("aead_transport"))
+        _aead_transport_enabled = params["aead_transport"].as<bool>();
+      if (params.contains("header_first_sync"))
+      {
+        _header_first_sync_enabled = params["header_first_sync"].as<bool>();
+        trigger_fetch_sync_items_loop();
+      }
+      if (params.contains("inventory_trickle_interval_ms"))
+        _inventory_trickle_interval_ms = params["inventory_trickle_interval_ms"].as<uint32_t>();
+      if (params.contains("inventory_trickle_max_batch_size"))
+        _inventory_trickle_max_batch_size = params["inventory_trickle_max_batch_size"].as<uint32_t>();
+      if (params.contains("message_cache_max_size_in_bytes"))
+        _message_cache.set_max_size_in_bytes(params["message_cache_max_size_in_bytes"].as<uint64_t>());
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -4943,6 +5819,19 @@ namespace graphene { namespace net { namespace detail {
       result["maximum_number_of_blocks_to_handle_at_one_time"] = _maximum_number_of_blocks_to_handle_at_one_time;
       result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
       result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+      result["minimum_sync_request_window"] = _minimum_sync_request_window;
+      result["sync_window_headroom_percent"] = _sync_window_headroom_percent;
+      result["sync_request_stripe_size"] = _sync_request_stripe_size;
+      result["sync_request_reassign_latency_multiple"] = _sync_request_reassign_latency_multiple;
+      result["sync_request_reassign_min_timeout_ms"] = _sync_request_reassign_min_timeout_ms;
+      result["item_request_retry_latency_multiple"] = _item_request_retry_latency_multiple;
+      result["item_request_retry_min_timeout_ms"] = _item_request_retry_min_timeout_ms;
+      result["compression_threshold"] = _compression_threshold;
+      result["aead_transport"] = _aead_transport_enabled;
+      result["header_first_sync"] = _header_first_sync_enabled;
+      result["inventory_trickle_interval_ms"] = _inventory_trickle_interval_ms;
+      result["inventory_trickle_max_batch_size"] = _inventory_trickle_max_batch_size;
+      result["message_cache_max_size_in_bytes"] = (uint64_t)_message_cache.get_max_size_in_bytes();
       return result;
     }
 
@@ -5011,6 +5900,7 @@ namespace graphene { namespace net { namespace detail {
       info["node_public_key"] = _node_public_key;
       info["node_id"] = _node_id;
       info["firewalled"] = _is_firewalled;
+      info["message_cache"] = _message_cache.get_statistics();
       return info;
     }
     fc::variant_object node_impl::network_get_usage_stats() const
@@ -5044,6 +5934,152 @@ namespace graphene { namespace net { namespace detail {
       return result;
     }
 
+    static std::string message_type_name(uint32_t message_type)
+    {
+      return fc::variant(core_message_type_enum(message_type)).as_string();
+    }
+
+    static fc::variant_object message_traffic_to_variant(const message_traffic_by_type& traffic)
+    {
+      fc::mutable_variant_object result;
+      for (const auto& traffic_for_type : traffic)
+      {
+        fc::mutable_variant_object counters;
+        counters["messages_received"] = traffic_for_type.second.messages_received;
+        counters["bytes_received"] = traffic_for_type.second.bytes_received;
+        counters["messages_sent"] = traffic_for_type.second.messages_sent;
+        counters["bytes_sent"] = traffic_for_type.second.bytes_sent;
+        result[message_type_name(traffic_for_type.first)] = counters;
+      }
+      return result;
+    }
+
+    fc::variant_object node_impl::network_get_metrics() const
+    {
+      VERIFY_CORRECT_THREAD();
+      message_traffic_by_type total_traffic = _closed_connections_message_traffic;
+      size_t total_queued_messages_size = 0;
+      size_t sync_items_to_get = 0;
+      std::vector<fc::variant> peers;
+
+      std::vector<peer_connection_ptr> all_connections;
+      all_connections.insert(all_connections.end(), _handshaking_connections.begin(), _handshaking_connections.end());
+      all_connections.insert(all_connections.end(), _active_connections.begin(), _active_connections.end());
+      all_connections.insert(all_connections.end(), _closing_connections.begin(), _closing_connections.end());
+      all_connections.insert(all_connections.end(), _terminating_connections.begin(), _terminating_connections.end());
+      for (const peer_connection_ptr& peer : all_connections)
+      {
+        for (const auto& traffic_for_type : peer->message_traffic)
+          total_traffic[traffic_for_type.first].merge(traffic_for_type.second);
+        total_queued_messages_size += peer->get_total_queued_messages_size();
+        if (_active_connections.find(peer) == _active_connections.end())
+          continue;
+        sync_items_to_get += peer->ids_of_items_to_get.size();
+
+        fc::mutable_variant_object peer_metrics;
+        fc::optional<fc::ip::endpoint> endpoint = peer->get_remote_endpoint();
+        peer_metrics["endpoint"] = endpoint ? std::string(*endpoint) : std::string();
+        peer_metrics["node_id"] = peer->node_id;
+        peer_metrics["bytes_received"] = peer->get_total_bytes_received();
+        peer_metrics["bytes_sent"] = peer->get_total_bytes_sent();
+        peer_metrics["queued_messages"] = peer->get_number_of_queued_messages();
+        peer_metrics["queued_messages_size"] = peer->get_total_queued_messages_size();
+        peer_metrics["round_trip_delay_us"] = peer->round_trip_delay.count();
+        peer_metrics["item_round_trip_time_us"] = peer->item_round_trip_time.count();
+        peer_metrics["item_bytes_per_second"] = peer->item_bytes_per_second;
+        peer_metrics["send_bytes_per_second"] = peer->send_bytes_per_second;
+        peer_metrics["items_in_flight"] = peer->items_requested_from_peer.size();
+        peer_metrics["sync_items_in_flight"] = peer->sync_items_requested_from_peer.size();
+        peer_metrics["sync_items_to_get"] = peer->ids_of_items_to_get.size();
+        peer_metrics["messages"] = message_traffic_to_variant(peer->message_traffic);
+        peers.emplace_back(peer_metrics);
+      }
+
+      fc::mutable_variant_object handling;
+      for (const auto& statistics_for_type : _message_handling_statistics)
+      {
+        fc::mutable_variant_object statistics;
+        statistics["messages_handled"] = statistics_for_type.second.messages_handled;
+        statistics["total_handling_time_us"] = statistics_for_type.second.total_handling_time.count();
+        statistics["max_handling_time_us"] = statistics_for_type.second.max_handling_time.count();
+        handling[message_type_name(statistics_for_type.first)] = statistics;
+      }
+
+      fc::mutable_variant_object sync;
+      sync["items_to_get"] = sync_items_to_get;
+      sync["unfetched_items"] = _total_number_of_unfetched_items;
+      sync["requests_in_flight"] = _active_sync_requests.size();
+      sync["new_received_items"] = _new_received_sync_items.size();
+      sync["received_items"] = _received_sync_items.size();
+      sync["verified_headers"] = _sync_headers.size();
+      sync["header_requests_in_flight"] = _active_sync_header_requests.size();
+
+      fc::mutable_variant_object metrics;
+      metrics["connections"] = _active_connections.size();
+      metrics["queued_messages_size"] = total_queued_messages_size;
+      metrics["items_to_fetch"] = _items_to_fetch.size();
+      metrics["items_received"] = _items_received;
+      metrics["duplicate_items_received"] = _duplicate_items_received;
+      metrics["inventory_messages_sent"] = _inventory_messages_sent;
+      metrics["inventory_items_advertised"] = _inventory_items_advertised;
+      metrics["inventory_messages_per_second"] = _inventory_messages_per_second;
+      metrics["sync"] = sync;
+      metrics["messages"] = message_traffic_to_variant(total_traffic);
+      metrics["message_handling"] = handling;
+      metrics["message_cache"] = _message_cache.get_statistics();
+      metrics["delegate_calls"] = get_call_statistics();
+      metrics["peers"] = peers;
+      return metrics;
+    }
+
+    std::string node_impl::network_get_metrics_text() const
+    {
+      VERIFY_CORRECT_THREAD();
+      // Prometheus text exposition format, one sample per line.  Per-message-type and
+      // per-peer counters become labels; the peer labels only cover current connections
+      fc::variant_object metrics = network_get_metrics();
+      std::ostringstream text;
+      auto sample = [&text](const std::string& name, const std::string& labels, const fc::variant& value) {
+        text << "graphene_p2p_" << name;
+        if (!labels.empty())
+          text << "{" << labels << "}";
+        text << " " << value.as_string() << "\n";
+      };
+      auto label = [](const std::string& name, const std::string& value) {
+        return name + "=\"" + value + "\"";
+      };
+
+      for (const char* name : {"connections", "queued_messages_size", "items_to_fetch", "items_received", "duplicate_items_received",
+                               "inventory_messages_sent", "inventory_items_advertised", "inventory_messages_per_second"})
+        sample(name, std::string(), metrics[name]);
+      for (const auto& entry : metrics["sync"].get_object())
+        sample("sync_" + entry.key(), std::string(), entry.value());
+      for (const auto& entry : metrics["message_cache"].get_object())
+        sample("message_cache_" + entry.key(), std::string(), entry.value());
+      for (const auto& type : metrics["messages"].get_object())
+        for (const auto& counter : type.value().get_object())
+          sample(counter.key(), label("type", type.key()), counter.value());
+      for (const auto& type : metrics["message_handling"].get_object())
+        for (const auto& counter : type.value().get_object())
+          sample(counter.key(), label("type", type.key()), counter.value());
+      for (const auto& method : metrics["delegate_calls"].get_object())
+        if (method.value().is_object())
+          for (const auto& statistic : method.value().get_object())
+            sample("delegate_call_" + statistic.key(), label("method", method.key()), statistic.value());
+      for (const fc::variant& peer : metrics["peers"].get_array())
+      {
+        const fc::variant_object& peer_metrics = peer.get_object();
+        std::string peer_label = label("peer", peer_metrics["endpoint"].as_string());
+        for (const auto& entry : peer_metrics)
+          if (entry.value().is_numeric())
+            sample("peer_" + entry.key(), peer_label, entry.value());
+        for (const auto& type : peer_metrics["messages"].get_object())
+          for (const auto& counter : type.value().get_object())
+            sample("peer_" + counter.key(), peer_label + "," + label("type", type.key()), counter.value());
+      }
+      return text.str();
+    }
+
     bool node_impl::is_hard_fork_block(uint32_t block_number) const
     {
       return std::binary_search(_hard_fork_block_numbers.begin(), _hard_fork_block_numbers.end(), block_number);
@@ -5147,11 +6183,21 @@ namespace graphene { namespace net { namespace detail {
     INVOKE_IN_IMPL(broadcast, msg);
   }
 
+  void node::broadcast_transactions( const std::vector<signed_transaction>& transactions )
+  {
+    INVOKE_IN_IMPL(broadcast_transactions, transactions);
+  }
+
   void node::sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers)
   {
     INVOKE_IN_IMPL(sync_from, current_head_block, hard_fork_block_numbers);
   }
 
+  void node::add_checkpoints(const std::map<uint32_t, item_hash_t>& checkpoints)
+  {
+    INVOKE_IN_IMPL(add_checkpoints, checkpoints);
+  }
+
   bool node::is_connected() const
   {
     INVOKE_IN_IMPL(is_connected);
@@ -5223,6 +6269,16 @@ namespace graphene { namespace net { namespace detail {
     INVOKE_IN_IMPL(network_get_usage_stats);
   }
 
+  fc::variant_object node::network_get_metrics() const
+  {
+    INVOKE_IN_IMPL(network_get_metrics);
+  }
+
+  std::string node::network_get_metrics_text() const
+  {
+    INVOKE_IN_IMPL(network_get_metrics_text);
+  }
+
   void node::close()
   {
     INVOKE_IN_IMPL(close);
@@ -5280,6 +6336,12 @@ namespace graphene { namespace net { namespace detail {
     }
   }
 
+  void simulated_network::broadcast_transactions( const std::vector<signed_transaction>& transactions )
+  {
+    for( const signed_transaction& trx : transactions )
+      broadcast( trx_message( trx ) );
+  }
+
   void simulated_network::add_node_delegate( node_delegate* node_delegate_to_add )
   {
     network_nodes.push_back(new node_info(node_delegate_to_add));
@@ -5417,6 +6479,11 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(get_item, id);
     }
 
+    std::vector<graphene::chain::signed_block_header> statistics_gathering_node_delegate_wrapper::get_block_headers( const std::vector<item_hash_t>& block_ids )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(get_block_headers, block_ids);
+    }
+
     chain_id_type statistics_gathering_node_delegate_wrapper::get_chain_id() const
     {
       INVOKE_AND_COLLECT_STATISTICS(get_chain_id);
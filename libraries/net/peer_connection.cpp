@@ -24,6 +24,7 @@
 #include <graphene/net/peer_connection.hpp>
 #include <graphene/net/exceptions.hpp>
 #include <graphene/net/config.hpp>
+#include <graphene/net/message_compression.hpp>
 #include <graphene/chain/config.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
@@ -64,11 +65,32 @@ namespace graphene { namespace net
       return node->get_message_for_item(item_to_send);
     }
 
+    serialized_message_ptr peer_connection::virtual_queued_message::get_serialized_message(peer_connection_delegate* node)
+    {
+      return node->get_serialized_message_for_item(item_to_send);
+    }
+
     size_t peer_connection::virtual_queued_message::get_size_in_queue()
     {
       return sizeof(item_id);
     }
 
+    message peer_connection::shared_queued_message::get_message(peer_connection_delegate*)
+    {
+      return deserialize_message(message_to_send);
+    }
+
+    serialized_message_ptr peer_connection::shared_queued_message::get_serialized_message(peer_connection_delegate*)
+    {
+      return message_to_send;
+    }
+
+    size_t peer_connection::shared_queued_message::get_size_in_queue()
+    {
+      // the buffer may be shared with other peers, but this queue keeps it alive until it is sent
+      return message_to_send->size();
+    }
+
     peer_connection::peer_connection(peer_connection_delegate* delegate) :
       _node(delegate),
       _message_connection(this),
@@ -84,6 +106,17 @@ namespace graphene { namespace net
       peer_needs_sync_items_from_us(true),
       we_need_sync_items_from_peer(true),
       inhibit_fetching_sync_blocks(false),
+      sync_request_window(GRAPHENE_NET_MIN_SYNC_REQUEST_WINDOW),
+      sync_min_latency(fc::microseconds::maximum()),
+      sync_blocks_per_second(0),
+      sync_blocks_in_rate_period(0),
+      sync_headers_known_prefix(0),
+      item_bytes_per_second(0),
+      item_average_size(0),
+      send_bytes_per_second(0),
+      supports_compact_blocks(false),
+      supports_compression(false),
+      supports_block_headers(false),
       transaction_fetching_inhibited_until(fc::time_point::min()),
       last_known_fork_block_number(0),
       firewall_check_state(nullptr)
@@ -265,6 +298,9 @@ namespace graphene { namespace net
     void peer_connection::on_message( message_oriented_connection* originating_connection, const message& received_message )
     {
       VERIFY_CORRECT_THREAD();
+      message_traffic_counters& counters = message_traffic[received_message.msg_type];
+      ++counters.messages_received;
+      counters.bytes_received += sizeof(message_header) + received_message.size;
       _node->on_message( this, received_message );
     }
 
@@ -288,13 +324,13 @@ namespace graphene { namespace net
       while (!_queued_messages.empty())
       {
         _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        serialized_message_ptr message_to_send = _queued_messages.front()->get_serialized_message(_node);
         try
         {
           //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
           //     "to send message of type ${type} for peer ${endpoint}",
           //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-          _message_connection.send_message(message_to_send);
+          _message_connection.send_serialized_message(message_to_send);
           //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
           //     ("endpoint", get_remote_endpoint()));
         }
@@ -325,6 +361,7 @@ namespace graphene { namespace net
           elog("message_oriented_exception::send_message() threw an unhandled exception");
         }
         _queued_messages.front()->transmission_finish_time = fc::time_point::now();
+        update_transmission_statistics(*_queued_messages.front(), message_to_send);
         _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
         _queued_messages.pop();
       }
@@ -381,6 +418,13 @@ namespace graphene { namespace net
       send_queueable_message(std::move(message_to_enqueue));
     }
 
+    void peer_connection::send_serialized_message(const serialized_message_ptr& message_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
+      std::unique_ptr<queued_message> message_to_enqueue(new shared_queued_message(message_to_send));
+      send_queueable_message(std::move(message_to_enqueue));
+    }
+
     void peer_connection::close_connection()
     {
       VERIFY_CORRECT_THREAD();
@@ -438,6 +482,38 @@ namespace graphene { namespace net
       _remote_endpoint = new_remote_endpoint;
     }
 
+    void peer_connection::update_transmission_statistics(const queued_message& sent_message, const serialized_message_ptr& message_sent)
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::microseconds transmission_time = sent_message.transmission_finish_time - sent_message.transmission_start_time;
+      if (message_sent->size() >= GRAPHENE_NET_MIN_MESSAGE_SIZE_FOR_SEND_RATE && transmission_time.count() > 0)
+      {
+        double bytes_per_second = message_sent->size() * 1000000.0 / transmission_time.count();
+        send_bytes_per_second = send_bytes_per_second == 0 ? bytes_per_second : (3 * send_bytes_per_second + bytes_per_second) / 4;
+      }
+
+      // replies served compressed from the message cache are counted as the message they carry
+      const message_header& header = *reinterpret_cast<const message_header*>(message_sent->data());
+      const uint32_t msg_type = header.msg_type & ~compressed_message_flag;
+      message_traffic_counters& counters = message_traffic[msg_type];
+      ++counters.messages_sent;
+      counters.bytes_sent += sizeof(message_header) + uncompressed_body_size(message_sent);
+
+      // the round trip of an item request starts when the request is actually on the wire,
+      // not when it was queued behind whatever else we were sending this peer
+      if (header.msg_type == fetch_items_message_type)
+      {
+        fetch_items_message fetch_request = deserialize_message(message_sent).as<fetch_items_message>();
+        uint32_t item_type = fetch_request.item_type == compact_block_message_type ? (uint32_t)block_message_type : fetch_request.item_type;
+        for (const item_hash_t& item_hash : fetch_request.items_to_fetch)
+        {
+          auto request_iter = items_requested_from_peer.find(item_id(item_type, item_hash));
+          if (request_iter != items_requested_from_peer.end())
+            request_iter->second = sent_message.transmission_finish_time;
+        }
+      }
+    }
+
     bool peer_connection::busy()
     {
       VERIFY_CORRECT_THREAD();
@@ -462,6 +538,30 @@ namespace graphene { namespace net
       return _message_connection.get_shared_secret();
     }
 
+    void peer_connection::set_compression_threshold(uint32_t threshold)
+    {
+      VERIFY_CORRECT_THREAD();
+      _message_connection.set_compression_threshold(threshold);
+    }
+
+    uint32_t peer_connection::get_compression_threshold() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _message_connection.get_compression_threshold();
+    }
+
+    fc::variant_object peer_connection::get_compression_statistics() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _message_connection.get_compression_statistics();
+    }
+
+    fc::variant_object peer_connection::get_transport_ciphers() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _message_connection.get_transport_ciphers();
+    }
+
     void peer_connection::clear_old_inventory()
     {
       VERIFY_CORRECT_THREAD();
@@ -478,6 +578,11 @@ namespace graphene { namespace net
       begin_iter = inventory_peer_advertised_to_us.get<timestamp_index>().begin();
       unsigned number_of_elements_peer_advertised_to_discard = std::distance(begin_iter, oldest_inventory_to_keep_iter);
       inventory_peer_advertised_to_us.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
+
+      // a retried request is forgotten along with the inventory it was for, in case the peer never answers
+      retried_items.remove_if([this](const item_id& item) {
+        return inventory_peer_advertised_to_us.find(item) == inventory_peer_advertised_to_us.end();
+      });
       dlog("Expiring old inventory for peer ${peer}: removing ${to_peer} items advertised to peer (${remain_to_peer} left), and ${to_us} advertised to us (${remain_to_us} left)",
            ("peer", get_remote_endpoint())
            ("to_peer", number_of_elements_advertised_to_peer_to_discard)("remain_to_peer", inventory_advertised_to_peer.size())
@@ -0,0 +1,42 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#include <graphene/net/slow_requests.hpp>
+
+namespace graphene { namespace net {
+
+  std::vector<item_id> handed_over_requests::hand_over_slow_requests( item_to_time_map_type& requests, const fc::time_point& now,
+                                                                      const fc::microseconds& allowed_latency,
+                                                                      const std::function<bool( const item_id& )>& can_take_over )
+  {
+    std::vector<item_id> handed_over;
+    for( auto request_iter = requests.begin(); request_iter != requests.end(); )
+    {
+      if( now - request_iter->second > allowed_latency && can_take_over( request_iter->first ) )
+      {
+        handed_over.push_back( request_iter->first );
+        _requests.insert( *request_iter );
+        request_iter = requests.erase( request_iter );
+      }
+      else
+        ++request_iter;
+    }
+    return handed_over;
+  }
+
+  void handed_over_requests::remove_if( const std::function<bool( const item_id& )>& expired )
+  {
+    for( auto request_iter = _requests.begin(); request_iter != _requests.end(); )
+      if( expired( request_iter->first ) )
+        request_iter = _requests.erase( request_iter );
+      else
+        ++request_iter;
+  }
+
+  fc::optional<item_id> handed_over_requests::find_requested_before( const fc::time_point& threshold ) const
+  {
+    for( const auto& item_and_time : _requests )
+      if( item_and_time.second < threshold )
+        return item_and_time.first;
+    return fc::optional<item_id>();
+  }
+
+} } // graphene::net
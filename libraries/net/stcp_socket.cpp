@@ -33,13 +33,19 @@
 #include <fc/exception/exception.hpp>
 
 #include <graphene/net/stcp_socket.hpp>
+#include <graphene/net/aead_channel.hpp>
+#include <graphene/net/config.hpp>
 
 namespace graphene { namespace net {
 
 stcp_socket::stcp_socket()
 //:_buf_len(0)
+   : _aead_read_buffer_size(0),
+     _aead_plaintext_offset(0),
+     _aead_plaintext_size(0),
+     _aead_write_buffer_size(0)
 #ifndef NDEBUG
-   : _read_buffer_in_use(false),
+     ,_read_buffer_in_use(false),
      _write_buffer_in_use(false)
 #endif
 {
@@ -59,6 +65,8 @@ void stcp_socket::do_key_exchange()
   _sock.read( serialized_key_buffer, sizeof(fc::ecc::public_key_data) );
   fc::ecc::public_key_data rpub;
   memcpy((char*)&rpub, serialized_key_buffer.get(), sizeof(fc::ecc::public_key_data));
+  _local_public_key = s;
+  _remote_public_key = rpub;
 
   _shared_secret = _priv_key.get_shared_secret( rpub );
 //    ilog("shared secret ${s}", ("s", shared_secret) );
@@ -87,6 +95,8 @@ void stcp_socket::bind( const fc::ip::endpoint& local_endpoint )
  */
 size_t stcp_socket::readsome( char* buffer, size_t len )
 { try {
+    if( _recv_aead )
+      return aead_readsome( buffer, len );
     assert( len > 0 && (len % 16) == 0 );
 
 #ifndef NDEBUG
@@ -128,6 +138,8 @@ bool stcp_socket::eof()const
 
 size_t stcp_socket::writesome( const char* buffer, size_t len )
 { try {
+    if( _send_aead )
+      return aead_writesome( buffer, len );
     assert( len > 0 && (len % 16) == 0 );
 
 #ifndef NDEBUG
@@ -163,6 +175,76 @@ size_t stcp_socket::writesome( const std::shared_ptr<const char>& buf, size_t le
   return writesome(buf.get() + offset, len);
 }
 
+size_t stcp_socket::aead_readsome( char* buffer, size_t len )
+{
+  if( _aead_plaintext_offset == _aead_plaintext_size )
+  {
+    // read the next record: its length, then the ciphertext and tag
+    if( !_aead_read_buffer )
+    {
+      _aead_read_buffer_size = GRAPHENE_NET_AEAD_MAX_RECORD_SIZE + detail::aead_channel::tag_size;
+      _aead_read_buffer.reset(new char[_aead_read_buffer_size], [](char* p){ delete[] p; });
+      _aead_plaintext.reset(new char[GRAPHENE_NET_AEAD_MAX_RECORD_SIZE], [](char* p){ delete[] p; });
+    }
+    _sock.read( _aead_read_buffer, detail::aead_channel::record_header_size, 0 );
+    uint32_t record_size = detail::aead_channel::record_size( _aead_read_buffer.get() );
+    _sock.read( _aead_read_buffer, record_size + detail::aead_channel::tag_size, 0 );
+    _recv_aead->open( record_size, _aead_read_buffer.get(), _aead_plaintext.get() );
+    _aead_plaintext_offset = 0;
+    _aead_plaintext_size = record_size;
+  }
+  size_t bytes_to_copy = std::min( len, _aead_plaintext_size - _aead_plaintext_offset );
+  memcpy( buffer, _aead_plaintext.get() + _aead_plaintext_offset, bytes_to_copy );
+  _aead_plaintext_offset += bytes_to_copy;
+  return bytes_to_copy;
+}
+
+size_t stcp_socket::aead_writesome( const char* buffer, size_t len )
+{
+  len = std::min<size_t>( len, GRAPHENE_NET_AEAD_MAX_RECORD_SIZE );
+  size_t record_size = detail::aead_channel::record_header_size + len + detail::aead_channel::tag_size;
+  if( record_size > _aead_write_buffer_size )
+  {
+    _aead_write_buffer_size = detail::aead_channel::record_header_size + GRAPHENE_NET_AEAD_MAX_RECORD_SIZE + detail::aead_channel::tag_size;
+    _aead_write_buffer.reset(new char[_aead_write_buffer_size], [](char* p){ delete[] p; });
+  }
+  // header, ciphertext and tag go out in a single write
+  _send_aead->seal( buffer, (uint32_t)len, _aead_write_buffer.get() );
+  _sock.write( _aead_write_buffer, record_size );
+  return len;
+}
+
+std::vector<std::string> stcp_socket::get_supported_aead_algorithms()
+{
+  std::vector<std::string> algorithms;
+  for( const char* algorithm : { "aes-256-gcm", "chacha20-poly1305" } )
+    if( detail::aead_channel::is_supported( algorithm ) )
+      algorithms.push_back( algorithm );
+  return algorithms;
+}
+
+void stcp_socket::enable_aead_send( const std::string& algorithm )
+{
+  _send_aead.reset( new detail::aead_channel( algorithm, detail::derive_aead_key( _shared_secret, _local_public_key, algorithm ), true ) );
+}
+
+void stcp_socket::enable_aead_receive( const std::string& algorithm )
+{
+  // the aes stream is block aligned and we never read past the message that told us to switch,
+  // so nothing read from the socket is left to decode with it
+  _recv_aead.reset( new detail::aead_channel( algorithm, detail::derive_aead_key( _shared_secret, _remote_public_key, algorithm ), false ) );
+}
+
+std::string stcp_socket::get_send_algorithm() const
+{
+  return _send_aead ? _send_aead->algorithm : std::string( "aes-256-cbc-stream" );
+}
+
+std::string stcp_socket::get_receive_algorithm() const
+{
+  return _recv_aead ? _recv_aead->algorithm : std::string( "aes-256-cbc-stream" );
+}
+
 void stcp_socket::flush()
 {
   _sock.flush();
@@ -0,0 +1,113 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#include <graphene/net/sync_headers.hpp>
+
+#include <fc/exception/exception.hpp>
+
+namespace graphene { namespace net {
+
+  using graphene::chain::block_header;
+
+  void sync_header_chain::add_checkpoints( const std::map<uint32_t, item_hash_t>& checkpoints )
+  {
+    for( const auto& checkpoint : checkpoints )
+      if( checkpoint.second != item_hash_t() )
+        _checkpoints[checkpoint.first] = checkpoint.second;
+    // the walk starts over from the new last checkpoint
+    _walk_position.reset();
+    _last_checkpoint_reached = false;
+  }
+
+  bool sync_header_chain::contradicts_checkpoint( const item_hash_t& block_id ) const
+  {
+    auto checkpoint_iter = _checkpoints.find( block_header::num_from_id( block_id ) );
+    return checkpoint_iter != _checkpoints.end() && checkpoint_iter->second != block_id;
+  }
+
+  uint32_t sync_header_chain::last_checkpoint_block_num() const
+  {
+    return _checkpoints.empty() ? 0 : _checkpoints.rbegin()->first;
+  }
+
+  size_t sync_header_chain::accept_headers( const std::vector<item_hash_t>& requested, const item_hash_t& previous,
+                                            const std::vector<graphene::chain::signed_block_header>& headers )
+  {
+    FC_ASSERT( headers.size() <= requested.size(), "You sent me ${count} block headers, I asked for ${requested}",
+               ("count", headers.size())("requested", requested.size()) );
+    item_hash_t previous_block_id = previous;
+    for( size_t i = 0; i < headers.size(); ++i )
+    {
+      item_hash_t block_id = headers[i].id();
+      FC_ASSERT( block_id == requested[i], "You sent me header ${header} when I asked for the one of block ${block_id}",
+                 ("header", block_id)("block_id", requested[i]) );
+      FC_ASSERT( previous_block_id == item_hash_t() || headers[i].previous == previous_block_id,
+                 "The header of block ${block_id} you sent me doesn't link to block ${previous}",
+                 ("block_id", block_id)("previous", previous_block_id) );
+      FC_ASSERT( !contradicts_checkpoint( block_id ), "You offered me block ${block_id}, which doesn't match my checkpoints",
+                 ("block_id", block_id) );
+      previous_block_id = block_id;
+    }
+
+    for( const graphene::chain::signed_block_header& header : headers )
+    {
+      item_hash_t block_id = header.id();
+      if( _pinned.find( block_id ) == _pinned.end() )
+        _headers[block_id] = header.previous;
+    }
+    return headers.size();
+  }
+
+  bool sync_header_chain::has_header( const item_hash_t& block_id ) const
+  {
+    return _headers.find( block_id ) != _headers.end() || _pinned.find( block_id ) != _pinned.end();
+  }
+
+  bool sync_header_chain::is_accepted( const item_hash_t& block_id ) const
+  {
+    if( block_header::num_from_id( block_id ) <= last_checkpoint_block_num() )
+      return _last_checkpoint_reached && _pinned.find( block_id ) != _pinned.end();
+    return has_header( block_id );
+  }
+
+  bool sync_header_chain::reached_last_checkpoint( uint32_t head_block_num, const std::function<bool( const item_hash_t& )>& have_block )
+  {
+    if( _last_checkpoint_reached )
+      return true;
+    if( _checkpoints.empty() )
+      return _last_checkpoint_reached = true;
+
+    item_hash_t block_id = _walk_position ? *_walk_position : _checkpoints.rbegin()->second;
+    for( ;; )
+    {
+      uint32_t block_num = block_header::num_from_id( block_id );
+      if( block_num == 0 || ( block_num <= head_block_num && have_block( block_id ) ) )
+      {
+        _walk_position.reset();
+        return _last_checkpoint_reached = true;
+      }
+      auto header_iter = _headers.find( block_id );
+      if( header_iter == _headers.end() )
+      {
+        _walk_position = block_id;
+        return false;
+      }
+      _pinned.insert( block_id );
+      block_id = header_iter->second;
+      _headers.erase( header_iter );
+    }
+  }
+
+  void sync_header_chain::forget( const item_hash_t& block_id )
+  {
+    _headers.erase( block_id );
+    _pinned.erase( block_id );
+  }
+
+  void sync_header_chain::clear()
+  {
+    _headers.clear();
+    _pinned.clear();
+    _walk_position.reset();
+    _last_checkpoint_reached = false;
+  }
+
+} } // graphene::net
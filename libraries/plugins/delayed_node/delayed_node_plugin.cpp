@@ -33,6 +33,8 @@
 #include <fc/api.hpp>
 #include <fc/smart_ref_impl.hpp>
 
+#include <deque>
+
 
 namespace graphene { namespace delayed_node {
 namespace bpo = boost::program_options;
@@ -46,7 +48,13 @@ struct delayed_node_plugin_impl {
    boost::signals2::scoped_connection client_connection_closed;
    graphene::chain::block_id_type last_received_remote_head;
    graphene::chain::block_id_type last_processed_remote_head;
+   /// number of blocks requested with a single get_blocks call
+   uint32_t blocks_per_request = 50;
+   /// number of get_blocks calls kept outstanding ahead of the block being applied
+   uint32_t requests_in_flight = 4;
 };
+
+typedef std::vector<std::pair<uint32_t, fc::optional<graphene::chain::signed_block_with_info>>> block_batch;
 }
 
 delayed_node_plugin::delayed_node_plugin()
@@ -60,6 +68,8 @@ void delayed_node_plugin::plugin_set_program_options(bpo::options_description& c
 {
    cli.add_options()
          ("trusted-node", boost::program_options::value<std::string>()->required(), "RPC endpoint of a trusted validating node (required)")
+         ("trusted-node-blocks-per-request", boost::program_options::value<uint32_t>()->default_value(50), "Number of blocks fetched from the trusted node with a single request")
+         ("trusted-node-requests-in-flight", boost::program_options::value<uint32_t>()->default_value(4), "Number of block requests kept outstanding to the trusted node while syncing")
          ;
    cfg.add(cli);
 }
@@ -76,6 +86,10 @@ void delayed_node_plugin::connect()
 void delayed_node_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 {
    my->remote_endpoint = "ws://" + options.at("trusted-node").as<std::string>();
+   if( options.count("trusted-node-blocks-per-request") )
+      my->blocks_per_request = std::max<uint32_t>( options.at("trusted-node-blocks-per-request").as<uint32_t>(), 1 );
+   if( options.count("trusted-node-requests-in-flight") )
+      my->requests_in_flight = std::max<uint32_t>( options.at("trusted-node-requests-in-flight").as<uint32_t>(), 1 );
 }
 
 void delayed_node_plugin::sync_with_trusted_node()
@@ -83,6 +97,7 @@ void delayed_node_plugin::sync_with_trusted_node()
    auto& db = database();
    uint32_t synced_blocks = 0;
    uint32_t pass_count = 0;
+   fc::time_point sync_start = fc::time_point::now();
    while( true )
    {
       graphene::chain::dynamic_global_property_object remote_dpo = my->database_api->get_dynamic_global_properties();
@@ -94,20 +109,79 @@ void delayed_node_plugin::sync_with_trusted_node()
          }
          if( synced_blocks > 1 )
          {
-            ilog( "Delayed node finished syncing ${n} blocks in ${k} passes", ("n", synced_blocks)("k", pass_count) );
+            fc::microseconds elapsed = fc::time_point::now() - sync_start;
+            ilog( "Delayed node finished syncing ${n} blocks in ${k} passes, ${r} blocks/s",
+                  ("n", synced_blocks)("k", pass_count)
+                  ("r", elapsed.count() > 0 ? synced_blocks * 1000000ll / elapsed.count() : synced_blocks) );
          }
          break;
       }
       pass_count++;
-      while( remote_dpo.last_irreversible_block_num > db.head_block_num() )
+      synced_blocks += sync_blocks_until( remote_dpo.last_irreversible_block_num );
+   }
+}
+
+uint32_t delayed_node_plugin::sync_blocks_until( uint32_t last_block_num )
+{
+   auto& db = database();
+   uint32_t synced_blocks = 0;
+   uint32_t next_block_to_request = db.head_block_num() + 1;
+   std::deque<fc::future<detail::block_batch>> pending_requests;
+   fc::time_point last_report = fc::time_point::now();
+   uint32_t blocks_since_last_report = 0;
+
+   // keep several get_blocks calls outstanding so that applying one batch overlaps with the
+   // round trips of the next ones; results are consumed in request order
+   auto request_more_blocks = [&]() {
+      while( pending_requests.size() < my->requests_in_flight && next_block_to_request <= last_block_num )
       {
-         fc::optional<graphene::chain::signed_block> block = my->database_api->get_block( db.head_block_num()+1 );
-         FC_ASSERT(block, "Trusted node claims it has blocks it doesn't actually have.");
-         ilog("Pushing block #${n}", ("n", block->block_num()));
-         db.push_block(*block, 0, false);
-         synced_blocks++;
+         std::vector<uint32_t> block_nums;
+         for( ; block_nums.size() < my->blocks_per_request && next_block_to_request <= last_block_num; ++next_block_to_request )
+            block_nums.push_back( next_block_to_request );
+         fc::api<graphene::app::database_api> remote_api = my->database_api;
+         pending_requests.push_back( fc::async( [remote_api, block_nums]() {
+            return remote_api->get_blocks( block_nums );
+         }, "delayed_node get_blocks" ) );
       }
+   };
+
+   try
+   {
+      request_more_blocks();
+      while( !pending_requests.empty() )
+      {
+         detail::block_batch batch = pending_requests.front().wait();
+         pending_requests.pop_front();
+         request_more_blocks();
+
+         for( const auto& item : batch )
+         {
+            FC_ASSERT( item.second, "Trusted node claims it has blocks it doesn't actually have.", ("block_num", item.first) );
+            FC_ASSERT( item.first == db.head_block_num() + 1, "Trusted node returned block out of order",
+                       ("block_num", item.first)("head_block_num", db.head_block_num()) );
+            db.push_block( *item.second, 0, false );
+            synced_blocks++;
+            blocks_since_last_report++;
+         }
+
+         fc::time_point now = fc::time_point::now();
+         if( now - last_report >= fc::seconds(10) )
+         {
+            ilog( "Delayed node at block #${n} of ${t}, ${r} blocks/s",
+                  ("n", db.head_block_num())("t", last_block_num)
+                  ("r", blocks_since_last_report * 1000000ll / (now - last_report).count()) );
+            last_report = now;
+            blocks_since_last_report = 0;
+         }
+      }
+   }
+   catch( ... )
+   {
+      for( auto& request : pending_requests )
+         request.cancel();
+      throw;
    }
+   return synced_blocks;
 }
 
 void delayed_node_plugin::mainloop()
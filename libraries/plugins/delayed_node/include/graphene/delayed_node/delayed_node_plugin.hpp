@@ -46,6 +46,7 @@ protected:
    void connection_failed();
    void connect();
    void sync_with_trusted_node();
+   uint32_t sync_blocks_until( uint32_t last_block_num );
 };
 
 } } //graphene::account_history
@@ -28,6 +28,8 @@
 
 #include <fc/thread/future.hpp>
 
+#include <mutex>
+
 namespace graphene { namespace miner_plugin {
 
 namespace block_production_condition
@@ -46,6 +48,27 @@ namespace block_production_condition
    };
 }
 
+/**
+ * @brief Histogram of latencies in microseconds with fixed bucket bounds from 100us to 1s.
+ */
+class latency_histogram
+{
+public:
+   latency_histogram();
+
+   void record( int64_t microseconds );
+   fc::variant_object to_variant_object()const;
+
+private:
+   static const std::vector<int64_t>& bucket_bounds();
+
+   /// one bucket per bound plus the overflow bucket
+   std::vector<uint64_t> _buckets;
+   uint64_t              _count = 0;
+   int64_t               _sum = 0;
+   int64_t               _max = 0;
+};
+
 class miner_plugin : public graphene::app::plugin {
 public:
    ~miner_plugin() {
@@ -72,6 +95,9 @@ public:
    virtual void plugin_startup() override;
    virtual void plugin_shutdown() override;
 
+   /// histograms of the wake-up error at the slot time, block generation and broadcast time
+   virtual fc::variant_object plugin_statistics()const override;
+
 private:
    void schedule_production_loop();
    block_production_condition::block_production_condition_enum block_production_loop();
@@ -86,6 +112,14 @@ private:
    std::map<chain::public_key_type, fc::ecc::private_key> _private_keys;
    std::set<chain::miner_id_type> _miners;
    fc::future<void> _block_production_task;
+
+   /// slot time the production loop was scheduled for, unset while it polls every second
+   fc::optional<fc::time_point> _slot_wakeup;
+
+   mutable std::mutex _statistics_mutex;
+   latency_histogram  _wakeup_error;
+   latency_histogram  _generate_time;
+   latency_histogram  _broadcast_time;
 };
 
 } } //graphene::miner_plugin
@@ -33,6 +33,7 @@
 #include <fc/smart_ref_impl.hpp>
 #include <fc/thread/thread.hpp>
 
+#include <algorithm>
 #include <iostream>
 
 using namespace graphene::miner_plugin;
@@ -147,17 +148,80 @@ void miner_plugin::plugin_shutdown()
    return;
 }
 
+latency_histogram::latency_histogram()
+   : _buckets( bucket_bounds().size() + 1, 0 )
+{
+}
+
+const std::vector<int64_t>& latency_histogram::bucket_bounds()
+{
+   static const std::vector<int64_t> bounds = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+                                                100000, 250000, 500000, 1000000 };
+   return bounds;
+}
+
+void latency_histogram::record( int64_t microseconds )
+{
+   const auto& bounds = bucket_bounds();
+   size_t i = std::lower_bound( bounds.begin(), bounds.end(), microseconds ) - bounds.begin();
+   ++_buckets[i];
+   ++_count;
+   _sum += microseconds;
+   _max = std::max( _max, microseconds );
+}
+
+fc::variant_object latency_histogram::to_variant_object()const
+{
+   const auto& bounds = bucket_bounds();
+   fc::mutable_variant_object buckets;
+   for( size_t i = 0; i < bounds.size(); ++i )
+      buckets["le_" + fc::to_string( bounds[i] )] = _buckets[i];
+   buckets["overflow"] = _buckets.back();
+
+   fc::mutable_variant_object result;
+   result["count"] = _count;
+   result["mean_us"] = _count ? _sum / int64_t( _count ) : 0;
+   result["max_us"] = _max;
+   result["buckets"] = buckets;
+   return result;
+}
+
+fc::variant_object miner_plugin::plugin_statistics()const
+{
+   std::lock_guard<std::mutex> lock( _statistics_mutex );
+   fc::mutable_variant_object result;
+   result["wakeup_error"] = _wakeup_error.to_variant_object();
+   result["generate_block"] = _generate_time.to_variant_object();
+   result["broadcast"] = _broadcast_time.to_variant_object();
+   return result;
+}
+
 void miner_plugin::schedule_production_loop()
 {
-   //Schedule for the next second's tick regardless of chain state
-   // If we would wait less than 50ms, wait for the whole second.
    fc::time_point ntp_now = graphene::time::now();
    fc::time_point fc_now = fc::time_point::now();
-   int64_t time_to_next_second = 1000000 - (ntp_now.time_since_epoch().count() % 1000000);
-   if( time_to_next_second < 50000 )      // we must sleep for at least 50ms
-       time_to_next_second += 1000000;
+   int64_t time_to_wakeup;
 
-   fc::time_point next_wakeup( fc_now + fc::microseconds( time_to_next_second ) );
+   if( _production_enabled )
+   {
+      // Wake up at the next slot. The fc scheduler may fire a little late, so aim 1ms early
+      // and spin for the rest in block_production_loop.
+      chain::database& db = database();
+      fc::time_point slot_time = db.get_slot_time( db.get_slot_at_time( ntp_now ) + 1 );
+      _slot_wakeup = slot_time;
+      time_to_wakeup = std::max<int64_t>( ( slot_time - ntp_now ).count() - 1000, 0 );
+   }
+   else
+   {
+      //Schedule for the next second's tick regardless of chain state
+      // If we would wait less than 50ms, wait for the whole second.
+      _slot_wakeup.reset();
+      time_to_wakeup = 1000000 - (ntp_now.time_since_epoch().count() % 1000000);
+      if( time_to_wakeup < 50000 )      // we must sleep for at least 50ms
+          time_to_wakeup += 1000000;
+   }
+
+   fc::time_point next_wakeup( fc_now + fc::microseconds( time_to_wakeup ) );
 
    //wdump( (now.time_since_epoch().count())(next_wakeup.time_since_epoch().count()) );
    _block_production_task = fc::schedule([this]{block_production_loop();},
@@ -168,6 +232,15 @@ block_production_condition::block_production_condition_enum miner_plugin::block_
 {
    block_production_condition::block_production_condition_enum result;
    fc::mutable_variant_object capture;
+   if( _slot_wakeup.valid() )
+   {
+      fc::time_point ntp_now = graphene::time::now();
+      while( ntp_now < *_slot_wakeup )
+         ntp_now = graphene::time::now();
+      const int64_t error = ( ntp_now - *_slot_wakeup ).count();
+      std::lock_guard<std::mutex> lock( _statistics_mutex );
+      _wakeup_error.record( error );
+   }
    try
    {
       result = maybe_produce_block(capture);
@@ -281,14 +354,24 @@ block_production_condition::block_production_condition_enum miner_plugin::maybe_
       return block_production_condition::lag;
    }
 
+   const fc::time_point generate_start = fc::time_point::now();
    auto block = db.generate_block(
       scheduled_time,
       scheduled_miner,
       private_key_itr->second,
       _production_skip_flags
       );
+   const fc::time_point generated = fc::time_point::now();
+   {
+      std::lock_guard<std::mutex> lock( _statistics_mutex );
+      _generate_time.record( ( generated - generate_start ).count() );
+   }
    capture("n", block.block_num())("t", block.timestamp)("c", now);
-   fc::async( [this,block](){ p2p_node().broadcast(net::block_message(block)); } );
+   fc::async( [this,block,generated](){
+      p2p_node().broadcast(net::block_message(block));
+      std::lock_guard<std::mutex> lock( _statistics_mutex );
+      _broadcast_time.record( ( fc::time_point::now() - generated ).count() );
+   } );
 
    return block_production_condition::produced;
 }
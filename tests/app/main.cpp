@@ -22,8 +22,10 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <graphene/app/api.hpp>
 #include <graphene/app/application.hpp>
 #include <graphene/app/plugin.hpp>
+#include <graphene/app/transaction_precheck.hpp>
 
 
 #include <graphene/time/time.hpp>
@@ -37,6 +39,9 @@
 
 #include <boost/filesystem/path.hpp>
 
+#include <cctype>
+#include <sstream>
+
 #define BOOST_TEST_MODULE Test Application
 #include <boost/test/included/unit_test.hpp>
 
@@ -137,6 +142,100 @@ BOOST_AUTO_TEST_CASE( two_node_network )
       BOOST_CHECK_EQUAL(app1.chain_database()->head_block_num(), 1);
 
       BOOST_TEST_MESSAGE( "Checking GRAPHENE_NULL_ACCOUNT has balance" );
+
+      BOOST_TEST_MESSAGE( "Checking p2p metrics" );
+      fc::variant_object metrics = app1.p2p_node()->network_get_metrics();
+      BOOST_CHECK_EQUAL( metrics["connections"].as_uint64(), 1 );
+      BOOST_REQUIRE_EQUAL( metrics["peers"].get_array().size(), 1 );
+      const fc::variant_object& messages = metrics["messages"].get_object();
+      BOOST_REQUIRE( messages.contains( "hello_message_type" ) );
+      BOOST_CHECK_EQUAL( messages["hello_message_type"]["messages_received"].as_uint64(), 1 );
+      BOOST_CHECK_EQUAL( messages["hello_message_type"]["messages_sent"].as_uint64(), 1 );
+      BOOST_CHECK( messages["hello_message_type"]["bytes_sent"].as_uint64() > sizeof(graphene::net::message_header) );
+      // every message type is reported under its name, compressed replies included
+      for( const auto& type : messages )
+         BOOST_CHECK_MESSAGE( !isdigit( type.key()[0] ), "unnamed message type " + type.key() );
+
+      std::string metrics_text = app1.p2p_node()->network_get_metrics_text();
+      BOOST_CHECK( metrics_text.find( "graphene_p2p_connections 1\n" ) != std::string::npos );
+      BOOST_CHECK( metrics_text.find( "graphene_p2p_messages_received{type=\"hello_message_type\"} 1\n" ) != std::string::npos );
+      std::istringstream lines( metrics_text );
+      for( std::string line; std::getline( lines, line ); )
+      {
+         BOOST_CHECK_EQUAL( line.compare( 0, 13, "graphene_p2p_" ), 0 );
+         size_t value_pos = line.rfind( ' ' );
+         BOOST_REQUIRE( value_pos != std::string::npos );
+         BOOST_CHECK_NO_THROW( std::stod( line.substr( value_pos + 1 ) ) );
+      }
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( broadcast_transaction_batch )
+{
+   using namespace graphene::chain;
+   using namespace graphene::app;
+   try {
+      fc::temp_directory app_dir( graphene::utilities::temp_directory_path() );
+
+      graphene::app::application app1;
+      boost::program_options::variables_map cfg;
+      cfg.emplace("p2p-endpoint", boost::program_options::variable_value(string("127.0.0.1:5050"), false));
+      cfg.emplace("precheck-threads", boost::program_options::variable_value(uint32_t(2), false));
+      app1.initialize(app_dir.path(), cfg);
+      app1.startup();
+
+      std::shared_ptr<chain::database> db1 = app1.chain_database();
+      account_id_type nathan_id = db1->get_index_type<account_index>().indices().get<by_name>().find( "nathan" )->id;
+      fc::ecc::private_key nathan_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("nathan")));
+      auto make_transfer = [&]( int64_t amount ) {
+         signed_transaction trx;
+         transfer_operation xfer_op;
+         xfer_op.from = nathan_id;
+         xfer_op.to = GRAPHENE_NULL_ACCOUNT;
+         xfer_op.amount = asset( amount );
+         trx.operations.push_back( xfer_op );
+         db1->current_fee_schedule().set_fee( trx.operations.back() );
+         trx.set_expiration( db1->get_slot_time( 10 ) );
+         trx.sign( nathan_key, db1->get_chain_id() );
+         return trx;
+      };
+
+      signed_transaction valid = make_transfer( 1000000 );
+      signed_transaction no_operations;
+      no_operations.set_expiration( db1->get_slot_time( 10 ) );
+      // passes the stateless checks but can not be applied
+      signed_transaction overdrawn = make_transfer( GRAPHENE_MAX_SHARE_SUPPLY );
+      // with two precheck threads the copy of the valid transaction is checked after it by the same thread
+      vector<signed_transaction> batch = { valid, no_operations, valid, overdrawn };
+
+      network_broadcast_api broadcast( app1 );
+      auto results = broadcast.broadcast_transactions( batch );
+      BOOST_REQUIRE_EQUAL( results.size(), batch.size() );
+      for( size_t i = 0; i < batch.size(); ++i )
+         BOOST_CHECK( results[i].id == batch[i].id() );
+
+      BOOST_CHECK( results[0].accepted );
+      BOOST_CHECK( !results[0].error.valid() );
+      // rejected by the precheck
+      BOOST_CHECK( !results[1].accepted );
+      BOOST_CHECK( results[1].error.valid() );
+      // the copy of the first transaction is a duplicate
+      BOOST_CHECK( !results[2].accepted );
+      BOOST_CHECK( results[2].error.valid() );
+      // rejected by the chain, the others are not affected
+      BOOST_CHECK( !results[3].accepted );
+      BOOST_CHECK( results[3].error.valid() );
+
+      BOOST_CHECK_EQUAL( db1->get_balance( GRAPHENE_NULL_ACCOUNT, asset_id_type() ).amount.value, 1000000 );
+      fc::variant_object stats = app1.precheck()->get_statistics();
+      BOOST_CHECK_EQUAL( stats["admitted"].as_uint64(), 2u );
+      BOOST_CHECK_EQUAL( stats["rejected_invalid"].as_uint64(), 1u );
+      BOOST_CHECK_EQUAL( stats["rejected_duplicate"].as_uint64(), 1u );
+      // the transaction the chain rejected was forgotten and may be submitted again
+      BOOST_CHECK_EQUAL( stats["tracked"].as_uint64(), 1u );
    } catch( fc::exception& e ) {
       edump((e.to_detail_string()));
       throw;
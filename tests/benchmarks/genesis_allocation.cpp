@@ -23,15 +23,23 @@
  */
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/miner_object.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
 #include <graphene/utilities/tempdir.hpp>
 
 #include <graphene/time/time.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/io/json.hpp>
 #include <fc/smart_ref_impl.hpp>
 
 #include <boost/test/auto_unit_test.hpp>
 
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
 using namespace graphene::chain;
 
 BOOST_AUTO_TEST_CASE( operation_sanity_check )
@@ -130,3 +138,162 @@ BOOST_AUTO_TEST_CASE( genesis_and_persistence_bench )
       throw;
    }
 }
+
+/**
+ * Times the maintenance steps on a chain with many voting accounts.
+ *
+ * CHAIN_BENCH_ACCOUNTS overrides the number of accounts, CHAIN_BENCH_MAINTENANCES the number of
+ * maintenance intervals run for each thread count, CHAIN_BENCH_THREADS the comma separated maintenance
+ * thread counts, CHAIN_BENCH_DIRTY_PERCENT the share of accounts changed between two maintenances
+ * and CHAIN_BENCH_OUTPUT names a file the JSON results are written to instead of stdout.
+ *
+ * The first maintenance builds the vote tally from scratch, the later ones only recount the
+ * accounts changed in between.
+ */
+BOOST_AUTO_TEST_CASE( maintenance_bench )
+{
+   try {
+#ifdef NDEBUG
+      int account_count = 1000000;
+#else
+      int account_count = 30000;
+#endif
+      int maintenance_count = 3;
+      int dirty_percent = 5;
+      vector<uint32_t> thread_counts = { 0, 4 };
+      if( const char* env = std::getenv( "CHAIN_BENCH_ACCOUNTS" ) )
+         account_count = std::atoi( env );
+      if( const char* env = std::getenv( "CHAIN_BENCH_MAINTENANCES" ) )
+         maintenance_count = std::atoi( env );
+      if( const char* env = std::getenv( "CHAIN_BENCH_DIRTY_PERCENT" ) )
+         dirty_percent = std::max( std::min( std::atoi( env ), 100 ), 1 );
+      if( const char* env = std::getenv( "CHAIN_BENCH_THREADS" ) )
+      {
+         thread_counts.clear();
+         std::stringstream list( env );
+         string item;
+         while( std::getline( list, item, ',' ) )
+            thread_counts.push_back( std::atoi( item.c_str() ) );
+      }
+
+      const auto miner_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "null_key" ) ) );
+      const public_key_type account_key = miner_priv_key.get_public_key();
+
+      genesis_state_type genesis_state;
+      genesis_state.initial_timestamp = time_point_sec( fc::time_point::now().sec_since_epoch() / GRAPHENE_DEFAULT_BLOCK_INTERVAL * GRAPHENE_DEFAULT_BLOCK_INTERVAL );
+      genesis_state.initial_active_miners = GRAPHENE_DEFAULT_MIN_MINER_COUNT;
+      for( uint64_t i = 0; i < genesis_state.initial_active_miners; ++i )
+      {
+         auto name = "init" + fc::to_string( i );
+         genesis_state.initial_accounts.emplace_back( name, account_key, account_key );
+         genesis_state.initial_miner_candidates.push_back( { name, account_key } );
+      }
+      // every account shares the same key, the benchmark never signs for them
+      for( int i = 0; i < account_count; ++i )
+         genesis_state.initial_accounts.emplace_back( "target" + fc::to_string( i ), account_key );
+      genesis_state.initial_parameters.current_fees->zero_all_fees();
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      database db;
+      fc::time_point start_time = fc::time_point::now();
+      db.open( data_dir.path(), [&]{ return genesis_state; } );
+      const int64_t open_ms = ( fc::time_point::now() - start_time ).count() / 1000;
+
+      // give every account a balance and a vote, every 10th account follows the previous one
+      // and every 4th account also holds a vesting balance
+      start_time = fc::time_point::now();
+      vector<vote_id_type> miner_votes;
+      for( const miner_object& m : db.get_index_type<miner_index>().indices() )
+         miner_votes.push_back( m.vote_id );
+      const auto& by_name = db.get_index_type<account_index>().indices().get<by_name>();
+      vector<account_id_type> targets;
+      targets.reserve( account_count );
+      for( int i = 0; i < account_count; ++i )
+         targets.push_back( by_name.find( "target" + fc::to_string( i ) )->id );
+      for( int i = 0; i < account_count; ++i )
+      {
+         const account_id_type id = targets[i];
+         db.adjust_balance( id, asset( 1000 + i % 1000 ) );
+         db.modify( id( db ), [&]( account_object& a ) {
+            if( i % 10 == 9 )
+               a.options.voting_account = targets[i - 1];
+            a.options.votes.insert( miner_votes[i % miner_votes.size()] );
+            a.options.votes.insert( miner_votes[( i + 1 ) % miner_votes.size()] );
+            a.options.num_miner = 2;
+         } );
+         if( i % 4 == 0 )
+         {
+            const auto& vb = db.create<vesting_balance_object>( [&]( vesting_balance_object& o ) {
+               o.owner = id;
+               o.balance = asset( 500 );
+               o.policy = linear_vesting_policy();
+            } );
+            db.modify( id( db ), [&]( account_object& a ) { a.cashback_vb = vb.id; } );
+         }
+      }
+      const int64_t setup_ms = ( fc::time_point::now() - start_time ).count() / 1000;
+
+      // changes the balance of every account in a different slice of the accounts each time and
+      // moves the votes of every tenth of them, so the next maintenance has work to do
+      const int dirty_stride = 100 / dirty_percent;
+      int dirty_round = 0;
+      auto make_dirty = [&]() {
+         const int offset = dirty_round++ % dirty_stride;
+         for( int i = offset; i < account_count; i += dirty_stride )
+         {
+            db.adjust_balance( targets[i], asset( 1 + dirty_round ) );
+            if( ( i / dirty_stride ) % 10 == 0 )
+               db.modify( targets[i]( db ), [&]( account_object& a ) {
+                  a.options.votes.erase( a.options.votes.begin() );
+                  a.options.votes.insert( miner_votes[( i + dirty_round + 1 ) % miner_votes.size()] );
+               } );
+         }
+      };
+
+      fc::variants maintenances;
+      for( uint32_t thread_count : thread_counts )
+      {
+         db.set_maintenance_threads( thread_count );
+         for( int m = 0; m < maintenance_count; ++m )
+         {
+            // the first block after genesis always runs a maintenance with nothing changed before it
+            if( db.head_block_num() > 0 )
+               make_dirty();
+            const fc::time_point_sec next_maintenance = db.get_dynamic_global_properties().next_maintenance_time;
+            // jump straight to the first slot at or after the maintenance time
+            do
+            {
+               const uint32_t slot = std::max( db.get_slot_at_time( next_maintenance ), 1u );
+               start_time = fc::time_point::now();
+               db.generate_block( db.get_slot_time( slot ), db.get_scheduled_miner( slot ), miner_priv_key, ~0 );
+            } while( db.head_block_time() < next_maintenance );
+            const int64_t block_us = ( fc::time_point::now() - start_time ).count();
+            fc::mutable_variant_object timings( db.get_last_maintenance_timings() );
+            timings["block"] = block_us;
+            timings["maintenance_threads"] = thread_count;
+            maintenances.push_back( timings );
+         }
+      }
+
+      fc::mutable_variant_object result;
+      result["accounts"] = account_count;
+      result["dirty_percent"] = dirty_percent;
+      result["open_ms"] = open_ms;
+      result["setup_ms"] = setup_ms;
+      result["maintenances"] = maintenances;
+
+      const string json = fc::json::to_pretty_string( result );
+      if( const char* output = std::getenv( "CHAIN_BENCH_OUTPUT" ) )
+      {
+         std::ofstream out( output );
+         out << json << "\n";
+      }
+      else
+         std::cout << json << std::endl;
+
+      db.close();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
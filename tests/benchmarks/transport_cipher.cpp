@@ -0,0 +1,112 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+#include <graphene/net/aead_channel.hpp>
+#include <graphene/net/config.hpp>
+#include <graphene/net/stcp_socket.hpp>
+
+#include <fc/crypto/aes.hpp>
+#include <fc/crypto/city.hpp>
+#include <fc/io/json.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using graphene::net::detail::aead_channel;
+
+/**
+ * Measures the throughput of the p2p transport ciphers: the aes stream every connection starts
+ * with and the AEAD ciphers it can be upgraded to.  Each cipher encrypts and decrypts the same
+ * amount of data in chunks of GRAPHENE_NET_AEAD_MAX_RECORD_SIZE bytes.
+ *
+ * CHAIN_BENCH_TRANSPORT_MB overrides the megabytes sent through each cipher and
+ * CHAIN_BENCH_TRANSPORT_OUTPUT names a file the JSON results are written to instead of stdout.
+ */
+BOOST_AUTO_TEST_CASE( transport_cipher_bench )
+{
+   try {
+#ifdef NDEBUG
+      uint64_t megabytes = 1024;
+#else
+      uint64_t megabytes = 32;
+#endif
+      if( const char* env = std::getenv( "CHAIN_BENCH_TRANSPORT_MB" ) )
+         megabytes = std::strtoull( env, nullptr, 10 );
+
+      const uint32_t chunk_size = GRAPHENE_NET_AEAD_MAX_RECORD_SIZE;
+      const uint64_t chunks = std::max<uint64_t>( megabytes * 1024 * 1024 / chunk_size, 1 );
+      const double total_mb = double( chunks * chunk_size ) / ( 1024 * 1024 );
+      std::vector<char> plaintext( chunk_size );
+      for( uint32_t i = 0; i < chunk_size; ++i )
+         plaintext[i] = char( i * 7 + 3 );
+      std::vector<char> record( aead_channel::record_header_size + chunk_size + aead_channel::tag_size );
+      std::vector<char> opened( chunk_size );
+
+      const fc::sha512 secret = fc::sha512::hash( std::string( "transport bench" ) );
+      const fc::sha256 key = fc::sha256::hash( (const char*)&secret, sizeof(secret) );
+      auto to_mb_per_s = [&]( const fc::microseconds& elapsed ) {
+         return elapsed.count() > 0 ? total_mb * 1000000 / elapsed.count() : 0.;
+      };
+
+      fc::variants ciphers;
+      {
+         fc::aes_encoder encoder;
+         fc::aes_decoder decoder;
+         encoder.init( key, fc::city_hash_crc_128( (const char*)&secret, sizeof(secret) ) );
+         decoder.init( key, fc::city_hash_crc_128( (const char*)&secret, sizeof(secret) ) );
+         fc::time_point start_time = fc::time_point::now();
+         for( uint64_t i = 0; i < chunks; ++i )
+         {
+            encoder.encode( plaintext.data(), chunk_size, record.data() );
+            decoder.decode( record.data(), chunk_size, opened.data() );
+         }
+         const fc::microseconds elapsed = fc::time_point::now() - start_time;
+         BOOST_CHECK( opened == plaintext );
+
+         fc::mutable_variant_object result;
+         result["algorithm"] = "aes-256-cbc-stream";
+         result["us"] = elapsed.count();
+         result["mb_per_s"] = to_mb_per_s( elapsed );
+         ciphers.push_back( result );
+      }
+      for( const std::string& algorithm : graphene::net::stcp_socket::get_supported_aead_algorithms() )
+      {
+         aead_channel sender( algorithm, key, true );
+         aead_channel receiver( algorithm, key, false );
+         fc::time_point start_time = fc::time_point::now();
+         for( uint64_t i = 0; i < chunks; ++i )
+         {
+            sender.seal( plaintext.data(), chunk_size, record.data() );
+            receiver.open( chunk_size, record.data() + aead_channel::record_header_size, opened.data() );
+         }
+         const fc::microseconds elapsed = fc::time_point::now() - start_time;
+         BOOST_CHECK( opened == plaintext );
+
+         fc::mutable_variant_object result;
+         result["algorithm"] = algorithm;
+         result["us"] = elapsed.count();
+         result["mb_per_s"] = to_mb_per_s( elapsed );
+         ciphers.push_back( result );
+      }
+
+      fc::mutable_variant_object result;
+      result["megabytes"] = total_mb;
+      result["record_size"] = chunk_size;
+      result["ciphers"] = ciphers;
+
+      const std::string json = fc::json::to_pretty_string( result );
+      if( const char* output = std::getenv( "CHAIN_BENCH_TRANSPORT_OUTPUT" ) )
+      {
+         std::ofstream out( output );
+         out << json << "\n";
+      }
+      else
+         std::cout << json << std::endl;
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
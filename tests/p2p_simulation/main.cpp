@@ -0,0 +1,644 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+/**
+ * Runs a network of graphene::net::node instances in one process and reports how long
+ * blocks and transactions take to reach every node, and how many bytes that puts on the wire.
+ *
+ * Every connection between two nodes goes through an emulated link: a loopback tcp relay
+ * that holds each chunk of data back for the configured latency and forwards no faster than
+ * the configured bandwidth.  Each node keeps its blocks in a simulated in-memory chain which
+ * accepts any block that links to its head, so what is measured is the p2p code and not
+ * block validation.
+ */
+#include <graphene/net/node.hpp>
+#include <graphene/net/exceptions.hpp>
+#include <graphene/chain/protocol/block.hpp>
+#include <graphene/chain/exceptions.hpp>
+
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/crypto/rand.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <unordered_map>
+
+using namespace graphene;
+using graphene::chain::signed_block;
+using graphene::chain::signed_transaction;
+using graphene::chain::block_id_type;
+using graphene::chain::transaction_id_type;
+using graphene::net::item_hash_t;
+using graphene::net::item_id;
+
+namespace bpo = boost::program_options;
+
+/**
+ * Relays the connections made to it to the destination.  In each direction, data read from
+ * one socket is released to the other after the link latency, at no more than the link bandwidth
+ */
+class emulated_link
+{
+   public:
+      emulated_link( const fc::ip::endpoint& destination, fc::microseconds latency, uint32_t bytes_per_second ) :
+         _destination( destination ), _latency( latency ), _bytes_per_second( bytes_per_second ), _bytes_forwarded( 0 ) {}
+
+      /** starts accepting connections on a free loopback port and returns it */
+      fc::ip::endpoint start()
+      {
+         _server.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+         _accept_loop_done = fc::async( [this](){ accept_loop(); }, "emulated_link accept_loop" );
+         return _server.get_local_endpoint();
+      }
+
+      void stop()
+      {
+         _server.close();
+         for( const std::shared_ptr<fc::tcp_socket>& socket : _sockets )
+            socket->close();
+         for( fc::future<void>& task : _tasks )
+            task.cancel_and_wait( "emulated_link stopped" );
+         _accept_loop_done.cancel_and_wait( "emulated_link stopped" );
+      }
+
+      uint64_t get_bytes_forwarded() const { return _bytes_forwarded; }
+
+   private:
+      struct chunk
+      {
+         fc::time_point    release_time;
+         std::vector<char> data;
+      };
+      struct direction
+      {
+         std::shared_ptr<fc::tcp_socket> from;
+         std::shared_ptr<fc::tcp_socket> to;
+         std::deque<chunk>               in_transit;
+         bool                            closed = false;
+      };
+
+      void accept_loop()
+      {
+         while( true )
+         {
+            std::shared_ptr<fc::tcp_socket> incoming = std::make_shared<fc::tcp_socket>();
+            _server.accept( *incoming );
+            std::shared_ptr<fc::tcp_socket> outgoing = std::make_shared<fc::tcp_socket>();
+            outgoing->connect_to( _destination );
+            _sockets.push_back( incoming );
+            _sockets.push_back( outgoing );
+            forward( incoming, outgoing );
+            forward( outgoing, incoming );
+         }
+      }
+
+      void forward( const std::shared_ptr<fc::tcp_socket>& from, const std::shared_ptr<fc::tcp_socket>& to )
+      {
+         std::shared_ptr<direction> link_direction = std::make_shared<direction>();
+         link_direction->from = from;
+         link_direction->to = to;
+         _tasks.push_back( fc::async( [this, link_direction](){ read_loop( link_direction ); }, "emulated_link read_loop" ) );
+         _tasks.push_back( fc::async( [this, link_direction](){ write_loop( link_direction ); }, "emulated_link write_loop" ) );
+      }
+
+      void read_loop( std::shared_ptr<direction> link_direction )
+      {
+         try
+         {
+            char buffer[16 * 1024];
+            while( true )
+            {
+               size_t bytes_read = link_direction->from->readsome( buffer, sizeof(buffer) );
+               link_direction->in_transit.push_back( chunk{ fc::time_point::now() + _latency,
+                                                            std::vector<char>( buffer, buffer + bytes_read ) } );
+            }
+         }
+         catch( const fc::canceled_exception& )
+         {
+            throw;
+         }
+         catch( const fc::exception& )
+         {
+            link_direction->closed = true;
+         }
+      }
+
+      void write_loop( std::shared_ptr<direction> link_direction )
+      {
+         fc::time_point link_free_time = fc::time_point::now();
+         try
+         {
+            while( !link_direction->closed || !link_direction->in_transit.empty() )
+            {
+               if( link_direction->in_transit.empty() )
+               {
+                  fc::usleep( fc::milliseconds( 1 ) );
+                  continue;
+               }
+               chunk& next_chunk = link_direction->in_transit.front();
+               fc::time_point send_time = std::max( next_chunk.release_time, link_free_time );
+               if( send_time > fc::time_point::now() )
+                  fc::sleep_until( send_time );
+               link_direction->to->write( next_chunk.data.data(), next_chunk.data.size() );
+               _bytes_forwarded += next_chunk.data.size();
+               if( _bytes_per_second )
+                  link_free_time = std::max( link_free_time, fc::time_point::now() ) +
+                                   fc::microseconds( next_chunk.data.size() * 1000000 / _bytes_per_second );
+               link_direction->in_transit.pop_front();
+            }
+            link_direction->to->close();
+         }
+         catch( const fc::canceled_exception& )
+         {
+            throw;
+         }
+         catch( const fc::exception& )
+         {
+            link_direction->from->close();
+         }
+      }
+
+      fc::ip::endpoint                              _destination;
+      fc::microseconds                              _latency;
+      uint32_t                                      _bytes_per_second;
+      std::atomic<uint64_t>                         _bytes_forwarded;
+      fc::tcp_server                                _server;
+      fc::future<void>                              _accept_loop_done;
+      std::vector<std::shared_ptr<fc::tcp_socket>>  _sockets;
+      std::vector<fc::future<void>>                 _tasks;
+};
+
+/** when each node first saw each block and transaction */
+struct propagation_record
+{
+   fc::time_point                       origin_time;
+   std::map<uint32_t, fc::time_point>   arrival_times;
+};
+
+struct propagation_log
+{
+   std::unordered_map<block_id_type, propagation_record>        blocks;
+   std::unordered_map<transaction_id_type, propagation_record>  transactions;
+};
+
+/** linear in-memory chain which accepts every block that links to its head */
+class simulated_chain : public graphene::net::node_delegate
+{
+   public:
+      simulated_chain( uint32_t node_index, uint8_t block_interval, propagation_log& log ) :
+         _node_index( node_index ), _block_interval( block_interval ), _log( log ) {}
+
+      const block_id_type& head_block_id() const { return _block_ids.empty() ? _no_block : _block_ids.back(); }
+      fc::time_point_sec head_block_time() const { return _block_ids.empty() ? fc::time_point_sec() : _blocks.at( head_block_id() ).timestamp; }
+
+      void push_block( const signed_block& block )
+      {
+         _block_ids.push_back( block.id() );
+         _blocks[_block_ids.back()] = block;
+         for( const signed_transaction& trx : block.transactions )
+            _pending_transactions.erase( trx.id() );
+      }
+
+      void push_transaction( const signed_transaction& trx )
+      {
+         _transactions[trx.id()] = trx;
+         _pending_transactions[trx.id()] = trx;
+      }
+
+      std::vector<signed_transaction> take_pending_transactions()
+      {
+         std::vector<signed_transaction> result;
+         for( const auto& item : _pending_transactions )
+            result.push_back( item.second );
+         _pending_transactions.clear();
+         return result;
+      }
+
+      virtual bool has_item( const item_id& id ) override
+      {
+         if( id.item_type == graphene::net::block_message_type )
+            return _blocks.find( id.item_hash ) != _blocks.end();
+         return _transactions.find( id.item_hash ) != _transactions.end();
+      }
+
+      virtual bool handle_block( const graphene::net::block_message& blk_msg, bool sync_mode,
+                                 std::vector<fc::uint160_t>& contained_transaction_message_ids ) override
+      {
+         if( _blocks.find( blk_msg.block_id ) != _blocks.end() )
+            return false;
+         if( blk_msg.block.previous != head_block_id() )
+            FC_THROW_EXCEPTION( graphene::chain::unlinkable_block_exception, "block does not link to the head of the simulated chain",
+                                ("block_id", blk_msg.block_id)("head", head_block_id()) );
+         push_block( blk_msg.block );
+         record_arrival( _log.blocks, blk_msg.block_id );
+         return false;
+      }
+
+      virtual void handle_transaction( const graphene::net::trx_message& trx_msg ) override
+      {
+         transaction_id_type id = trx_msg.trx.id();
+         if( _transactions.find( id ) != _transactions.end() )
+            return;
+         push_transaction( trx_msg.trx );
+         record_arrival( _log.transactions, id );
+      }
+
+      virtual void handle_message( const graphene::net::message& message_to_process ) override {}
+
+      virtual std::vector<item_hash_t> get_block_ids( const std::vector<item_hash_t>& blockchain_synopsis,
+                                                      uint32_t& remaining_item_count,
+                                                      uint32_t limit ) override
+      {
+         remaining_item_count = 0;
+         std::vector<item_hash_t> result;
+         uint32_t first_block_num = 1;
+         for( auto iter = blockchain_synopsis.rbegin(); iter != blockchain_synopsis.rend(); ++iter )
+            if( *iter == item_hash_t() || _blocks.find( *iter ) != _blocks.end() )
+            {
+               first_block_num = graphene::chain::block_header::num_from_id( *iter );
+               break;
+            }
+         first_block_num = std::max<uint32_t>( first_block_num, 1 );
+         for( uint32_t num = first_block_num; num <= _block_ids.size() && result.size() < limit; ++num )
+            result.push_back( _block_ids[num - 1] );
+         if( !result.empty() )
+            remaining_item_count = _block_ids.size() - graphene::chain::block_header::num_from_id( result.back() );
+         return result;
+      }
+
+      virtual graphene::net::message get_item( const item_id& id ) override
+      {
+         if( id.item_type == graphene::net::block_message_type )
+         {
+            auto iter = _blocks.find( id.item_hash );
+            FC_ASSERT( iter != _blocks.end(), "unknown block" );
+            return graphene::net::block_message( iter->second );
+         }
+         auto iter = _transactions.find( id.item_hash );
+         FC_ASSERT( iter != _transactions.end(), "unknown transaction" );
+         return graphene::net::trx_message( iter->second );
+      }
+
+      virtual std::vector<graphene::chain::signed_block_header> get_block_headers( const std::vector<item_hash_t>& block_ids ) override
+      {
+         std::vector<graphene::chain::signed_block_header> result;
+         for( const item_hash_t& block_id : block_ids )
+         {
+            auto iter = _blocks.find( block_id );
+            if( iter == _blocks.end() )
+               break;
+            result.push_back( iter->second );
+         }
+         return result;
+      }
+
+      virtual graphene::chain::chain_id_type get_chain_id() const override { return graphene::chain::chain_id_type(); }
+
+      virtual std::vector<item_hash_t> get_blockchain_synopsis( const item_hash_t& reference_point,
+                                                                uint32_t number_of_blocks_after_reference_point ) override
+      {
+         // the simulated chain never forks, so the synopsis always comes from our own chain
+         std::vector<item_hash_t> synopsis;
+         uint32_t high_block_num = (uint32_t)_block_ids.size();
+         if( reference_point != item_hash_t() )
+            high_block_num = std::min( high_block_num, graphene::chain::block_header::num_from_id( reference_point ) );
+         uint32_t true_high_block_num = high_block_num + number_of_blocks_after_reference_point;
+         for( uint32_t low_block_num = 1; low_block_num <= high_block_num; low_block_num += (true_high_block_num - low_block_num + 2) / 2 )
+            synopsis.push_back( _block_ids[low_block_num - 1] );
+         return synopsis;
+      }
+
+      virtual void sync_status( uint32_t item_type, uint32_t item_count ) override {}
+      virtual void connection_count_changed( uint32_t c ) override {}
+
+      virtual uint32_t get_block_number( const item_hash_t& block_id ) override
+      {
+         return graphene::chain::block_header::num_from_id( block_id );
+      }
+
+      virtual fc::time_point_sec get_block_time( const item_hash_t& block_id ) override
+      {
+         if( block_id == item_hash_t() )
+            return fc::time_point_sec();
+         auto iter = _blocks.find( block_id );
+         return iter == _blocks.end() ? fc::time_point_sec::min() : iter->second.timestamp;
+      }
+
+      virtual fc::time_point_sec get_blockchain_now() override { return fc::time_point::now(); }
+      virtual item_hash_t get_head_block_id() const override { return head_block_id(); }
+      virtual uint32_t estimate_last_known_fork_from_git_revision_timestamp( uint32_t unix_timestamp ) const override { return 0; }
+
+      virtual void error_encountered( const std::string& message, const fc::oexception& error ) override
+      {
+         elog( "node ${node}: ${message}", ("node", _node_index)("message", message) );
+      }
+
+      virtual uint8_t get_current_block_interval_in_seconds() const override { return _block_interval; }
+
+   private:
+      template<typename Id>
+      void record_arrival( std::unordered_map<Id, propagation_record>& records, const Id& id )
+      {
+         auto iter = records.find( id );
+         if( iter != records.end() )
+            iter->second.arrival_times.emplace( _node_index, fc::time_point::now() );
+      }
+
+      uint32_t                                                     _node_index;
+      uint8_t                                                      _block_interval;
+      propagation_log&                                             _log;
+      block_id_type                                                _no_block;
+      std::vector<block_id_type>                                   _block_ids;
+      std::unordered_map<block_id_type, signed_block>              _blocks;
+      std::unordered_map<transaction_id_type, signed_transaction>  _transactions;
+      std::map<transaction_id_type, signed_transaction>            _pending_transactions;
+};
+
+/** the pairs of nodes to connect, the first one of each pair connects to the second */
+std::vector<std::pair<uint32_t, uint32_t>> make_topology( const std::string& topology, uint32_t node_count, uint32_t degree, std::mt19937& random )
+{
+   std::set<std::pair<uint32_t, uint32_t>> edges;
+   auto add_edge = [&]( uint32_t a, uint32_t b ) {
+      if( a != b && !edges.count( std::make_pair( b, a ) ) )
+         edges.insert( std::make_pair( a, b ) );
+   };
+   if( topology == "full" )
+   {
+      for( uint32_t a = 0; a < node_count; ++a )
+         for( uint32_t b = a + 1; b < node_count; ++b )
+            add_edge( a, b );
+   }
+   else if( topology == "line" || topology == "ring" )
+   {
+      for( uint32_t a = 0; a + 1 < node_count; ++a )
+         add_edge( a, a + 1 );
+      if( topology == "ring" && node_count > 2 )
+         add_edge( node_count - 1, 0 );
+   }
+   else if( topology == "star" )
+   {
+      for( uint32_t a = 1; a < node_count; ++a )
+         add_edge( a, 0 );
+   }
+   else if( topology == "random" )
+   {
+      // a ring keeps the network connected, the other connections are random
+      for( uint32_t a = 0; a < node_count; ++a )
+         add_edge( a, (a + 1) % node_count );
+      std::uniform_int_distribution<uint32_t> pick_node( 0, node_count - 1 );
+      for( uint32_t a = 0; a < node_count; ++a )
+         for( uint32_t extra = 2; extra < degree; ++extra )
+            add_edge( a, pick_node( random ) );
+   }
+   else
+      FC_THROW( "unknown topology ${topology}, expected full, line, ring, star or random", ("topology", topology) );
+   return std::vector<std::pair<uint32_t, uint32_t>>( edges.begin(), edges.end() );
+}
+
+signed_transaction make_transaction( uint64_t sequence, uint32_t signatures )
+{
+   signed_transaction trx;
+   trx.expiration = fc::time_point_sec( fc::time_point::now() ) + 3600;
+   trx.ref_block_num = (uint16_t)sequence;
+   trx.ref_block_prefix = (uint32_t)(sequence >> 16);
+   for( uint32_t s = 0; s < signatures; ++s )
+   {
+      graphene::chain::signature_type signature;
+      fc::rand_pseudo_bytes( (char*)signature.begin(), signature.size() );
+      trx.signatures.push_back( signature );
+   }
+   return trx;
+}
+
+/** prints the percentiles of the time items took to reach every node, and to reach a node on average */
+template<typename Id>
+void report_propagation( const std::string& name, const std::unordered_map<Id, propagation_record>& records, uint32_t node_count )
+{
+   std::vector<int64_t> time_to_all_nodes;
+   std::vector<int64_t> time_to_a_node;
+   uint32_t incomplete = 0;
+   for( const auto& item : records )
+   {
+      const propagation_record& record = item.second;
+      for( const auto& arrival : record.arrival_times )
+         time_to_a_node.push_back( (arrival.second - record.origin_time).count() );
+      if( record.arrival_times.size() + 1 < node_count )
+      {
+         ++incomplete;
+         continue;
+      }
+      fc::time_point last_arrival = record.origin_time;
+      for( const auto& arrival : record.arrival_times )
+         last_arrival = std::max( last_arrival, arrival.second );
+      time_to_all_nodes.push_back( (last_arrival - record.origin_time).count() );
+   }
+   auto percentile = []( std::vector<int64_t>& values, double fraction ) -> double {
+      if( values.empty() )
+         return 0;
+      size_t index = std::min( values.size() - 1, (size_t)(fraction * values.size()) );
+      std::nth_element( values.begin(), values.begin() + index, values.end() );
+      return values[index] / 1000.0;
+   };
+   std::cout << name << ": " << records.size() << " sent, " << incomplete << " did not reach every node\n"
+             << "  to all nodes: p50 " << percentile( time_to_all_nodes, 0.5 ) << " ms, p99 " << percentile( time_to_all_nodes, 0.99 )
+             << " ms, max " << percentile( time_to_all_nodes, 1.0 ) << " ms\n"
+             << "  to a node:    p50 " << percentile( time_to_a_node, 0.5 ) << " ms, p99 " << percentile( time_to_a_node, 0.99 ) << " ms\n";
+}
+
+int main( int argc, char** argv )
+{
+   try {
+      bpo::options_description cli( "Runs a simulated p2p network in this process and reports propagation times" );
+      cli.add_options()
+         ( "help,h", "Print this help message and exit" )
+         ( "nodes", bpo::value<uint32_t>()->default_value( 10 ), "Number of nodes" )
+         ( "topology", bpo::value<std::string>()->default_value( "random" ), "full, line, ring, star or random" )
+         ( "degree", bpo::value<uint32_t>()->default_value( 4 ), "Connections per node in the random topology" )
+         ( "latency-ms", bpo::value<uint32_t>()->default_value( 50 ), "One way latency of every link" )
+         ( "bandwidth", bpo::value<uint32_t>()->default_value( 1024 * 1024 ), "Bytes per second each link carries in each direction, 0 for unlimited" )
+         ( "blocks", bpo::value<uint32_t>()->default_value( 20 ), "Number of blocks to produce" )
+         ( "block-interval", bpo::value<uint32_t>()->default_value( 3 ), "Seconds between blocks" )
+         ( "transactions-per-second", bpo::value<uint32_t>()->default_value( 50 ), "Transactions broadcast by random nodes" )
+         ( "transaction-signatures", bpo::value<uint32_t>()->default_value( 1 ), "Signatures per transaction, to vary their size" )
+         ( "node-parameters", bpo::value<std::string>(), "JSON object of advanced node parameters for every node" )
+         ( "sync-blocks", bpo::value<uint32_t>()->default_value( 0 ), "Blocks a node joining after the run downloads from every other node" )
+         ( "sync-block-transactions", bpo::value<uint32_t>()->default_value( 20 ), "Transactions in each of those blocks" )
+         ( "sync-checkpoint", "Give the joining node a checkpoint at the last of those blocks" )
+         ( "seed", bpo::value<uint32_t>()->default_value( 1 ), "Seed for the topology and the transaction origins" );
+      bpo::variables_map options;
+      bpo::store( bpo::parse_command_line( argc, argv, cli ), options );
+      if( options.count( "help" ) )
+      {
+         std::cout << cli << "\n";
+         return 0;
+      }
+
+      const uint32_t node_count = std::max<uint32_t>( options["nodes"].as<uint32_t>(), 2 );
+      const uint32_t block_interval = std::max<uint32_t>( options["block-interval"].as<uint32_t>(), 1 );
+      const uint32_t transactions_per_second = options["transactions-per-second"].as<uint32_t>();
+      std::mt19937 random( options["seed"].as<uint32_t>() );
+
+      fc::temp_directory data_dir( fc::temp_directory_path() );
+      propagation_log log;
+      std::vector<std::unique_ptr<simulated_chain>> chains;
+      std::vector<graphene::net::node_ptr> nodes;
+
+      fc::mutable_variant_object node_parameters;
+      node_parameters["maximum_number_of_connections"] = node_count;
+      // only the connections of the topology, nothing found through peer addresses
+      node_parameters["desired_number_of_connections"] = 0;
+      if( options.count( "node-parameters" ) )
+         for( const auto& parameter : fc::json::from_string( options["node-parameters"].as<std::string>() ).get_object() )
+            node_parameters[parameter.key()] = parameter.value();
+
+      for( uint32_t i = 0; i < node_count; ++i )
+      {
+         chains.emplace_back( new simulated_chain( i, block_interval, log ) );
+         graphene::net::node_ptr node = std::make_shared<graphene::net::node>( "p2p simulation" );
+         node->load_configuration( data_dir.path() / fc::to_string( (uint64_t)i ) );
+         node->set_node_delegate( chains.back().get() );
+         node->listen_on_endpoint( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ), false );
+         node->listen_to_p2p_network();
+         node->set_advanced_node_parameters( node_parameters );
+         node->disable_peer_advertising();
+         node->connect_to_p2p_network();
+         node->sync_from( item_id( graphene::net::block_message_type, item_hash_t() ), std::vector<uint32_t>() );
+         nodes.push_back( node );
+      }
+
+      fc::thread link_thread( "emulated links" );
+      std::vector<std::unique_ptr<emulated_link>> links;
+      auto edges = make_topology( options["topology"].as<std::string>(), node_count, options["degree"].as<uint32_t>(), random );
+      for( const auto& edge : edges )
+      {
+         links.emplace_back( new emulated_link( nodes[edge.second]->get_actual_listening_endpoint(),
+                                                fc::milliseconds( options["latency-ms"].as<uint32_t>() ),
+                                                options["bandwidth"].as<uint32_t>() ) );
+         emulated_link* link = links.back().get();
+         fc::ip::endpoint link_endpoint = link_thread.async( [link](){ return link->start(); } ).wait();
+         nodes[edge.first]->connect_to_endpoint( link_endpoint );
+      }
+      std::cout << node_count << " nodes, " << edges.size() << " links\n";
+      fc::usleep( fc::seconds( 2 ) );
+
+      // node 0 produces the blocks, random nodes originate the transactions
+      std::uniform_int_distribution<uint32_t> pick_node( 0, node_count - 1 );
+      uint64_t transaction_sequence = 0;
+      for( uint32_t block_num = 1; block_num <= options["blocks"].as<uint32_t>(); ++block_num )
+      {
+         fc::time_point block_time = fc::time_point::now() + fc::seconds( block_interval );
+         uint64_t transactions_this_interval = (uint64_t)transactions_per_second * block_interval;
+         for( uint64_t i = 0; i < transactions_this_interval; ++i )
+         {
+            signed_transaction trx = make_transaction( transaction_sequence++, options["transaction-signatures"].as<uint32_t>() );
+            uint32_t origin = pick_node( random );
+            log.transactions[trx.id()].origin_time = fc::time_point::now();
+            chains[origin]->push_transaction( trx );
+            nodes[origin]->broadcast( graphene::net::trx_message( trx ) );
+            fc::usleep( fc::microseconds( 1000000 / std::max<uint32_t>( transactions_per_second, 1 ) ) );
+         }
+         if( block_time > fc::time_point::now() )
+            fc::sleep_until( block_time );
+
+         signed_block block;
+         block.previous = chains[0]->head_block_id();
+         block.timestamp = std::max( fc::time_point_sec( fc::time_point::now() ), chains[0]->head_block_time() + 1 );
+         block.transactions = chains[0]->take_pending_transactions();
+         log.blocks[block.id()].origin_time = fc::time_point::now();
+         chains[0]->push_block( block );
+         nodes[0]->broadcast( graphene::net::block_message( block ) );
+      }
+      fc::usleep( fc::seconds( block_interval ) );
+
+      report_propagation( "blocks", log.blocks, node_count );
+      report_propagation( "transactions", log.transactions, node_count );
+      uint64_t bytes_on_wire = 0;
+      for( const auto& link : links )
+         bytes_on_wire += link->get_bytes_forwarded();
+      std::cout << "bytes on the wire: " << bytes_on_wire << " (" << bytes_on_wire / std::max<size_t>( edges.size(), 1 ) << " per link)\n";
+      // compare with --node-parameters '{"inventory_trickle_interval_ms":0}' to see what trickling saves
+      uint64_t inventory_messages = 0;
+      for( const graphene::net::node_ptr& node : nodes )
+         inventory_messages += node->network_get_metrics()["inventory_messages_sent"].as_uint64();
+      std::cout << "inventory messages: " << inventory_messages << "\n";
+
+      // a node joining late downloads blocks the others already have from all of them at once.
+      // Compare with --node-parameters '{"header_first_sync":false}' to see what checking the
+      // headers first costs, and with --sync-checkpoint for the headers up to a checkpoint
+      const uint32_t sync_blocks = options["sync-blocks"].as<uint32_t>();
+      if( sync_blocks > 0 )
+      {
+         std::vector<uint32_t> sources;
+         for( uint32_t i = 0; i < node_count; ++i )
+            if( chains[i]->head_block_id() == chains[0]->head_block_id() )
+               sources.push_back( i );
+         for( uint32_t n = 0; n < sync_blocks; ++n )
+         {
+            signed_block block;
+            block.previous = chains[0]->head_block_id();
+            block.timestamp = chains[0]->head_block_time() + block_interval;
+            for( uint32_t t = 0; t < options["sync-block-transactions"].as<uint32_t>(); ++t )
+               block.transactions.push_back( graphene::chain::processed_transaction( make_transaction( transaction_sequence++, options["transaction-signatures"].as<uint32_t>() ) ) );
+            for( uint32_t source : sources )
+               chains[source]->push_block( block );
+         }
+         const block_id_type target = chains[0]->head_block_id();
+
+         chains.emplace_back( new simulated_chain( node_count, block_interval, log ) );
+         simulated_chain* joining_chain = chains.back().get();
+         graphene::net::node_ptr node = std::make_shared<graphene::net::node>( "p2p simulation" );
+         node->load_configuration( data_dir.path() / fc::to_string( (uint64_t)node_count ) );
+         node->set_node_delegate( joining_chain );
+         node->listen_on_endpoint( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ), false );
+         node->listen_to_p2p_network();
+         node->set_advanced_node_parameters( node_parameters );
+         node->disable_peer_advertising();
+         if( options.count( "sync-checkpoint" ) )
+            node->add_checkpoints( { { graphene::chain::block_header::num_from_id( target ), target } } );
+         node->connect_to_p2p_network();
+         node->sync_from( item_id( graphene::net::block_message_type, item_hash_t() ), std::vector<uint32_t>() );
+         nodes.push_back( node );
+
+         fc::time_point sync_start = fc::time_point::now();
+         for( uint32_t source : sources )
+         {
+            links.emplace_back( new emulated_link( nodes[source]->get_actual_listening_endpoint(),
+                                                   fc::milliseconds( options["latency-ms"].as<uint32_t>() ),
+                                                   options["bandwidth"].as<uint32_t>() ) );
+            emulated_link* link = links.back().get();
+            fc::ip::endpoint link_endpoint = link_thread.async( [link](){ return link->start(); } ).wait();
+            node->connect_to_endpoint( link_endpoint );
+         }
+         const fc::time_point deadline = sync_start + fc::seconds( 600 );
+         while( joining_chain->head_block_id() != target && fc::time_point::now() < deadline )
+            fc::usleep( fc::milliseconds( 10 ) );
+         const fc::microseconds sync_time = fc::time_point::now() - sync_start;
+         const uint32_t synced_blocks = graphene::chain::block_header::num_from_id( joining_chain->head_block_id() );
+         std::cout << "sync: " << synced_blocks << " of " << graphene::chain::block_header::num_from_id( target ) << " blocks from "
+                   << sources.size() << " peers in " << sync_time.count() / 1000 << " ms ("
+                   << synced_blocks * 1000000.0 / std::max<int64_t>( sync_time.count(), 1 ) << " blocks/s)\n";
+      }
+
+      for( const graphene::net::node_ptr& node : nodes )
+         node->close();
+      for( const auto& link : links )
+      {
+         emulated_link* link_to_stop = link.get();
+         link_thread.async( [link_to_stop](){ link_to_stop->stop(); } ).wait();
+      }
+      return 0;
+   } catch( const fc::exception& e ) {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+}
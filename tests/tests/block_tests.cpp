@@ -291,6 +291,86 @@ BOOST_AUTO_TEST_CASE( fork_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( fork_switch_reuses_stateless_checks )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir3( graphene::utilities::temp_directory_path() );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      db2.open(data_dir2.path(), make_genesis);
+      database db3;
+      db3.open(data_dir3.path(), make_genesis);
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      auto wrong_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("wrong_key")) );
+      for( uint32_t i = 0; i < 10; ++i )
+      {
+         auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_miner(1), init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db2, b );
+         PUSH_BLOCK( db3, b );
+      }
+      for( uint32_t i = 10; i < 13; ++i )
+         db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_miner(1), init_account_priv_key, database::skip_nothing);
+      const string db1_tip = db1.head_block_id().str();
+
+      // db3 builds a longer fork on a first block signed by the wrong key
+      auto bad = db3.generate_block(db3.get_slot_time(3), db3.get_scheduled_miner(3), init_account_priv_key, database::skip_nothing);
+      db3.pop_block();
+      bad.sign( wrong_priv_key );
+      PUSH_BLOCK( db3, bad, database::skip_miner_signature );
+      vector<signed_block> bad_fork = { bad };
+      for( uint32_t i = 11; i < 14; ++i )
+         bad_fork.push_back( db3.generate_block(db3.get_slot_time(1), db3.get_scheduled_miner(1), init_account_priv_key, database::skip_nothing) );
+
+      // the blocks up to the height of db1 wait on the shorter fork, the longer one is rejected by the recorded signer
+      for( size_t i = 0; i < 3; ++i )
+         PUSH_BLOCK( db1, bad_fork[i] );
+      BOOST_CHECK_EQUAL(db1.head_block_id().str(), db1_tip);
+      GRAPHENE_CHECK_THROW(PUSH_BLOCK( db1, bad_fork[3] ), fc::exception);
+      BOOST_CHECK_EQUAL(db1.head_block_id().str(), db1_tip);
+
+      fork_switch_statistics stats = db1.get_fork_switch_statistics();
+      BOOST_CHECK_EQUAL( stats.switches, 1u );
+      BOOST_CHECK_EQUAL( stats.failed_switches, 1u );
+      BOOST_CHECK_EQUAL( stats.blocks_popped, 3u );
+      // only the restored blocks of db1 were applied, they were checked when they were first applied
+      BOOST_CHECK_EQUAL( stats.blocks_applied, 3u );
+      BOOST_CHECK_EQUAL( stats.blocks_prechecked, 3u );
+
+      // db2 builds a valid longer fork, its blocks are checked once when they reach db1
+      uint32_t next_slot = 3;
+      vector<signed_block> good_fork;
+      for( uint32_t i = 10; i < 14; ++i )
+      {
+         good_fork.push_back( db2.generate_block(db2.get_slot_time(next_slot), db2.get_scheduled_miner(next_slot), init_account_priv_key, database::skip_nothing) );
+         next_slot = 1;
+      }
+      for( size_t i = 0; i < 3; ++i )
+         PUSH_BLOCK( db1, good_fork[i] );
+      BOOST_CHECK_EQUAL(db1.head_block_id().str(), db1_tip);
+      PUSH_BLOCK( db1, good_fork[3] );
+      BOOST_CHECK_EQUAL(db1.head_block_id().str(), db2.head_block_id().str());
+
+      stats = db1.get_fork_switch_statistics();
+      BOOST_CHECK_EQUAL( stats.switches, 2u );
+      BOOST_CHECK_EQUAL( stats.failed_switches, 1u );
+      BOOST_CHECK_EQUAL( stats.blocks_popped, 6u );
+      BOOST_CHECK_EQUAL( stats.max_blocks_popped, 3u );
+      // the new head block is the only one applied with the full checks
+      BOOST_CHECK_EQUAL( stats.blocks_applied, 7u );
+      BOOST_CHECK_EQUAL( stats.blocks_prechecked, 6u );
+      BOOST_CHECK_GT( stats.total_time, 0 );
+      BOOST_CHECK_GE( stats.total_time, stats.max_time );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 
 /**
  *  These test has been disabled, out of order blocks should result in the node getting disconnected.
@@ -312,11 +392,11 @@ BOOST_AUTO_TEST_CASE( fork_db_tests )
         prev = b;
      }
      auto head = fdb.head();
-     FC_ASSERT( head && head->data.block_num() == 1799 );
+     FC_ASSERT( head && head->num == 1799 );
 
      fdb.push_block(skipped_block);
      head = fdb.head();
-     FC_ASSERT( head && head->data.block_num() == 2001, "", ("head",head->data.block_num()) );
+     FC_ASSERT( head && head->num == 2001, "", ("head",head->num) );
   } FC_LOG_AND_RETHROW() 
 }
 BOOST_AUTO_TEST_CASE( out_of_order_blocks )
@@ -437,6 +517,130 @@ BOOST_AUTO_TEST_CASE( undo_pending )
    }
 }
 
+BOOST_AUTO_TEST_CASE( pending_transactions_survive_restart )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
+      account_id_type nathan_id;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis);
+         db.generate_block(db.get_slot_time(1), db.get_scheduled_miner(1), init_account_priv_key, database::skip_nothing);
+
+         signed_transaction trx;
+         set_expiration( db, trx );
+         nathan_id = db.get_index(protocol_ids, account_object_type).get_next_id();
+         account_create_operation cop;
+         cop.registrar = GRAPHENE_TEMP_ACCOUNT;
+         cop.name = "nathan";
+         cop.owner = authority(1, init_account_pub_key, 1);
+         cop.active = cop.owner;
+         trx.operations.push_back(cop);
+         PUSH_TX( db, trx );
+
+         BOOST_CHECK(nathan_id(db).name == "nathan");
+         db.close();
+      }
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis);
+         // the pending transaction was saved by close() and re-applied by open()
+         BOOST_CHECK(nathan_id(db).name == "nathan");
+         BOOST_CHECK( !fc::exists( data_dir.path() / GRAPHENE_PENDING_TRANSACTIONS_FILENAME ) );
+
+         db.generate_block(db.get_slot_time(1), db.get_scheduled_miner(1), init_account_priv_key, database::skip_nothing);
+         BOOST_CHECK(nathan_id(db).name == "nathan");
+         db.close();
+      }
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis);
+         // once included in a block the transaction is no longer pending, the account must not be created twice
+         BOOST_CHECK(nathan_id(db).name == "nathan");
+         BOOST_CHECK_EQUAL(db.get_index(protocol_ids, account_object_type).get_next_id().instance(), nathan_id.instance.value + 1);
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( reversible_blocks_survive_restart )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      block_id_type head_id;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis);
+         for( int i = 0; i < 3; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_miner(1), init_account_priv_key, database::skip_nothing);
+         BOOST_REQUIRE( db.get_dynamic_global_properties().last_irreversible_block_num < db.head_block_num() );
+         head_id = db.head_block_id();
+         db.close();
+         BOOST_CHECK( fc::exists( data_dir.path() / GRAPHENE_FORK_DATABASE_FILENAME ) );
+      }
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis);
+         // close() rewinds to the last irreversible block, open() pushes the saved blocks back
+         BOOST_CHECK( db.head_block_id() == head_id );
+         BOOST_CHECK( !fc::exists( data_dir.path() / GRAPHENE_FORK_DATABASE_FILENAME ) );
+         db.generate_block(db.get_slot_time(1), db.get_scheduled_miner(1), init_account_priv_key, database::skip_nothing);
+         BOOST_CHECK_EQUAL( db.head_block_num(), 4 );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( unlinked_blocks_byte_budget )
+{
+   try {
+      fork_database fdb;
+      signed_block genesis;
+      fdb.start_block( genesis );
+
+      vector<signed_block> chain;
+      signed_block prev = genesis;
+      for( int i = 0; i < 5; ++i )
+      {
+         signed_block b;
+         b.previous = prev.id();
+         chain.push_back( b );
+         prev = b;
+      }
+
+      // chain[0] is missing, the others can not link and are cached
+      for( int i = 1; i < 5; ++i )
+         GRAPHENE_REQUIRE_THROW( fdb.push_block( chain[i] ), unlinkable_block_exception );
+      BOOST_CHECK( fdb.is_known_block( chain[4].id() ) );
+      const uint64_t block_size = fc::raw::pack_size( chain[1] );
+      BOOST_CHECK_EQUAL( fdb.unlinked_bytes(), 4 * block_size );
+
+      // over budget the blocks furthest ahead are dropped first
+      fdb.set_max_unlinked_bytes( 2 * block_size );
+      BOOST_CHECK_EQUAL( fdb.unlinked_bytes(), 2 * block_size );
+      BOOST_CHECK( fdb.is_known_block( chain[2].id() ) );
+      BOOST_CHECK( !fdb.is_known_block( chain[3].id() ) );
+      BOOST_CHECK( !fdb.is_known_block( chain[4].id() ) );
+
+      fdb.push_block( chain[0] );
+      auto children = fdb.pop_unlinked_children( chain[0].id() );
+      BOOST_REQUIRE_EQUAL( children.size(), 1 );
+      BOOST_CHECK( children[0]->id == chain[1].id() );
+      BOOST_CHECK( children[0]->data->previous == chain[0].id() );
+      BOOST_CHECK_EQUAL( fdb.unlinked_bytes(), block_size );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( switch_forks_undo_create )
 {
    try {
@@ -1255,4 +1459,28 @@ BOOST_FIXTURE_TEST_CASE( miss_many_blocks, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( fetch_shared_block, database_fixture )
+{
+   try
+   {
+      generate_block();
+      const block_id_type head_id = db.head_block_id();
+
+      // reversible blocks come from the fork database without a copy
+      auto by_id = db.fetch_shared_block_by_id( head_id );
+      BOOST_REQUIRE( by_id );
+      BOOST_CHECK( by_id == db.fetch_shared_block_by_id( head_id ) );
+      BOOST_CHECK( by_id == db.fetch_shared_block_by_number( db.head_block_num() ) );
+      BOOST_CHECK( by_id->id() == db.fetch_block_by_id( head_id )->id() );
+
+      BOOST_CHECK( !db.fetch_shared_block_by_id( block_id_type() ) );
+      BOOST_CHECK( !db.fetch_shared_block_by_number( db.head_block_num() + 1 ) );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,161 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/app/database_api.hpp>
+
+#include <graphene/chain/database.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+using graphene::app::database_api;
+
+namespace {
+
+   /// the objects of every notification, the callback runs in a task of its own
+   struct notification_log
+   {
+      vector<variant> objects;
+
+      std::function<void(const variant&)> callback()
+      {
+         return [this]( const variant& updates ) {
+            for( const variant& update : updates.get_array() )
+               objects.push_back( update );
+         };
+      }
+
+      bool has_id( object_id_type id )const
+      {
+         for( const variant& object : objects )
+            if( object.is_string() && object.as<object_id_type>() == id )
+               return true;
+         return false;
+      }
+
+      bool has_balance_of( account_id_type owner )const
+      {
+         for( const variant& object : objects )
+            if( object.is_object() && object.get_object().contains( "owner" ) && object.get_object().contains( "balance" ) &&
+                object["owner"].as<account_id_type>() == owner )
+               return true;
+         return false;
+      }
+
+      void wait_for_balance_of( account_id_type owner )const
+      {
+         for( int i = 0; i < 100 && !has_balance_of( owner ); ++i )
+            fc::usleep( fc::milliseconds( 10 ) );
+      }
+
+      void wait_for_id( object_id_type id )const
+      {
+         for( int i = 0; i < 100 && !has_id( id ); ++i )
+            fc::usleep( fc::milliseconds( 10 ) );
+      }
+   };
+
+}
+
+BOOST_FIXTURE_TEST_SUITE( database_api_tests, database_fixture )
+
+BOOST_AUTO_TEST_CASE( subscribe_through_get_accounts )
+{ try {
+   ACTORS((nathan)(dan));
+   generate_block();
+
+   database_api api( db );
+   notification_log log;
+   api.set_subscribe_callback( log.callback(), false );
+   BOOST_REQUIRE_EQUAL( api.get_accounts( { nathan_id } ).size(), 1u );
+
+   // a change to an account nobody subscribed to is not reported
+   transfer( miner_account, dan_id, asset( 1000 ) );
+   generate_block();
+   fc::usleep( fc::milliseconds( 100 ) );
+   BOOST_CHECK( !log.has_balance_of( dan_id ) );
+
+   // the balance belongs to the account subscribed to with its typed id
+   transfer( miner_account, nathan_id, asset( 1000 ) );
+   generate_block();
+   log.wait_for_balance_of( nathan_id );
+   BOOST_CHECK( log.has_balance_of( nathan_id ) );
+   BOOST_CHECK( !log.has_balance_of( dan_id ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( subscribe_through_get_full_accounts )
+{ try {
+   ACTORS((nathan)(dan));
+   generate_block();
+
+   database_api api( db );
+   notification_log log;
+   api.set_subscribe_callback( log.callback(), false );
+   BOOST_REQUIRE_EQUAL( api.get_full_accounts( { "nathan" }, true ).size(), 1u );
+   // without subscribe the account is only looked up
+   BOOST_REQUIRE_EQUAL( api.get_full_accounts( { "dan" }, false ).size(), 1u );
+
+   transfer( miner_account, dan_id, asset( 1000 ) );
+   transfer( miner_account, nathan_id, asset( 1000 ) );
+   generate_block();
+   log.wait_for_balance_of( nathan_id );
+   BOOST_CHECK( log.has_balance_of( nathan_id ) );
+   BOOST_CHECK( !log.has_balance_of( dan_id ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( subscribe_without_clearing_reports_nothing_unsubscribed )
+{ try {
+   ACTORS((nathan));
+   generate_block();
+
+   // the filter of a new api is empty, keeping it subscribes to nothing
+   database_api api( db );
+   notification_log log;
+   api.set_subscribe_callback( log.callback(), false );
+   transfer( miner_account, nathan_id, asset( 1000 ) );
+   generate_block();
+   fc::usleep( fc::milliseconds( 100 ) );
+   BOOST_CHECK( log.objects.empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( removed_balance_reported_to_owner_subscribers )
+{ try {
+   ACTORS((nathan)(dan));
+   transfer( miner_account, nathan_id, asset( 1000 ) );
+   transfer( miner_account, dan_id, asset( 1000 ) );
+   generate_block();
+   // both send everything back, so their balance objects may be removed
+   transfer_operation fee_op;
+   fee_op.from = nathan_id;
+   fee_op.to = miner_account;
+   db.current_fee_schedule().set_fee( fee_op );
+   transfer( nathan_id, miner_account, asset( 1000 ) - fee_op.fee );
+   transfer( dan_id, miner_account, asset( 1000 ) - fee_op.fee );
+   generate_block();
+   BOOST_REQUIRE_EQUAL( get_balance( nathan_id, asset_id_type() ), 0 );
+   BOOST_REQUIRE_EQUAL( get_balance( dan_id, asset_id_type() ), 0 );
+
+   database_api api( db );
+   notification_log log;
+   api.set_subscribe_callback( log.callback(), false );
+   BOOST_REQUIRE_EQUAL( api.get_accounts( { nathan_id } ).size(), 1u );
+
+   const auto& balances_by_owner = db.get_index_type<account_balance_index>().indices().get<by_owner>();
+   const object_id_type nathan_balance = balances_by_owner.find( nathan_id )->id;
+   const object_id_type dan_balance = balances_by_owner.find( dan_id )->id;
+   db.debug_update( fc::mutable_variant_object( "id", nathan_balance ) );
+   db.debug_update( fc::mutable_variant_object( "id", dan_balance ) );
+   BOOST_REQUIRE( db.find_object( nathan_balance ) == nullptr );
+   BOOST_REQUIRE( db.find_object( dan_balance ) == nullptr );
+
+   // the removed balance only names its id, its owner is found from the last value of the object
+   log.wait_for_id( nathan_balance );
+   BOOST_CHECK( log.has_id( nathan_balance ) );
+   BOOST_CHECK( !log.has_id( dan_balance ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -434,6 +434,166 @@ BOOST_AUTO_TEST_CASE( miner_create )
    BOOST_CHECK_GE( produced, 1 );
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( incremental_vote_tally )
+{ try {
+   db.set_vote_tally_audit( true );
+   ACTORS((nathan)(dan));
+   miner_id_type nathan_miner_id = create_miner(nathan_id, nathan_private_key).id;
+   transfer(miner_account, nathan_id, asset(10000000));
+   transfer(miner_account, dan_id, asset(5000000));
+   // the first maintenance after open builds the tally from scratch
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
+   set_expiration( db, trx );
+
+   auto set_voting_account = [&]( account_id_type account, account_id_type voting_account, const fc::ecc::private_key& key ) {
+      account_update_operation op;
+      op.account = account;
+      op.new_options = account(db).options;
+      op.new_options->voting_account = voting_account;
+      trx.operations.push_back(op);
+      sign( trx, key );
+      PUSH_TX( db, trx );
+      trx.clear();
+   };
+
+   {
+      account_update_operation op;
+      op.account = nathan_id;
+      op.new_options = nathan_id(db).options;
+      op.new_options->votes.insert(nathan_miner_id(db).vote_id);
+      op.new_options->num_miner = 1;
+      trx.operations.push_back(op);
+      sign( trx, nathan_private_key );
+      PUSH_TX( db, trx );
+      trx.clear();
+   }
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
+   const uint64_t nathan_votes = nathan_miner_id(db).total_votes;
+   BOOST_CHECK_GT( nathan_votes, 0u );
+
+   // dan follows nathan, his stake is added to nathan's miner
+   set_voting_account( dan_id, nathan_id, dan_private_key );
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
+   BOOST_CHECK_GT( nathan_miner_id(db).total_votes, nathan_votes );
+
+   // balance changes of a proxied voter are picked up as well
+   transfer(dan_id, nathan_id, asset(1000000));
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
+   const uint64_t combined_votes = nathan_miner_id(db).total_votes;
+
+   // dan stops following nathan, only nathan's own stake is left
+   set_voting_account( dan_id, GRAPHENE_PROXY_TO_SELF_ACCOUNT, dan_private_key );
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
+   BOOST_CHECK_GE( nathan_miner_id(db).total_votes, nathan_votes + 1000000 );
+   BOOST_CHECK_LT( nathan_miner_id(db).total_votes, combined_votes );
+
+   BOOST_CHECK_EQUAL( db.vote_tally_audit_failures(), 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( vote_tally_after_popped_maintenance )
+{ try {
+   db.set_vote_tally_audit( true );
+   ACTORS((nathan)(dan));
+   miner_id_type nathan_miner_id = create_miner(nathan_id, nathan_private_key).id;
+   transfer(miner_account, nathan_id, asset(10000000));
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
+   set_expiration( db, trx );
+
+   account_update_operation op;
+   op.account = nathan_id;
+   op.new_options = nathan_id(db).options;
+   op.new_options->votes.insert(nathan_miner_id(db).vote_id);
+   op.new_options->num_miner = 1;
+   trx.operations.push_back(op);
+   sign( trx, nathan_private_key );
+   PUSH_TX( db, trx );
+   trx.clear();
+
+   // apply the maintenance block which counts nathan's vote, then undo it
+   const fc::time_point_sec maintenance_time = db.get_dynamic_global_properties().next_maintenance_time;
+   generate_blocks(maintenance_time);
+   const uint64_t nathan_votes = nathan_miner_id(db).total_votes;
+   BOOST_CHECK_GT( nathan_votes, 0u );
+   db.pop_block();
+   BOOST_CHECK( db.get_dynamic_global_properties().next_maintenance_time == maintenance_time );
+
+   // nathan's stake changes before the maintenance is applied again
+   transfer(nathan_id, dan_id, asset(1000000));
+   generate_blocks(maintenance_time);
+   BOOST_CHECK_LE( nathan_miner_id(db).total_votes, nathan_votes - 1000000 );
+   BOOST_CHECK_EQUAL( db.vote_tally_audit_failures(), 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( sharded_vote_recount )
+{ try {
+   db.set_maintenance_threads( 4 );
+   db.set_vote_tally_audit( true );
+   ACTORS((nathan)(dan)(sam)(izzy)(jill)(bob));
+   miner_id_type nathan_miner_id = create_miner(nathan_id, nathan_private_key).id;
+   generate_block();
+   set_expiration( db, trx );
+
+   const std::vector<std::pair<account_id_type, fc::ecc::private_key>> voters = {
+      { dan_id, dan_private_key }, { sam_id, sam_private_key }, { izzy_id, izzy_private_key },
+      { jill_id, jill_private_key }, { bob_id, bob_private_key } };
+   int64_t amount = 1000000;
+   for( const auto& voter : voters )
+   {
+      transfer(miner_account, voter.first, asset(amount));
+      amount += 1000000;
+
+      account_update_operation op;
+      op.account = voter.first;
+      op.new_options = voter.first(db).options;
+      op.new_options->votes.insert(nathan_miner_id(db).vote_id);
+      op.new_options->num_miner = 1;
+      trx.operations.push_back(op);
+      sign( trx, voter.second );
+      PUSH_TX( db, trx );
+      trx.clear();
+   }
+
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
+
+   int64_t expected = 0;
+   for( const auto& voter : voters )
+      expected += get_balance(voter.first, asset_id_type());
+   BOOST_CHECK_EQUAL( nathan_miner_id(db).total_votes, uint64_t(expected) );
+   BOOST_CHECK_EQUAL( db.vote_tally_audit_failures(), 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( real_supply_tracking )
+{ try {
+   db.set_real_supply_audit( true );
+   auto check_supply = [&]() {
+      real_supply tracked = db.get_real_supply();
+      real_supply scanned = db.scan_real_supply();
+      BOOST_CHECK_EQUAL( tracked.account_balances.value, scanned.account_balances.value );
+      BOOST_CHECK_EQUAL( tracked.vesting_balances.value, scanned.vesting_balances.value );
+   };
+
+   ACTORS((nathan)(dan));
+   check_supply();
+   transfer(miner_account, nathan_id, asset(10000000));
+   transfer(nathan_id, dan_id, asset(2500000));
+   generate_block();
+   check_supply();
+
+   // undo of a block restores the balances it changed
+   transfer(nathan_id, dan_id, asset(1000));
+   generate_block();
+   check_supply();
+   db.pop_block();
+   check_supply();
+
+   // miner pay goes to vesting balances
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
+   generate_blocks(10);
+   check_supply();
+   BOOST_CHECK_EQUAL( db.real_supply_audit_failures(), 0u );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( assert_op_test )
 {
    try {
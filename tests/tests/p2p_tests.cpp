@@ -0,0 +1,610 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/aead_channel.hpp>
+#include <graphene/net/compact_blocks.hpp>
+#include <graphene/net/config.hpp>
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/message_cache.hpp>
+#include <graphene/net/message_compression.hpp>
+#include <graphene/net/message_oriented_connection.hpp>
+#include <graphene/net/slow_requests.hpp>
+#include <graphene/net/stcp_socket.hpp>
+#include <graphene/net/sync_headers.hpp>
+
+#include <fc/network/tcp_socket.hpp>
+#include <fc/smart_ref_impl.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <cstring>
+#include <set>
+#include <unordered_set>
+
+using namespace graphene::chain;
+using namespace graphene::net;
+using graphene::net::detail::aead_channel;
+
+namespace {
+
+   signed_transaction make_transaction( uint32_t n )
+   {
+      signed_transaction trx;
+      trx.set_expiration( fc::time_point_sec( 1000000 + n ) );
+      trx.operations.push_back( transfer_operation() );
+      return trx;
+   }
+
+   message cache_transaction( blockchain_tied_message_cache& cache, uint32_t n )
+   {
+      signed_transaction trx = make_transaction( n );
+      message msg = trx_message( trx );
+      cache.cache_message( msg, msg.id(), message_propagation_data(), trx.id() );
+      return msg;
+   }
+
+   message cache_block( blockchain_tied_message_cache& cache, uint32_t n )
+   {
+      // many identical transactions make a body that compresses well
+      signed_block block;
+      block.timestamp = fc::time_point_sec( 1000000 + n );
+      block.transactions.assign( 100, processed_transaction( make_transaction( 0 ) ) );
+      message msg = block_message( block );
+      cache.cache_message( msg, msg.id(), message_propagation_data(), block.id() );
+      return msg;
+   }
+
+   std::vector<char> make_plaintext( uint32_t len )
+   {
+      std::vector<char> plaintext( len );
+      for( uint32_t i = 0; i < len; ++i )
+         plaintext[i] = char( i * 7 + 3 );
+      return plaintext;
+   }
+
+   /// the whole record for plaintext, with a spare byte so that a wrong length never reads past it
+   std::vector<char> seal_record( aead_channel& sender, const std::vector<char>& plaintext )
+   {
+      std::vector<char> record( aead_channel::record_header_size + plaintext.size() + aead_channel::tag_size + 1 );
+      sender.seal( plaintext.data(), plaintext.size(), record.data() );
+      return record;
+   }
+
+   struct collecting_delegate : public message_oriented_connection_delegate
+   {
+      std::vector<message> messages;
+
+      virtual void on_message( message_oriented_connection*, const message& received_message ) override
+      {
+         messages.push_back( received_message );
+      }
+      virtual void on_connection_closed( message_oriented_connection* ) override {}
+   };
+
+   /// count linked headers following the block previous, seed tells forks apart
+   std::vector<signed_block_header> make_headers( const item_hash_t& previous, uint32_t count, uint32_t seed = 0 )
+   {
+      std::vector<signed_block_header> headers;
+      item_hash_t previous_id = previous;
+      for( uint32_t i = 0; i < count; ++i )
+      {
+         signed_block_header header;
+         header.previous = previous_id;
+         header.timestamp = fc::time_point_sec( 1000000 + seed * 100000 + block_header::num_from_id( previous_id ) );
+         headers.push_back( header );
+         previous_id = header.id();
+      }
+      return headers;
+   }
+
+   std::vector<item_hash_t> ids_of( const std::vector<signed_block_header>& headers, size_t first = 0, size_t count = ~size_t(0) )
+   {
+      std::vector<item_hash_t> ids;
+      for( size_t i = first; i < headers.size() && ids.size() < count; ++i )
+         ids.push_back( headers[i].id() );
+      return ids;
+   }
+
+   std::vector<signed_block_header> slice( const std::vector<signed_block_header>& headers, size_t first, size_t count )
+   {
+      return std::vector<signed_block_header>( headers.begin() + first, headers.begin() + first + count );
+   }
+
+   /// a block of count distinct transactions, each with an operation result
+   signed_block make_block( uint32_t count )
+   {
+      signed_block block;
+      block.timestamp = fc::time_point_sec( 1000000 );
+      for( uint32_t i = 0; i < count; ++i )
+      {
+         block.transactions.push_back( processed_transaction( make_transaction( i ) ) );
+         block.transactions.back().operation_results.push_back( void_result() );
+      }
+      return block;
+   }
+
+   /// finds the transactions of the cache, as the node does
+   std::function<fc::optional<signed_transaction>( uint64_t )> finder( const blockchain_tied_message_cache& cache )
+   {
+      return [&cache]( uint64_t short_id ) { return cache.find_transaction( short_id ); };
+   }
+
+}
+
+BOOST_AUTO_TEST_SUITE( p2p_tests )
+
+BOOST_AUTO_TEST_CASE( message_cache_evicts_oldest_to_budget )
+{
+   blockchain_tied_message_cache cache;
+   std::vector<message> messages;
+   messages.push_back( cache_transaction( cache, 0 ) );
+   const size_t message_size = cache.size_in_bytes();
+   BOOST_REQUIRE( message_size > 0 );
+
+   cache.set_max_size_in_bytes( 3 * message_size );
+   for( uint32_t i = 1; i < 5; ++i )
+      messages.push_back( cache_transaction( cache, i ) );
+
+   BOOST_CHECK_EQUAL( cache.size(), 3 );
+   BOOST_CHECK( cache.size_in_bytes() <= cache.get_max_size_in_bytes() );
+   BOOST_CHECK( !cache.contains( messages[0].id() ) );
+   BOOST_CHECK( !cache.contains( messages[1].id() ) );
+   for( size_t i = 2; i < messages.size(); ++i )
+      BOOST_CHECK( cache.contains( messages[i].id() ) );
+   BOOST_CHECK_EQUAL( cache.get_statistics()["messages_evicted"].as_uint64(), 2 );
+
+   // shrinking the budget evicts right away, but the newest message is always kept
+   cache.set_max_size_in_bytes( 1 );
+   BOOST_CHECK_EQUAL( cache.size(), 1 );
+   BOOST_CHECK( cache.contains( messages.back().id() ) );
+}
+
+BOOST_AUTO_TEST_CASE( message_cache_compressed_copy_stays_within_budget )
+{
+   blockchain_tied_message_cache cache;
+   message first = cache_block( cache, 0 );
+   message second = cache_block( cache, 1 );
+   cache.set_max_size_in_bytes( cache.size_in_bytes() );
+   BOOST_REQUIRE_EQUAL( cache.size(), 2 );
+
+   // the compressed copy of the oldest message pushes the cache over its budget
+   serialized_message_ptr compressed = cache.get_serialized_message( first.id(), nullptr, 1 );
+   BOOST_REQUIRE( compressed );
+   BOOST_CHECK( is_compressed_message( compressed ) );
+   BOOST_CHECK( cache.size_in_bytes() <= cache.get_max_size_in_bytes() );
+   BOOST_CHECK( !cache.contains( first.id() ) );
+   BOOST_CHECK( cache.contains( second.id() ) );
+
+   // the returned copy outlives its eviction and still decompresses to the original
+   message restored = decompress_message( deserialize_message( compressed ) );
+   BOOST_CHECK( restored.id() == first.id() );
+}
+
+BOOST_AUTO_TEST_CASE( aead_record_round_trip )
+{
+   const std::vector<std::string> algorithms = stcp_socket::get_supported_aead_algorithms();
+   BOOST_REQUIRE( !algorithms.empty() );
+   const fc::sha256 key = fc::sha256::hash( std::string( "transport key" ) );
+   for( const std::string& algorithm : algorithms )
+   {
+      BOOST_TEST_MESSAGE( "Checking " + algorithm );
+      aead_channel sender( algorithm, key, true );
+      aead_channel receiver( algorithm, key, false );
+      for( uint32_t len : { 1u, 100u, uint32_t( GRAPHENE_NET_AEAD_MAX_RECORD_SIZE ) } )
+      {
+         const std::vector<char> plaintext = make_plaintext( len );
+         std::vector<char> record = seal_record( sender, plaintext );
+         BOOST_CHECK_EQUAL( aead_channel::record_size( record.data() ), len );
+         if( len >= 100 )
+            BOOST_CHECK( memcmp( record.data() + aead_channel::record_header_size, plaintext.data(), len ) != 0 );
+
+         std::vector<char> opened( len );
+         receiver.open( len, record.data() + aead_channel::record_header_size, opened.data() );
+         BOOST_CHECK( opened == plaintext );
+      }
+   }
+
+   // each direction and each algorithm gets its own key
+   const fc::sha512 secret = fc::sha512::hash( std::string( "shared secret" ) );
+   const fc::ecc::public_key_data first = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "first" ) ) ).get_public_key().serialize();
+   const fc::ecc::public_key_data second = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "second" ) ) ).get_public_key().serialize();
+   BOOST_CHECK( graphene::net::detail::derive_aead_key( secret, first, algorithms.front() ) != graphene::net::detail::derive_aead_key( secret, second, algorithms.front() ) );
+   BOOST_CHECK( graphene::net::detail::derive_aead_key( secret, first, "aes-256-gcm" ) != graphene::net::detail::derive_aead_key( secret, first, "chacha20-poly1305" ) );
+}
+
+BOOST_AUTO_TEST_CASE( aead_record_rejects_tampering )
+{
+   const fc::sha256 key = fc::sha256::hash( std::string( "transport key" ) );
+   const std::vector<char> plaintext = make_plaintext( 100 );
+   const size_t body_offset = aead_channel::record_header_size;
+   for( const std::string& algorithm : stcp_socket::get_supported_aead_algorithms() )
+   {
+      BOOST_TEST_MESSAGE( "Checking " + algorithm );
+      std::vector<char> opened( plaintext.size() );
+      {
+         aead_channel sender( algorithm, key, true );
+         aead_channel receiver( algorithm, key, false );
+         std::vector<char> record = seal_record( sender, plaintext );
+         record[body_offset + plaintext.size()] ^= 1;
+         BOOST_CHECK_THROW( receiver.open( plaintext.size(), record.data() + body_offset, opened.data() ), fc::exception );
+      }
+      {
+         aead_channel sender( algorithm, key, true );
+         aead_channel receiver( algorithm, key, false );
+         std::vector<char> record = seal_record( sender, plaintext );
+         record[body_offset + 10] ^= 1;
+         BOOST_CHECK_THROW( receiver.open( plaintext.size(), record.data() + body_offset, opened.data() ), fc::exception );
+      }
+      {
+         // the length is authenticated, a shortened record does not open
+         aead_channel sender( algorithm, key, true );
+         aead_channel receiver( algorithm, key, false );
+         std::vector<char> record = seal_record( sender, plaintext );
+         const uint32_t shortened = plaintext.size() - 1;
+         memcpy( record.data(), &shortened, sizeof(shortened) );
+         const uint32_t len = aead_channel::record_size( record.data() );
+         BOOST_CHECK_THROW( receiver.open( len, record.data() + body_offset, opened.data() ), fc::exception );
+      }
+      {
+         // every record has its own nonce, a replayed record does not open again
+         aead_channel sender( algorithm, key, true );
+         aead_channel receiver( algorithm, key, false );
+         std::vector<char> record = seal_record( sender, plaintext );
+         receiver.open( plaintext.size(), record.data() + body_offset, opened.data() );
+         BOOST_CHECK( opened == plaintext );
+         BOOST_CHECK_THROW( receiver.open( plaintext.size(), record.data() + body_offset, opened.data() ), fc::exception );
+      }
+      {
+         aead_channel sender( algorithm, key, true );
+         aead_channel receiver( algorithm, fc::sha256::hash( std::string( "other key" ) ), false );
+         std::vector<char> record = seal_record( sender, plaintext );
+         BOOST_CHECK_THROW( receiver.open( plaintext.size(), record.data() + body_offset, opened.data() ), fc::exception );
+      }
+   }
+}
+
+BOOST_AUTO_TEST_CASE( aead_record_size_is_bounded )
+{
+   char header[aead_channel::record_header_size];
+   for( uint32_t size : { 0u, uint32_t( GRAPHENE_NET_AEAD_MAX_RECORD_SIZE + 1 ), 0xffffffffu } )
+   {
+      memcpy( header, &size, sizeof(size) );
+      BOOST_CHECK_THROW( aead_channel::record_size( header ), fc::exception );
+   }
+   const uint32_t largest = GRAPHENE_NET_AEAD_MAX_RECORD_SIZE;
+   memcpy( header, &largest, sizeof(largest) );
+   BOOST_CHECK_EQUAL( aead_channel::record_size( header ), largest );
+}
+
+BOOST_AUTO_TEST_CASE( aead_transport_switches_mid_stream )
+{
+   for( const std::string& algorithm : stcp_socket::get_supported_aead_algorithms() )
+   {
+      BOOST_TEST_MESSAGE( "Checking " + algorithm );
+      fc::tcp_server server;
+      server.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+
+      collecting_delegate server_delegate;
+      collecting_delegate client_delegate;
+      message_oriented_connection server_connection( &server_delegate );
+      message_oriented_connection client_connection( &client_delegate );
+      fc::future<void> accepted = fc::async( [&]() {
+         server.accept( server_connection.get_socket() );
+         server_connection.accept();
+      }, "accept test connection" );
+      client_connection.connect_to( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), server.get_port() ) );
+      accepted.wait();
+
+      message before = trx_message( make_transaction( 0 ) );
+      // a message larger than one record is split over several
+      signed_block block;
+      block.transactions.assign( 5000, processed_transaction( make_transaction( 1 ) ) );
+      message after = block_message( block );
+      BOOST_REQUIRE( after.size > GRAPHENE_NET_AEAD_MAX_RECORD_SIZE );
+
+      client_connection.send_message( before );
+      client_connection.send_message( message( transport_upgrade_message( algorithm ) ) );
+      client_connection.send_message( after );
+      BOOST_CHECK_EQUAL( client_connection.get_transport_ciphers()["send"].as_string(), algorithm );
+
+      for( int i = 0; i < 200 && server_delegate.messages.size() < 2; ++i )
+         fc::usleep( fc::milliseconds( 10 ) );
+      // the upgrade message itself is consumed by the connection
+      BOOST_REQUIRE_EQUAL( server_delegate.messages.size(), 2 );
+      BOOST_CHECK( server_delegate.messages[0].id() == before.id() );
+      BOOST_CHECK( server_delegate.messages[1].id() == after.id() );
+      BOOST_CHECK_EQUAL( server_connection.get_transport_ciphers()["receive"].as_string(), algorithm );
+      // the other direction keeps the aes stream until it is upgraded as well
+      BOOST_CHECK_EQUAL( server_connection.get_transport_ciphers()["send"].as_string(), "aes-256-cbc-stream" );
+
+      client_connection.destroy_connection();
+      server_connection.destroy_connection();
+   }
+}
+
+BOOST_AUTO_TEST_CASE( sync_headers_reject_invalid_batches )
+{
+   std::vector<signed_block_header> chain = make_headers( item_hash_t(), 6 );
+   std::vector<signed_block_header> fork = make_headers( item_hash_t(), 6, 1 );
+   sync_header_chain sync_headers;
+
+   // more headers than requested
+   BOOST_CHECK_THROW( sync_headers.accept_headers( ids_of( chain, 0, 2 ), item_hash_t(), slice( chain, 0, 3 ) ), fc::exception );
+   // headers of other blocks than the ones requested
+   BOOST_CHECK_THROW( sync_headers.accept_headers( ids_of( fork, 0, 3 ), item_hash_t(), slice( chain, 0, 3 ) ), fc::exception );
+   // the first header doesn't link to the block before the range
+   BOOST_CHECK_THROW( sync_headers.accept_headers( ids_of( chain, 2, 2 ), chain[0].id(), slice( chain, 2, 2 ) ), fc::exception );
+   // a header in the middle doesn't link to the one before it
+   std::vector<item_hash_t> mixed_ids = { chain[0].id(), fork[1].id() };
+   std::vector<signed_block_header> mixed = { chain[0], fork[1] };
+   BOOST_CHECK_THROW( sync_headers.accept_headers( mixed_ids, item_hash_t(), mixed ), fc::exception );
+   // a header contradicting a checkpoint
+   sync_headers.add_checkpoints( { { 3, fork[2].id() } } );
+   BOOST_CHECK( sync_headers.contradicts_checkpoint( chain[2].id() ) );
+   BOOST_CHECK( !sync_headers.contradicts_checkpoint( fork[2].id() ) );
+   BOOST_CHECK_THROW( sync_headers.accept_headers( ids_of( chain, 0, 4 ), item_hash_t(), slice( chain, 0, 4 ) ), fc::exception );
+
+   // nothing of a rejected batch is kept, not even the headers before the bad one
+   BOOST_CHECK_EQUAL( sync_headers.size(), 0u );
+   BOOST_CHECK( !sync_headers.has_header( chain[0].id() ) );
+
+   // a peer may send fewer headers than requested
+   BOOST_CHECK_EQUAL( sync_headers.accept_headers( ids_of( fork ), item_hash_t(), slice( fork, 0, 4 ) ), 4u );
+   BOOST_CHECK( sync_headers.has_header( fork[3].id() ) );
+   BOOST_CHECK( !sync_headers.has_header( fork[4].id() ) );
+   BOOST_CHECK_EQUAL( sync_headers.accept_headers( ids_of( fork, 4 ), fork[3].id(), slice( fork, 4, 2 ) ), 2u );
+   BOOST_CHECK_EQUAL( sync_headers.size(), 6u );
+}
+
+BOOST_AUTO_TEST_CASE( sync_headers_pin_blocks_below_last_checkpoint )
+{
+   std::vector<signed_block_header> chain = make_headers( item_hash_t(), 10 );
+   auto have_no_block = []( const item_hash_t& ) { return false; };
+   {
+      sync_header_chain sync_headers;
+      sync_headers.add_checkpoints( { { 4, chain[3].id() }, { 8, chain[7].id() } } );
+      BOOST_CHECK_EQUAL( sync_headers.last_checkpoint_block_num(), 8u );
+
+      // a gap at block 5 separates the last checkpoint from the start of the chain
+      sync_headers.accept_headers( ids_of( chain, 0, 4 ), item_hash_t(), slice( chain, 0, 4 ) );
+      sync_headers.accept_headers( ids_of( chain, 5 ), chain[4].id(), slice( chain, 5, 5 ) );
+      BOOST_CHECK( !sync_headers.reached_last_checkpoint( 0, have_no_block ) );
+      for( uint32_t i = 0; i < 8; ++i )
+         BOOST_CHECK( !sync_headers.is_accepted( chain[i].id() ) );
+      // past the last checkpoint the chain checks the blocks, but they are applied after the ones before anyway
+      BOOST_CHECK( sync_headers.is_accepted( chain[8].id() ) );
+
+      sync_headers.accept_headers( ids_of( chain, 4, 1 ), chain[3].id(), slice( chain, 4, 1 ) );
+      BOOST_CHECK( sync_headers.reached_last_checkpoint( 0, have_no_block ) );
+      for( uint32_t i = 0; i < 10; ++i )
+         BOOST_CHECK( sync_headers.is_accepted( chain[i].id() ) );
+
+      // headers of a fork below the checkpoint are checked, but its blocks are never fetched
+      std::vector<signed_block_header> fork = make_headers( chain[4].id(), 2, 1 );
+      sync_headers.accept_headers( ids_of( fork ), chain[4].id(), fork );
+      BOOST_CHECK( sync_headers.has_header( fork[0].id() ) );
+      BOOST_CHECK( !sync_headers.is_accepted( fork[0].id() ) );
+
+      // once received, a block is forgotten
+      sync_headers.forget( chain[0].id() );
+      BOOST_CHECK( !sync_headers.has_header( chain[0].id() ) );
+
+      // the walk starts over after a clear
+      sync_headers.clear();
+      BOOST_CHECK_EQUAL( sync_headers.size(), 0u );
+      BOOST_CHECK( !sync_headers.reached_last_checkpoint( 0, have_no_block ) );
+   }
+   {
+      // the walk ends at a block we have, and only asks about blocks up to our head
+      sync_header_chain sync_headers;
+      sync_headers.add_checkpoints( { { 8, chain[7].id() } } );
+      std::set<item_hash_t> asked;
+      auto have_first_three = [&]( const item_hash_t& block_id ) {
+         asked.insert( block_id );
+         return block_header::num_from_id( block_id ) <= 3;
+      };
+      sync_headers.accept_headers( ids_of( chain, 3, 5 ), chain[2].id(), slice( chain, 3, 5 ) );
+      BOOST_CHECK( sync_headers.reached_last_checkpoint( 3, have_first_three ) );
+      BOOST_CHECK_EQUAL( asked.size(), 1u );
+      BOOST_CHECK( asked.count( chain[2].id() ) );
+      BOOST_CHECK( sync_headers.is_accepted( chain[3].id() ) );
+   }
+   {
+      // without checkpoints every accepted header may be fetched
+      sync_header_chain sync_headers;
+      sync_headers.add_checkpoints( { { 5, item_hash_t() } } );
+      BOOST_CHECK_EQUAL( sync_headers.last_checkpoint_block_num(), 0u );
+      sync_headers.accept_headers( ids_of( chain, 0, 3 ), item_hash_t(), slice( chain, 0, 3 ) );
+      BOOST_CHECK( sync_headers.reached_last_checkpoint( 0, have_no_block ) );
+      BOOST_CHECK( sync_headers.is_accepted( chain[2].id() ) );
+   }
+}
+
+BOOST_AUTO_TEST_CASE( compact_block_rebuilt_from_cached_transactions )
+{
+   signed_block block = make_block( 5 );
+   message full_block = block_message( block );
+   blockchain_tied_message_cache cache;
+   for( uint32_t i = 0; i < 5; ++i )
+      cache_transaction( cache, i );
+
+   compact_block_message compact_block( block, full_block.id() );
+   BOOST_CHECK_LT( message( compact_block ).size, full_block.size );
+
+   compact_block_reconstruction partial_block( compact_block, finder( cache ) );
+   BOOST_CHECK( partial_block.missing_indexes().empty() );
+   message rebuilt = partial_block.rebuild();
+   BOOST_CHECK( rebuilt.id() == full_block.id() );
+   BOOST_CHECK( rebuilt.as<block_message>().block.id() == block.id() );
+}
+
+BOOST_AUTO_TEST_CASE( compact_block_missing_transactions_round_trip )
+{
+   signed_block block = make_block( 6 );
+   message full_block = block_message( block );
+   blockchain_tied_message_cache cache;
+   for( uint32_t i : { 0, 2, 3 } )
+      cache_transaction( cache, i );
+
+   compact_block_reconstruction partial_block( compact_block_message( block, full_block.id() ), finder( cache ) );
+   BOOST_REQUIRE( partial_block.missing_indexes() == std::vector<uint32_t>( { 1, 4, 5 } ) );
+   BOOST_CHECK_THROW( partial_block.rebuild(), fc::exception );
+
+   // the peer which sent the compact block answers with exactly the missing transactions
+   fetch_compact_block_transactions_message request( block.id(), partial_block.missing_indexes() );
+   compact_block_transactions_message reply = answer_compact_block_transactions_request( block, request, MAX_MESSAGE_SIZE );
+   BOOST_REQUIRE_EQUAL( reply.transactions.size(), 3u );
+   BOOST_CHECK( reply.transactions[1].id() == block.transactions[4].id() );
+
+   // a short reply is rejected without filling anything in
+   compact_block_transactions_message short_reply = reply;
+   short_reply.transactions.pop_back();
+   BOOST_CHECK_THROW( partial_block.add_missing_transactions( short_reply ), fc::exception );
+   BOOST_CHECK_EQUAL( partial_block.missing_indexes().size(), 3u );
+
+   partial_block.add_missing_transactions( reply );
+   BOOST_CHECK( partial_block.missing_indexes().empty() );
+   BOOST_CHECK( partial_block.rebuild().id() == full_block.id() );
+}
+
+BOOST_AUTO_TEST_CASE( compact_block_mismatch_is_not_rebuilt )
+{
+   signed_block block = make_block( 4 );
+   message full_block = block_message( block );
+   compact_block_message compact_block( block, full_block.id() );
+
+   // a transaction we hold shares the short id of one in the block
+   const uint64_t colliding_short_id = compact_block.transactions[2].short_id;
+   auto find_colliding = [&]( uint64_t short_id ) -> fc::optional<signed_transaction> {
+      if( short_id == colliding_short_id )
+         return signed_transaction( make_transaction( 100 ) );
+      for( const processed_transaction& trx : block.transactions )
+         if( compact_transaction_short_id( trx.id() ) == short_id )
+            return signed_transaction( trx );
+      return fc::optional<signed_transaction>();
+   };
+   compact_block_reconstruction partial_block( compact_block, find_colliding );
+   BOOST_CHECK( partial_block.missing_indexes().empty() );
+   // the node fetches the full block instead
+   BOOST_CHECK_THROW( partial_block.rebuild(), fc::exception );
+
+   // so does a different operation result
+   compact_block.transactions[0].operation_results.clear();
+   BOOST_CHECK_THROW( compact_block_reconstruction( compact_block, find_colliding ).rebuild(), fc::exception );
+}
+
+BOOST_AUTO_TEST_CASE( compact_block_transactions_request_checks_indexes )
+{
+   signed_block block = make_block( 3 );
+   auto request = [&]( const std::vector<uint32_t>& indexes ) {
+      return fetch_compact_block_transactions_message( block.id(), indexes );
+   };
+
+   BOOST_CHECK_EQUAL( answer_compact_block_transactions_request( block, request( { 0, 2 } ), MAX_MESSAGE_SIZE ).transactions.size(), 2u );
+   BOOST_CHECK( answer_compact_block_transactions_request( block, request( {} ), MAX_MESSAGE_SIZE ).transactions.empty() );
+   BOOST_CHECK_THROW( answer_compact_block_transactions_request( block, request( { 1, 1 } ), MAX_MESSAGE_SIZE ), fc::exception );
+   BOOST_CHECK_THROW( answer_compact_block_transactions_request( block, request( { 2, 0 } ), MAX_MESSAGE_SIZE ), fc::exception );
+   BOOST_CHECK_THROW( answer_compact_block_transactions_request( block, request( { 3 } ), MAX_MESSAGE_SIZE ), fc::exception );
+   BOOST_CHECK_THROW( answer_compact_block_transactions_request( block, request( { 0, 1, 2, 2 } ), MAX_MESSAGE_SIZE ), fc::exception );
+
+   // a reply which doesn't fit in a message is left empty, the peer fetches the full block then
+   compact_block_transactions_message all = answer_compact_block_transactions_request( block, request( { 0, 1, 2 } ), MAX_MESSAGE_SIZE );
+   const size_t reply_size = message( all ).size;
+   BOOST_CHECK_EQUAL( answer_compact_block_transactions_request( block, request( { 0, 1, 2 } ), reply_size + 4 ).transactions.size(), 3u );
+   BOOST_CHECK( answer_compact_block_transactions_request( block, request( { 0, 1, 2 } ), reply_size - 1 ).transactions.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( slow_sync_requests_move_to_faster_peer )
+{
+   const std::vector<item_hash_t> blocks = ids_of( make_headers( item_hash_t(), 4 ) );
+   auto sync_item = [&]( size_t i ) { return item_id( block_message_type, blocks[i] ); };
+   const fc::time_point start = fc::time_point::now();
+   const fc::microseconds allowed_latency = fc::seconds( 3 );
+
+   // the slow peer was asked for every block, the faster one offers all but the last
+   handed_over_requests::item_to_time_map_type slow_peer_requests;
+   for( size_t i = 0; i < blocks.size(); ++i )
+      slow_peer_requests[sync_item( i )] = start;
+   const std::set<item_hash_t> offered_by_fast_peer( blocks.begin(), blocks.end() - 1 );
+   handed_over_requests::item_to_time_map_type fast_peer_requests;
+   auto fast_peer_can_take_over = [&]( const item_id& item ) {
+      return offered_by_fast_peer.count( item.item_hash ) && !fast_peer_requests.count( item );
+   };
+
+   handed_over_requests reassigned;
+   // nothing is handed over before the peer had its time
+   BOOST_CHECK( reassigned.hand_over_slow_requests( slow_peer_requests, start + allowed_latency, allowed_latency, fast_peer_can_take_over ).empty() );
+   BOOST_CHECK_EQUAL( slow_peer_requests.size(), 4u );
+
+   // the blocks the faster peer offers move to it, the last one stays with the slow peer
+   std::vector<item_id> moved = reassigned.hand_over_slow_requests( slow_peer_requests, start + fc::seconds( 4 ), allowed_latency,
+                                                                    fast_peer_can_take_over );
+   BOOST_REQUIRE_EQUAL( moved.size(), 3u );
+   for( const item_id& item : moved )
+      fast_peer_requests[item] = start + fc::seconds( 4 );
+   BOOST_CHECK_EQUAL( slow_peer_requests.size(), 1u );
+   BOOST_CHECK( slow_peer_requests.count( sync_item( 3 ) ) );
+   BOOST_CHECK_EQUAL( reassigned.size(), 3u );
+   BOOST_CHECK( reassigned.contains( sync_item( 0 ) ) );
+   BOOST_CHECK( !reassigned.contains( sync_item( 3 ) ) );
+   BOOST_CHECK( reassigned.hand_over_slow_requests( slow_peer_requests, start + fc::seconds( 8 ), allowed_latency,
+                                                    fast_peer_can_take_over ).empty() );
+
+   // a late block from the slow peer is one we asked it for, unlike a block it was never asked for
+   BOOST_CHECK( reassigned.remove( sync_item( 1 ) ) );
+   BOOST_CHECK( !reassigned.remove( sync_item( 1 ) ) );
+   BOOST_CHECK( !reassigned.remove( item_id( block_message_type, make_headers( item_hash_t(), 1, 1 ).front().id() ) ) );
+
+   // the blocks it never sends still time out
+   BOOST_CHECK( !reassigned.find_requested_before( start ) );
+   fc::optional<item_id> ignored = reassigned.find_requested_before( start + fc::seconds( 6 ) );
+   BOOST_REQUIRE( ignored.valid() );
+   BOOST_CHECK( *ignored == sync_item( 0 ) || *ignored == sync_item( 2 ) );
+}
+
+BOOST_AUTO_TEST_CASE( slow_item_request_retried_with_another_peer )
+{
+   // the peer was asked for as many items as it may be, the first half of them long ago
+   const fc::time_point start = fc::time_point::now();
+   const fc::microseconds allowed_latency = fc::milliseconds( GRAPHENE_NET_ITEM_REQUEST_RETRY_MIN_TIMEOUT_MS );
+   const uint32_t requests = GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION;
+   std::vector<item_id> items;
+   handed_over_requests::item_to_time_map_type slow_peer_requests;
+   for( uint32_t i = 0; i < requests; ++i )
+   {
+      items.emplace_back( trx_message_type, message( trx_message( make_transaction( i ) ) ).id() );
+      slow_peer_requests[items.back()] = i < requests / 2 ? start : start + allowed_latency;
+   }
+   // another peer advertised every other item
+   std::unordered_set<item_id> advertised_by_other_peer;
+   for( uint32_t i = 0; i < requests; i += 2 )
+      advertised_by_other_peer.insert( items[i] );
+   auto other_peer_can_take_over = [&]( const item_id& item ) { return advertised_by_other_peer.count( item ) != 0; };
+
+   // only the overdue items the other peer has are retried with it
+   handed_over_requests retried;
+   std::vector<item_id> moved = retried.hand_over_slow_requests( slow_peer_requests, start + allowed_latency + fc::milliseconds( 1 ),
+                                                                 allowed_latency, other_peer_can_take_over );
+   BOOST_CHECK_EQUAL( moved.size(), requests / 4 );
+   for( const item_id& item : moved )
+      BOOST_CHECK( advertised_by_other_peer.count( item ) );
+   BOOST_CHECK_EQUAL( slow_peer_requests.size(), requests - requests / 4 );
+   BOOST_CHECK( slow_peer_requests.count( items[1] ) );
+   BOOST_CHECK( slow_peer_requests.count( items[requests - 2] ) );
+
+   // the late original is one we asked for, a second copy of it is not
+   BOOST_CHECK( retried.remove( items[0] ) );
+   BOOST_CHECK( !retried.remove( items[0] ) );
+   BOOST_CHECK( !retried.remove( item_id( trx_message_type, message( trx_message( make_transaction( requests ) ) ).id() ) ) );
+
+   // a retried request is forgotten with the inventory it was for
+   retried.remove_if( [&]( const item_id& item ) { return item == items[2]; } );
+   BOOST_CHECK( !retried.contains( items[2] ) );
+   BOOST_CHECK( retried.contains( items[4] ) );
+
+   // the items the slow peer never sends still time out
+   BOOST_CHECK( !retried.find_requested_before( start ) );
+   BOOST_CHECK( retried.find_requested_before( start + fc::milliseconds( 1 ) ).valid() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,189 @@
+/* (c) 2018 CYVA. For details refer to LICENSE */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/app/transaction_precheck.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/exceptions.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+using graphene::app::transaction_precheck;
+using graphene::app::prechecked_transaction;
+
+namespace {
+
+   signed_transaction make_transfer( const database& db, account_id_type from, account_id_type to,
+                                     int64_t amount, const fc::ecc::private_key& key )
+   {
+      signed_transaction trx;
+      transfer_operation op;
+      op.from = from;
+      op.to = to;
+      op.amount = asset( amount );
+      trx.operations.push_back( op );
+      db.current_fee_schedule().set_fee( trx.operations.back() );
+      trx.set_expiration( db.head_block_time() + fc::seconds( 60 ) );
+      trx.set_reference_block( db.head_block_id() );
+      trx.sign( key, db.get_chain_id() );
+      return trx;
+   }
+
+}
+
+BOOST_FIXTURE_TEST_SUITE( precheck_tests, database_fixture )
+
+BOOST_AUTO_TEST_CASE( precheck_rejects_invalid_transactions )
+{ try {
+   ACTORS((nathan)(dan));
+   transfer( miner_account, nathan_id, asset( 1000000 ) );
+   generate_block();
+
+   transaction_precheck precheck( 2 );
+   precheck.update_parameters( db );
+
+   signed_transaction empty;
+   empty.set_expiration( db.head_block_time() + fc::seconds( 60 ) );
+   BOOST_CHECK_THROW( precheck.precheck( empty ), fc::exception );
+
+   signed_transaction expired = make_transfer( db, nathan_id, dan_id, 100, nathan_private_key );
+   expired.set_expiration( db.head_block_time() - fc::seconds( 1 ) );
+   expired.signatures.clear();
+   expired.sign( nathan_private_key, db.get_chain_id() );
+   BOOST_CHECK_THROW( precheck.precheck( expired ), fc::exception );
+
+   signed_transaction too_late = make_transfer( db, nathan_id, dan_id, 100, nathan_private_key );
+   too_late.set_expiration( db.head_block_time() + db.get_global_properties().parameters.maximum_time_until_expiration + 1 );
+   too_late.signatures.clear();
+   too_late.sign( nathan_private_key, db.get_chain_id() );
+   BOOST_CHECK_THROW( precheck.precheck( too_late ), fc::exception );
+
+   signed_transaction double_signed = make_transfer( db, nathan_id, dan_id, 100, nathan_private_key );
+   double_signed.sign( nathan_private_key, db.get_chain_id() );
+   GRAPHENE_CHECK_THROW( precheck.precheck( double_signed ), tx_duplicate_sig );
+
+   fc::variant_object stats = precheck.get_statistics();
+   BOOST_CHECK_EQUAL( stats["rejected_invalid"].as_uint64(), 4u );
+   BOOST_CHECK_EQUAL( stats["admitted"].as_uint64(), 0u );
+   BOOST_CHECK_EQUAL( stats["tracked"].as_uint64(), 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( precheck_filters_duplicates_until_forgotten )
+{ try {
+   ACTORS((nathan)(dan));
+   transfer( miner_account, nathan_id, asset( 1000000 ) );
+   generate_block();
+
+   transaction_precheck precheck( 2 );
+   precheck.update_parameters( db );
+
+   signed_transaction trx = make_transfer( db, nathan_id, dan_id, 100, nathan_private_key );
+   BOOST_CHECK_EQUAL( precheck.precheck( trx ).id.str(), trx.id().str() );
+   BOOST_CHECK_THROW( precheck.precheck( trx ), fc::exception );
+   BOOST_CHECK_EQUAL( precheck.get_statistics()["rejected_duplicate"].as_uint64(), 1u );
+
+   // a transaction the chain rejected may be resubmitted once it is forgotten
+   precheck.forget( trx.id() );
+   BOOST_CHECK_NO_THROW( precheck.precheck( trx ) );
+   BOOST_CHECK_EQUAL( precheck.get_statistics()["admitted"].as_uint64(), 2u );
+   BOOST_CHECK_EQUAL( precheck.get_statistics()["tracked"].as_uint64(), 1u );
+
+   // once it has expired it is no longer tracked
+   generate_blocks( trx.expiration + fc::seconds( 1 ) );
+   precheck.update_parameters( db );
+   BOOST_CHECK_EQUAL( precheck.get_statistics()["tracked"].as_uint64(), 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( precheck_forgets_transactions_the_chain_dropped )
+{ try {
+   ACTORS((nathan)(dan));
+   transfer( miner_account, nathan_id, asset( 1000000 ) );
+   generate_block();
+
+   transaction_precheck precheck( 2 );
+   precheck.update_parameters( db );
+   db.on_dropped_transaction.connect( [&]( const transaction_id_type& id ){ precheck.forget( id ); } );
+
+   signed_transaction first = make_transfer( db, nathan_id, dan_id, 600000, nathan_private_key );
+   db.push_transaction( first, precheck.precheck( first ) );
+   generate_block();
+   BOOST_CHECK_THROW( precheck.precheck( first ), fc::exception );
+
+   // the block is popped and a transaction spending the same funds makes it into the next one
+   db.pop_block();
+   signed_transaction second = make_transfer( db, nathan_id, dan_id, 600001, nathan_private_key );
+   db.push_transaction( second, precheck.precheck( second ) );
+   generate_block();
+   BOOST_CHECK( !db.is_known_transaction( first.id() ) );
+   BOOST_CHECK( db.is_known_transaction( second.id() ) );
+
+   // the dropped transaction is no duplicate any more, the one in the block still is
+   BOOST_CHECK_NO_THROW( precheck.precheck( first ) );
+   BOOST_CHECK_THROW( precheck.precheck( second ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( precheck_batch_reports_every_transaction )
+{ try {
+   ACTORS((nathan)(dan));
+   transfer( miner_account, nathan_id, asset( 1000000 ) );
+   generate_block();
+
+   transaction_precheck precheck( 3 );
+   precheck.update_parameters( db );
+
+   // more transactions than threads, so every thread checks several of them
+   std::vector<signed_transaction> batch;
+   for( int64_t i = 1; i <= 8; ++i )
+      batch.push_back( make_transfer( db, nathan_id, dan_id, i, nathan_private_key ) );
+   batch[2].operations.clear();
+   batch[5].sign( nathan_private_key, db.get_chain_id() );
+   // the thread checking the first transaction checks its copy next
+   batch[3] = batch[0];
+
+   std::vector<prechecked_transaction> results = precheck.precheck_batch( batch );
+   BOOST_REQUIRE_EQUAL( results.size(), batch.size() );
+   for( size_t i = 0; i < batch.size(); ++i )
+   {
+      const bool rejected = i == 2 || i == 3 || i == 5;
+      BOOST_CHECK_MESSAGE( results[i].error.valid() == rejected, "unexpected result for transaction " + fc::to_string( uint64_t(i) ) );
+      if( !rejected )
+      {
+         BOOST_CHECK( results[i].id == batch[i].id() );
+         BOOST_CHECK( results[i].signature_keys.valid() );
+      }
+   }
+
+   fc::variant_object stats = precheck.get_statistics();
+   BOOST_CHECK_EQUAL( stats["admitted"].as_uint64(), 5u );
+   BOOST_CHECK_EQUAL( stats["rejected_invalid"].as_uint64(), 2u );
+   BOOST_CHECK_EQUAL( stats["rejected_duplicate"].as_uint64(), 1u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( prechecked_transaction_reuses_signature_keys )
+{ try {
+   ACTORS((nathan)(dan));
+   transfer( miner_account, nathan_id, asset( 1000000 ) );
+   generate_block();
+
+   transaction_precheck precheck( 0 );
+   precheck.update_parameters( db );
+
+   signed_transaction trx = make_transfer( db, nathan_id, dan_id, 100, nathan_private_key );
+   prechecked_transaction prechecked = precheck.precheck( trx );
+   BOOST_REQUIRE( prechecked.signature_keys.valid() );
+   BOOST_CHECK_EQUAL( prechecked.signature_keys->size(), 1u );
+   BOOST_CHECK( prechecked.signature_keys->count( nathan_public_key ) );
+
+   // the authority check uses the keys found by the precheck instead of recovering them again
+   prechecked_transaction wrong_keys = prechecked;
+   wrong_keys.signature_keys->clear();
+   GRAPHENE_CHECK_THROW( db.push_transaction( trx, wrong_keys ), fc::exception );
+
+   db.push_transaction( trx, prechecked );
+   BOOST_CHECK_EQUAL( get_balance( dan_id, asset_id_type() ), 100 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -25,7 +25,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/chain/database.hpp>
-
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/message_compression.hpp>
 
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/elliptic.hpp>
@@ -148,4 +149,39 @@ BOOST_AUTO_TEST_CASE( extension_serialization_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( message_compression_test )
+{
+   try
+   {
+      graphene::net::blockchain_item_ids_inventory_message inventory;
+      inventory.total_remaining_item_count = 0;
+      inventory.item_type = graphene::net::block_message_type;
+      for( uint32_t i = 0; i < 200; ++i )
+         inventory.item_hashes_available.push_back( fc::ripemd160::hash( std::to_string( i / 4 ) ) );
+      graphene::net::message original( inventory );
+
+      graphene::net::serialized_message_ptr serialized = graphene::net::serialize_message( original );
+      BOOST_CHECK_EQUAL( serialized->size() % 16, 0u );
+      graphene::net::serialized_message_ptr compressed = graphene::net::compress_message( serialized );
+      BOOST_REQUIRE( compressed );
+      BOOST_CHECK( graphene::net::is_compressed_message( compressed ) );
+      BOOST_CHECK_LT( compressed->size(), serialized->size() );
+
+      graphene::net::message restored = graphene::net::decompress_message( graphene::net::deserialize_message( compressed ) );
+      BOOST_CHECK_EQUAL( restored.msg_type, original.msg_type );
+      BOOST_CHECK( restored.id() == original.id() );
+
+      // a body claiming to expand beyond the maximum message size is refused
+      graphene::net::message bomb = graphene::net::deserialize_message( compressed );
+      uint32_t too_large = MAX_MESSAGE_SIZE + 1;
+      memcpy( bomb.data.data(), &too_large, sizeof(too_large) );
+      GRAPHENE_CHECK_THROW( graphene::net::decompress_message( bomb ), fc::exception );
+   }
+   catch ( const fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()